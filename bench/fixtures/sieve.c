@@ -0,0 +1,27 @@
+char flags[8192];
+
+int main()
+{
+    int i;
+    int j;
+    int count;
+
+    count = 0;
+    i = 2;
+    while(i < 8192)
+    {
+        if(!flags[i])
+        {
+            count = count + 1;
+            j = i * i;
+            while(j < 8192)
+            {
+                flags[j] = 1;
+                j = j + i;
+            }
+        }
+        i = i + 1;
+    }
+
+    return count;
+}
@@ -0,0 +1,43 @@
+int values[512];
+
+int main()
+{
+    int i;
+    int k;
+    int key;
+    int state;
+    int disorder;
+
+    state = 12345;
+    i = 0;
+    while(i < 512)
+    {
+        state = (state * 1103515245 + 12345) & 2147483647;
+        values[i] = state % 10000;
+        i = i + 1;
+    }
+
+    i = 1;
+    while(i < 512)
+    {
+        key = values[i];
+        k = i;
+        while(k && values[k - 1] > key)
+        {
+            values[k] = values[k - 1];
+            k = k - 1;
+        }
+        values[k] = key;
+        i = i + 1;
+    }
+
+    disorder = 0;
+    i = 1;
+    while(i < 512)
+    {
+        disorder = disorder + (values[i - 1] > values[i]);
+        i = i + 1;
+    }
+
+    return disorder;
+}
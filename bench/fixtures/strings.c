@@ -0,0 +1,41 @@
+char *text;
+char buffer[128];
+
+int main()
+{
+    int round;
+    int count;
+    int length;
+    char *cursor;
+
+    text = "the quick brown fox jumps over the lazy dog, the quick brown fox jumps over the lazy dog, ";
+    length = 0;
+    while(text[length])
+    {
+        length = length + 1;
+    }
+
+    count = 0;
+    round = 0;
+    while(round < 64)
+    {
+        cursor = text;
+        while(*cursor)
+        {
+            if(*cursor == 'o')
+            {
+                count = count + 1;
+            }
+            cursor = cursor + 1;
+        }
+
+        memcpy(buffer, text, length);
+        if(memcmp(buffer, text, length))
+        {
+            return -1;
+        }
+        round = round + 1;
+    }
+
+    return count;
+}
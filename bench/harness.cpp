@@ -0,0 +1,273 @@
+#include "harness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+/**********************************************************************************************//**
+ * \brief Times a number of back to back iterations
+ * \param benchmark The benchmark to run
+ * \param iterations How many times to run it
+ * \param is_valid Cleared if any iteration produced the wrong result
+ * \returns The elapsed time in nanoseconds
+ *************************************************************************************************/
+double time_iterations(const Benchmark& benchmark, const uint64_t iterations, bool& is_valid)
+{
+    const auto start = Clock::now();
+    for(uint64_t i = 0UL; i < iterations; ++i)
+    {
+        is_valid = benchmark.run() && is_valid;
+    }
+    const auto end = Clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+/**********************************************************************************************//**
+ * \brief Quotes a string for use in JSON. Benchmark names are plain, so only quotes and
+ *        backslashes need escaping.
+ * \param text The string to quote
+ * \returns The string in double quotes
+ *************************************************************************************************/
+std::string quote(const std::string& text)
+{
+    std::string result("\"");
+    for(const auto character : text)
+    {
+        if((character == '"') || (character == '\\'))
+        {
+            result += '\\';
+        }
+        result += character;
+    }
+
+    return result + "\"";
+}
+
+/**********************************************************************************************//**
+ * \brief Finds a string field on a line of JSON written by write_json
+ * \param line The line
+ * \param field The field's name
+ * \param value Receives the field's value
+ * \returns True if the field was found
+ *************************************************************************************************/
+bool find_string(const std::string& line, const std::string& field, std::string& value)
+{
+    const auto key = "\"" + field + "\": \"";
+    const auto start = line.find(key);
+    if(start == std::string::npos)
+    {
+        return false;
+    }
+
+    value.clear();
+    for(auto i = start + key.size(); i < line.size(); ++i)
+    {
+        if(line[i] == '\\')
+        {
+            ++i;
+        }
+        else if(line[i] == '"')
+        {
+            return true;
+        }
+
+        if(i < line.size())
+        {
+            value += line[i];
+        }
+    }
+
+    return false;
+}
+
+/**********************************************************************************************//**
+ * \brief Finds a numeric field on a line of JSON written by write_json
+ * \param line The line
+ * \param field The field's name
+ * \param value Receives the field's value
+ * \returns True if the field was found
+ *************************************************************************************************/
+bool find_number(const std::string& line, const std::string& field, double& value)
+{
+    const auto key = "\"" + field + "\": ";
+    const auto start = line.find(key);
+    if(start == std::string::npos)
+    {
+        return false;
+    }
+
+    const auto text = line.c_str() + start + key.size();
+    char* end = nullptr;
+    value = std::strtod(text, &end);
+
+    return end != text;
+}
+
+};
+
+/**********************************************************************************************//**
+ * \brief Converts the median time into a rate
+ * \returns Items processed per second
+ *************************************************************************************************/
+double Result::items_per_second() const
+{
+    return (median_ns > 0.0) ? (static_cast<double>(items_per_iteration) * 1e9 / median_ns) : 0.0;
+}
+
+/**********************************************************************************************//**
+ * \brief Measures a benchmark. The number of iterations per sample is grown until a sample takes
+ *        long enough to time reliably, then SAMPLE_COUNT samples are taken.
+ * \param benchmark The benchmark to measure
+ * \param minimum_seconds The least time to spend on all the samples together
+ * \returns The time per iteration over the samples
+ *************************************************************************************************/
+Result Harness::measure(const Benchmark& benchmark, const double minimum_seconds)
+{
+    Result result{benchmark.name, benchmark.unit, benchmark.items_per_iteration, 1UL, SAMPLE_COUNT, 0.0, 0.0, true};
+
+    // The first run warms the caches and checks the result before anything is timed
+    result.is_valid = benchmark.run();
+
+    const auto target_ns = minimum_seconds * 1e9 / static_cast<double>(SAMPLE_COUNT);
+    for(auto elapsed = time_iterations(benchmark, result.iterations, result.is_valid);
+        elapsed < target_ns;
+        elapsed = time_iterations(benchmark, result.iterations, result.is_valid))
+    {
+        // Aim a little past the target, but never grow by more than a hundred times at once
+        const auto scale = (elapsed > 0.0) ? std::min(100.0, (target_ns * 1.2) / elapsed) : 100.0;
+        result.iterations = std::max(result.iterations + 1UL, static_cast<uint64_t>(static_cast<double>(result.iterations) * scale));
+    }
+
+    std::vector<double> samples;
+    for(uint64_t i = 0UL; i < SAMPLE_COUNT; ++i)
+    {
+        samples.push_back(time_iterations(benchmark, result.iterations, result.is_valid) / static_cast<double>(result.iterations));
+    }
+
+    std::sort(samples.begin(), samples.end());
+    result.median_ns = samples[samples.size() / 2UL];
+    result.minimum_ns = samples.front();
+
+    return result;
+}
+
+/**********************************************************************************************//**
+ * \brief Writes results as JSON, with one benchmark per line so the file diffs well
+ * \param stream Where to write
+ * \param results The results to write
+ *************************************************************************************************/
+void Harness::write_json(std::ostream& stream, const std::vector<Result>& results)
+{
+    stream << "{\n  \"benchmarks\": [";
+
+    auto separator = "\n";
+    for(const auto& result : results)
+    {
+        char numbers[256];
+        std::snprintf(numbers, sizeof(numbers),
+                      "\"median_ns\": %.3f, \"minimum_ns\": %.3f, \"items_per_second\": %.1f",
+                      result.median_ns, result.minimum_ns, result.items_per_second());
+
+        stream << separator << "    {\"name\": " << quote(result.name)
+               << ", \"unit\": " << quote(result.unit)
+               << ", \"items_per_iteration\": " << result.items_per_iteration
+               << ", \"iterations\": " << result.iterations
+               << ", \"samples\": " << result.samples
+               << ", " << numbers
+               << ", \"valid\": " << (result.is_valid ? "true" : "false") << "}";
+        separator = ",\n";
+    }
+
+    stream << "\n  ]\n}\n";
+}
+
+/**********************************************************************************************//**
+ * \brief Reads the median time of every benchmark from a file written by write_json
+ * \param path The baseline file
+ * \param baseline Receives the median nanoseconds per iteration, by benchmark name
+ * \param error Receives the reason if the file can't be read
+ * \returns True if the file was read and held at least one benchmark
+ *************************************************************************************************/
+bool Harness::read_baseline(const std::string& path, std::unordered_map<std::string, double>& baseline, std::string& error)
+{
+    std::ifstream file(path);
+    if(!file)
+    {
+        error = "Unable to open " + path;
+        return false;
+    }
+
+    std::string line;
+    while(std::getline(file, line))
+    {
+        std::string name;
+        double median = 0.0;
+        if(find_string(line, "name", name) && find_number(line, "median_ns", median))
+        {
+            baseline[name] = median;
+        }
+    }
+
+    if(baseline.empty())
+    {
+        error = path + " doesn't hold any benchmarks";
+        return false;
+    }
+
+    return true;
+}
+
+/**********************************************************************************************//**
+ * \brief Compares results with a baseline. Benchmarks missing from the baseline are left out.
+ * \param results The results of this run
+ * \param baseline Median nanoseconds per iteration, by benchmark name
+ * \param threshold How many percent slower a benchmark must be to count as a regression
+ * \returns One comparison per benchmark found in both
+ *************************************************************************************************/
+std::vector<Comparison> Harness::compare(const std::vector<Result>& results,
+                                         const std::unordered_map<std::string, double>& baseline,
+                                         const double threshold)
+{
+    std::vector<Comparison> comparisons;
+    for(const auto& result : results)
+    {
+        const auto previous = baseline.find(result.name);
+        if((previous == baseline.end()) || (previous->second <= 0.0))
+        {
+            continue;
+        }
+
+        const auto change = ((result.median_ns - previous->second) / previous->second) * 100.0;
+        comparisons.push_back({result.name, previous->second, result.median_ns, change, change > threshold});
+    }
+
+    return comparisons;
+}
+
+/**********************************************************************************************//**
+ * \brief Writes a table of comparisons, marking every regression
+ * \param stream Where to write
+ * \param comparisons The comparisons to write
+ *************************************************************************************************/
+void Harness::write_comparison(std::ostream& stream, const std::vector<Comparison>& comparisons)
+{
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-32s %14s %14s %9s\n", "Benchmark", "Baseline ns", "Current ns", "Change");
+    stream << line;
+
+    for(const auto& comparison : comparisons)
+    {
+        std::snprintf(line, sizeof(line), "%-32s %14.1f %14.1f %+8.1f%%%s\n",
+                      comparison.name.c_str(), comparison.baseline_ns, comparison.current_ns, comparison.change,
+                      comparison.is_regression ? "  REGRESSION" : "");
+        stream << line;
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**************************************************************************************************
+ * \brief A single named measurement. Each call to run is one iteration, and processes a known
+ *        number of items, such as instructions retired or source bytes compiled.
+ *************************************************************************************************/
+struct Benchmark
+{
+    std::string name;
+    std::string unit;               // What an item is, e.g. "instructions"
+    uint64_t items_per_iteration;
+    std::function<bool()> run;      // False if the iteration produced the wrong result
+};
+
+struct Result
+{
+    std::string name;
+    std::string unit;
+    uint64_t items_per_iteration;
+    uint64_t iterations;            // Per sample
+    uint64_t samples;
+    double median_ns;               // Per iteration, over the samples
+    double minimum_ns;
+    bool is_valid;
+
+    double items_per_second() const;
+};
+
+/**************************************************************************************************
+ * \brief How a result compares with the same benchmark in a baseline
+ *************************************************************************************************/
+struct Comparison
+{
+    std::string name;
+    double baseline_ns;
+    double current_ns;
+    double change;                  // Percent, positive when slower
+    bool is_regression;
+};
+
+namespace Harness
+{
+    constexpr uint64_t SAMPLE_COUNT = 5UL;
+
+    Result measure(const Benchmark& benchmark, double minimum_seconds);
+
+    void write_json(std::ostream& stream, const std::vector<Result>& results);
+    bool read_baseline(const std::string& path, std::unordered_map<std::string, double>& baseline, std::string& error);
+
+    std::vector<Comparison> compare(const std::vector<Result>& results,
+                                    const std::unordered_map<std::string, double>& baseline,
+                                    double threshold);
+    void write_comparison(std::ostream& stream, const std::vector<Comparison>& comparisons);
+};
+
+#endif
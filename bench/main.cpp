@@ -0,0 +1,253 @@
+#include "harness.h"
+#include "../programs/programs.h"
+#include "../src/instructions.h"
+#include "../src/interpreter.h"
+#include "../src/profiler.h"
+#include "../src/virtual-machine.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+constexpr double DEFAULT_MINIMUM_SECONDS = 0.25;
+constexpr double DEFAULT_THRESHOLD = 10.0;
+
+const std::vector<std::string> FIXTURES = {"fib.c", "sieve.c", "strings.c", "sort.c"};
+
+/**********************************************************************************************//**
+ * \brief Wraps a hand assembled program as a benchmark. The program is run once with a profiler
+ *        to count the instructions in an iteration.
+ * \param name The benchmark's name
+ * \param program The program, and the exit status it must finish with
+ * \returns The benchmark. Each iteration reloads the program into the same virtual machine.
+ *************************************************************************************************/
+Benchmark program_benchmark(const std::string& name, const Benchmark_Program& program)
+{
+    const auto vm = std::make_shared<Virtual_Machine>();
+
+    vm->load(program.image);
+    Profiler profiler(program.image);
+    vm->execute(profiler);
+
+    return {name, "instructions", profiler.instructions(), [vm, program]()
+    {
+        if(!vm->load(program.image))
+        {
+            return false;
+        }
+
+        const auto trap = vm->execute();
+        return (trap.code == Fault_Code::Exit) && (trap.exit_status == program.exit_status);
+    }};
+}
+
+/**********************************************************************************************//**
+ * \brief Wraps the compilation of a C fixture as a benchmark. The whole pipeline runs, from
+ *        reading the file to linking, along with anything the compiled program does.
+ * \param fixture The fixture's file name
+ * \returns The benchmark, measured in source bytes
+ *************************************************************************************************/
+Benchmark compile_benchmark(const std::string& fixture)
+{
+    const auto path = std::string(BENCHMARK_FIXTURE_DIRECTORY) + "/" + fixture;
+
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    const auto size = file ? static_cast<uint64_t>(file.tellg()) : 0UL;
+
+    return {"compile/" + fixture, "bytes", size, [path]()
+    {
+        return Interpreter::Interpret(path) == Interpreter::Response_Code::Success;
+    }};
+}
+
+/**********************************************************************************************//**
+ * \brief Lists every benchmark
+ * \returns The micro benchmarks first, then the programs, then compilation
+ *************************************************************************************************/
+std::vector<Benchmark> make_benchmarks()
+{
+    std::vector<Benchmark> benchmarks;
+
+    benchmarks.push_back(program_benchmark("dispatch/IMM", Programs::dispatch()));
+
+    benchmarks.push_back(program_benchmark("memory/load_word", Programs::load_word()));
+    benchmarks.push_back(program_benchmark("memory/store_word", Programs::store_word()));
+    benchmarks.push_back(program_benchmark("memory/load_byte", Programs::load_byte()));
+    benchmarks.push_back(program_benchmark("memory/store_byte", Programs::store_byte()));
+    benchmarks.push_back(program_benchmark("memory/load_stack_word", Programs::load_stack_word()));
+
+    for(auto opcode = static_cast<uint8_t>(OR); opcode <= static_cast<uint8_t>(MOD); ++opcode)
+    {
+        benchmarks.push_back(program_benchmark(std::string("arithmetic/") + mnemonic(opcode), Programs::arithmetic(opcode)));
+    }
+
+    benchmarks.push_back({"vm/construct", "machines", 1UL, []()
+    {
+        Virtual_Machine vm;
+        return vm.heap_statistics().bytes_in_use == 0U;
+    }});
+
+    const auto image = Programs::sieve(8192U).image;
+    const auto vm = std::make_shared<Virtual_Machine>();
+    benchmarks.push_back({"vm/load", "bytes", image.text.size() + image.bss_size, [vm, image]()
+    {
+        return vm->load(image);
+    }});
+
+    benchmarks.push_back(program_benchmark("execute/fib", Programs::fib(22U)));
+    benchmarks.push_back(program_benchmark("execute/sieve", Programs::sieve(8192U)));
+    benchmarks.push_back(program_benchmark("execute/strings", Programs::strings(64U)));
+    benchmarks.push_back(program_benchmark("execute/sort", Programs::sort(512U)));
+
+    for(const auto& fixture : FIXTURES)
+    {
+        benchmarks.push_back(compile_benchmark(fixture));
+    }
+
+    return benchmarks;
+}
+
+/**********************************************************************************************//**
+ * \brief Prints how to run the benchmarks
+ *************************************************************************************************/
+void print_usage()
+{
+    std::cerr << "Usage: benchmarks [options]\n"
+              << "  --list                 List the benchmarks and exit\n"
+              << "  --filter=<text>        Only run benchmarks whose names contain the text\n"
+              << "  --min-time=<seconds>   Least time to spend measuring each benchmark (default "
+              << DEFAULT_MINIMUM_SECONDS << ")\n"
+              << "  --output=<path>        Write the JSON results here rather than to standard output\n"
+              << "  --baseline=<path>      Compare with the JSON results of an earlier run\n"
+              << "  --threshold=<percent>  How much slower than the baseline is a regression (default "
+              << DEFAULT_THRESHOLD << ")\n";
+}
+
+};
+
+/**********************************************************************************************//**
+ * \brief Runs the benchmarks, writes the results as JSON and optionally compares them with a
+ *        baseline
+ * \param argc Argument count
+ * \param argv Argument vector
+ * \returns Zero, or one if any benchmark produced the wrong result or regressed
+ *************************************************************************************************/
+int main(int argc, char** argv)
+{
+    std::string filter;
+    std::string output_path;
+    std::string baseline_path;
+    auto minimum_seconds = DEFAULT_MINIMUM_SECONDS;
+    auto threshold = DEFAULT_THRESHOLD;
+    auto should_list = false;
+
+    for(auto i = 1; i < argc; ++i)
+    {
+        const std::string argument(argv[i]);
+        if(argument == "--list")
+        {
+            should_list = true;
+        }
+        else if(argument.rfind("--filter=", 0) == 0)
+        {
+            filter = argument.substr(9);
+        }
+        else if(argument.rfind("--min-time=", 0) == 0)
+        {
+            minimum_seconds = std::atof(argument.c_str() + 11);
+        }
+        else if(argument.rfind("--output=", 0) == 0)
+        {
+            output_path = argument.substr(9);
+        }
+        else if(argument.rfind("--baseline=", 0) == 0)
+        {
+            baseline_path = argument.substr(11);
+        }
+        else if(argument.rfind("--threshold=", 0) == 0)
+        {
+            threshold = std::atof(argument.c_str() + 12);
+        }
+        else
+        {
+            print_usage();
+            return 1;
+        }
+    }
+
+    std::unordered_map<std::string, double> baseline;
+    std::string error;
+    if(!baseline_path.empty() && !Harness::read_baseline(baseline_path, baseline, error))
+    {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    std::vector<Result> results;
+    auto is_valid = true;
+    for(const auto& benchmark : make_benchmarks())
+    {
+        if(benchmark.name.find(filter) == std::string::npos)
+        {
+            continue;
+        }
+
+        if(should_list)
+        {
+            std::cout << benchmark.name << '\n';
+            continue;
+        }
+
+        const auto result = Harness::measure(benchmark, minimum_seconds);
+        is_valid = is_valid && result.is_valid;
+        results.push_back(result);
+
+        char line[256];
+        std::snprintf(line, sizeof(line), "%-32s %14.1f ns %16.0f %s/s%s\n",
+                      result.name.c_str(), result.median_ns, result.items_per_second(), result.unit.c_str(),
+                      result.is_valid ? "" : "  WRONG RESULT");
+        std::cerr << line;
+    }
+
+    if(should_list)
+    {
+        return 0;
+    }
+
+    if(output_path.empty())
+    {
+        Harness::write_json(std::cout, results);
+    }
+    else
+    {
+        std::ofstream output(output_path);
+        Harness::write_json(output, results);
+        if(output.fail())
+        {
+            std::cerr << "Unable to write the results to " << output_path << std::endl;
+            return 1;
+        }
+    }
+
+    auto has_regressed = false;
+    if(!baseline_path.empty())
+    {
+        const auto comparisons = Harness::compare(results, baseline, threshold);
+        std::cerr << '\n';
+        Harness::write_comparison(std::cerr, comparisons);
+
+        for(const auto& comparison : comparisons)
+        {
+            has_regressed = has_regressed || comparison.is_regression;
+        }
+    }
+
+    return (is_valid && !has_regressed) ? 0 : 1;
+}
@@ -0,0 +1,484 @@
+#include "programs.h"
+#include "../src/instructions.h"
+#include "../src/memory-map.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+
+using Memory_Map::DATA_START_ADDRESS;
+
+// Copies of the body in each trip round an unrolled loop, so the loop's own instructions barely count
+constexpr uint32_t UNROLL = 16U;
+
+constexpr const char* SENTENCE = "the quick brown fox jumps over the lazy dog, ";
+constexpr uint32_t SENTENCE_REPEATS = 24U;
+
+/**********************************************************************************************//**
+ * \brief Emits the start up code shared by every program. It calls main and exits with whatever
+ *        main returns.
+ * \param assembler Where to emit the code
+ *************************************************************************************************/
+void emit_start(Assembler& assembler)
+{
+    assembler.label("_start")
+             .emit(CALL, "main")
+             .emit(PUSH)
+             .emit(EXIT);
+}
+
+/**********************************************************************************************//**
+ * \brief Emits code which adds one to a local variable
+ * \param assembler Where to emit the code
+ * \param local The local's index, counting down from -1
+ *************************************************************************************************/
+void emit_increment(Assembler& assembler, const int32_t local)
+{
+    assembler.emit(LEA, static_cast<uint32_t>(local)).emit(PUSH).emit(LI).emit(PUSH)
+             .emit(IMM, 1U).emit(ADD).emit(SI);
+}
+
+/**********************************************************************************************//**
+ * \brief Emits code which stores a constant in a local variable
+ * \param assembler Where to emit the code
+ * \param local The local's index, counting down from -1
+ * \param value The constant
+ *************************************************************************************************/
+void emit_assign(Assembler& assembler, const int32_t local, const uint32_t value)
+{
+    assembler.emit(LEA, static_cast<uint32_t>(local)).emit(PUSH).emit(IMM, value).emit(SI);
+}
+
+/**********************************************************************************************//**
+ * \brief Emits code which leaves the address of a word in an array in ax
+ * \param assembler Where to emit the code
+ * \param array Address of the array
+ * \param local The local holding the index
+ *************************************************************************************************/
+void emit_element_address(Assembler& assembler, const uint32_t array, const int32_t local)
+{
+    assembler.emit(IMM, array).emit(PUSH).emit(LEA, static_cast<uint32_t>(local)).emit(LI)
+             .emit(PUSH).emit(IMM, Memory_Map::WORD_SIZE).emit(MUL).emit(ADD);
+}
+
+};
+
+/**********************************************************************************************//**
+ * \brief Appends an instruction without an argument
+ * \param opcode The instruction
+ * \returns The assembler, so calls can be chained
+ *************************************************************************************************/
+Assembler& Assembler::emit(const uint8_t opcode)
+{
+    text.push_back(opcode);
+    return *this;
+}
+
+/**********************************************************************************************//**
+ * \brief Appends an instruction with an argument. The argument is dropped if the instruction
+ *        doesn't take one.
+ * \param opcode The instruction
+ * \param operand Its argument
+ * \returns The assembler, so calls can be chained
+ *************************************************************************************************/
+Assembler& Assembler::emit(const uint8_t opcode, const uint32_t operand)
+{
+    text.push_back(opcode);
+    if(has_operand(opcode))
+    {
+        text.resize(text.size() + Memory_Map::WORD_SIZE);
+        Memory_Map::store_word(text, text.size() - Memory_Map::WORD_SIZE, operand);
+    }
+
+    return *this;
+}
+
+/**********************************************************************************************//**
+ * \brief Appends a jump or call to a label
+ * \param opcode The instruction
+ * \param label The target, which may be placed later
+ * \returns The assembler, so calls can be chained
+ *************************************************************************************************/
+Assembler& Assembler::emit(const uint8_t opcode, const std::string& label)
+{
+    emit(opcode, 0U);
+    fixups.emplace_back(static_cast<uint32_t>(text.size() - Memory_Map::WORD_SIZE), label);
+
+    return *this;
+}
+
+/**********************************************************************************************//**
+ * \brief Names the offset of the next instruction
+ * \param name The label
+ * \returns The assembler, so calls can be chained
+ *************************************************************************************************/
+Assembler& Assembler::label(const std::string& name)
+{
+    labels[name] = static_cast<uint32_t>(text.size());
+    return *this;
+}
+
+/**********************************************************************************************//**
+ * \brief Resolves every label and builds the program image. Labels become its symbols.
+ * \param entry The label where execution begins
+ * \returns The image, without any data
+ *************************************************************************************************/
+Program_Image Assembler::finish(const std::string& entry)
+{
+    for(const auto& [offset, name] : fixups)
+    {
+        const auto target = labels.find(name);
+        if(target == labels.end())
+        {
+            throw std::logic_error("Undefined label " + name);
+        }
+        Memory_Map::store_word(text, offset, target->second);
+    }
+
+    Program_Image image;
+    image.text = text;
+    image.entry_point = labels.at(entry);
+    image.symbols.insert(labels.begin(), labels.end());
+
+    return image;
+}
+
+/**********************************************************************************************//**
+ * \brief Builds a program which runs the same few instructions over and over. The loop counter
+ *        lives in main's only local.
+ * \param body The instructions, as opcode and argument. They must leave the stack as they found it.
+ * \param repetitions Trips round the loop, each running the body UNROLL times
+ * \returns The program, which exits with 0. Four bytes of data are reserved for the body to use.
+ *************************************************************************************************/
+Benchmark_Program Programs::unrolled_loop(const std::vector<std::pair<uint8_t, uint32_t>>& body, const uint32_t repetitions)
+{
+    Assembler assembler;
+    emit_start(assembler);
+
+    assembler.label("main").emit(ENT, 1U);
+    emit_assign(assembler, -1, repetitions);
+
+    assembler.label("loop");
+    for(uint32_t i = 0U; i < UNROLL; ++i)
+    {
+        for(const auto& [opcode, operand] : body)
+        {
+            assembler.emit(opcode, operand);
+        }
+    }
+
+    assembler.emit(LEA, static_cast<uint32_t>(-1)).emit(PUSH).emit(LI).emit(PUSH)
+             .emit(IMM, 1U).emit(SUB).emit(SI)
+             .emit(JNZ, "loop")
+             .emit(IMM, 0U)
+             .emit(LEV);
+
+    auto image = assembler.finish();
+    image.data.assign(Memory_Map::WORD_SIZE, 0U);
+
+    return {image, 0};
+}
+
+/**********************************************************************************************//**
+ * \brief The cheapest instruction there is, so nearly all the time is fetch and dispatch
+ * \returns The program
+ *************************************************************************************************/
+Benchmark_Program Programs::dispatch()
+{
+    return unrolled_loop({{IMM, 1U}}, 4096U);
+}
+
+/**********************************************************************************************//**
+ * \brief Loads a word from the data segment
+ * \returns The program
+ *************************************************************************************************/
+Benchmark_Program Programs::load_word()
+{
+    return unrolled_loop({{IMM, DATA_START_ADDRESS}, {LI, 0U}}, 4096U);
+}
+
+/**********************************************************************************************//**
+ * \brief Stores a word to the data segment
+ * \returns The program
+ *************************************************************************************************/
+Benchmark_Program Programs::store_word()
+{
+    return unrolled_loop({{IMM, DATA_START_ADDRESS}, {PUSH, 0U}, {SI, 0U}}, 4096U);
+}
+
+/**********************************************************************************************//**
+ * \brief Loads a byte from the data segment
+ * \returns The program
+ *************************************************************************************************/
+Benchmark_Program Programs::load_byte()
+{
+    return unrolled_loop({{IMM, DATA_START_ADDRESS}, {LC, 0U}}, 4096U);
+}
+
+/**********************************************************************************************//**
+ * \brief Stores a byte to the data segment
+ * \returns The program
+ *************************************************************************************************/
+Benchmark_Program Programs::store_byte()
+{
+    return unrolled_loop({{IMM, DATA_START_ADDRESS}, {PUSH, 0U}, {SC, 0U}}, 4096U);
+}
+
+/**********************************************************************************************//**
+ * \brief Loads a local variable, which is a word on the stack
+ * \returns The program
+ *************************************************************************************************/
+Benchmark_Program Programs::load_stack_word()
+{
+    return unrolled_loop({{LEA, static_cast<uint32_t>(-1)}, {LI, 0U}}, 4096U);
+}
+
+/**********************************************************************************************//**
+ * \brief Runs a single binary operation. The right hand side is never zero, so DIV and MOD don't trap.
+ * \param opcode The operation
+ * \returns The program
+ *************************************************************************************************/
+Benchmark_Program Programs::arithmetic(const uint8_t opcode)
+{
+    return unrolled_loop({{PUSH, 0U}, {IMM, 3U}, {opcode, 0U}}, 4096U);
+}
+
+/**********************************************************************************************//**
+ * \brief The naive recursive Fibonacci function, which is almost all calls and returns
+ *        int fib(int n) { if(n < 2) return n; return fib(n - 1) + fib(n - 2); }
+ * \param n Which Fibonacci number to find
+ * \returns The program, which exits with the number
+ *************************************************************************************************/
+Benchmark_Program Programs::fib(const uint32_t n)
+{
+    Assembler assembler;
+    assembler.label("_start")
+             .emit(IMM, n).emit(PUSH).emit(CALL, "fib").emit(ADJ, 1U)
+             .emit(PUSH).emit(EXIT);
+
+    assembler.label("fib").emit(ENT, 0U)
+             .emit(LEA, 2U).emit(LI).emit(PUSH).emit(IMM, 2U).emit(LT).emit(JZ, "recurse")
+             .emit(LEA, 2U).emit(LI).emit(LEV)
+             .label("recurse")
+             .emit(LEA, 2U).emit(LI).emit(PUSH).emit(IMM, 1U).emit(SUB).emit(PUSH)
+             .emit(CALL, "fib").emit(ADJ, 1U).emit(PUSH)
+             .emit(LEA, 2U).emit(LI).emit(PUSH).emit(IMM, 2U).emit(SUB).emit(PUSH)
+             .emit(CALL, "fib").emit(ADJ, 1U).emit(ADD)
+             .emit(LEV);
+
+    uint32_t previous = 0U;
+    uint32_t current = 1U;
+    for(uint32_t i = 0U; i < n; ++i)
+    {
+        const auto next = previous + current;
+        previous = current;
+        current = next;
+    }
+
+    return {assembler.finish(), static_cast<int32_t>(previous)};
+}
+
+/**********************************************************************************************//**
+ * \brief The sieve of Eratosthenes over a byte array in BSS, a mix of byte stores and loops
+ * \param limit Primes are counted below this
+ * \returns The program, which exits with the number of primes found
+ *************************************************************************************************/
+Benchmark_Program Programs::sieve(const uint32_t limit)
+{
+    const auto flags = static_cast<uint32_t>(DATA_START_ADDRESS);
+
+    // Locals: -1 is i, -2 is j and -3 is the count
+    Assembler assembler;
+    emit_start(assembler);
+
+    assembler.label("main").emit(ENT, 3U);
+    emit_assign(assembler, -3, 0U);
+    emit_assign(assembler, -1, 2U);
+
+    assembler.label("outer")
+             .emit(LEA, static_cast<uint32_t>(-1)).emit(LI).emit(PUSH).emit(IMM, limit).emit(LT).emit(JZ, "done")
+             .emit(IMM, flags).emit(PUSH).emit(LEA, static_cast<uint32_t>(-1)).emit(LI).emit(ADD).emit(LC)
+             .emit(JNZ, "next");
+    emit_increment(assembler, -3);
+
+    // j = i * i
+    assembler.emit(LEA, static_cast<uint32_t>(-2)).emit(PUSH)
+             .emit(LEA, static_cast<uint32_t>(-1)).emit(LI).emit(PUSH)
+             .emit(LEA, static_cast<uint32_t>(-1)).emit(LI).emit(MUL).emit(SI);
+
+    assembler.label("inner")
+             .emit(LEA, static_cast<uint32_t>(-2)).emit(LI).emit(PUSH).emit(IMM, limit).emit(LT).emit(JZ, "next")
+             .emit(IMM, flags).emit(PUSH).emit(LEA, static_cast<uint32_t>(-2)).emit(LI).emit(ADD)
+             .emit(PUSH).emit(IMM, 1U).emit(SC)
+             .emit(LEA, static_cast<uint32_t>(-2)).emit(PUSH).emit(LI).emit(PUSH)
+             .emit(LEA, static_cast<uint32_t>(-1)).emit(LI).emit(ADD).emit(SI)
+             .emit(JMP, "inner");
+
+    assembler.label("next");
+    emit_increment(assembler, -1);
+    assembler.emit(JMP, "outer")
+             .label("done")
+             .emit(LEA, static_cast<uint32_t>(-3)).emit(LI).emit(LEV);
+
+    auto image = assembler.finish();
+    image.bss_size = limit;
+
+    std::vector<bool> composite(limit, false);
+    int32_t primes = 0;
+    for(uint32_t i = 2U; i < limit; ++i)
+    {
+        if(!composite[i])
+        {
+            ++primes;
+            for(auto j = static_cast<uint64_t>(i) * i; j < limit; j += i)
+            {
+                composite[j] = true;
+            }
+        }
+    }
+
+    return {image, primes};
+}
+
+/**********************************************************************************************//**
+ * \brief Scans a string a byte at a time counting one letter, then copies and compares it with
+ *        MCPY and MCMP
+ * \param rounds How many times to process the string
+ * \returns The program, which exits with the number of letters counted over every round
+ *************************************************************************************************/
+Benchmark_Program Programs::strings(const uint32_t rounds)
+{
+    std::string text;
+    for(uint32_t i = 0U; i < SENTENCE_REPEATS; ++i)
+    {
+        text += SENTENCE;
+    }
+
+    const auto source = static_cast<uint32_t>(DATA_START_ADDRESS);
+    const auto length = static_cast<uint32_t>(text.size());
+    const auto buffer = source + length + 1U;
+
+    // Locals: -1 is the round, -2 is the cursor and -3 is the count
+    Assembler assembler;
+    emit_start(assembler);
+
+    assembler.label("main").emit(ENT, 3U);
+    emit_assign(assembler, -3, 0U);
+    emit_assign(assembler, -1, 0U);
+
+    assembler.label("round")
+             .emit(LEA, static_cast<uint32_t>(-1)).emit(LI).emit(PUSH).emit(IMM, rounds).emit(LT).emit(JZ, "done");
+    emit_assign(assembler, -2, source);
+
+    assembler.label("scan")
+             .emit(LEA, static_cast<uint32_t>(-2)).emit(LI).emit(LC).emit(JZ, "copy")
+             .emit(LEA, static_cast<uint32_t>(-2)).emit(LI).emit(LC).emit(PUSH).emit(IMM, 'o').emit(EQ)
+             .emit(JZ, "advance");
+    emit_increment(assembler, -3);
+    assembler.label("advance");
+    emit_increment(assembler, -2);
+    assembler.emit(JMP, "scan");
+
+    assembler.label("copy")
+             .emit(IMM, buffer).emit(PUSH).emit(IMM, source).emit(PUSH).emit(IMM, length).emit(PUSH)
+             .emit(MCPY).emit(ADJ, 3U)
+             .emit(IMM, buffer).emit(PUSH).emit(IMM, source).emit(PUSH).emit(IMM, length).emit(PUSH)
+             .emit(MCMP).emit(ADJ, 3U)
+             .emit(JNZ, "mismatch");
+    emit_increment(assembler, -1);
+    assembler.emit(JMP, "round")
+             .label("mismatch")
+             .emit(IMM, static_cast<uint32_t>(-1)).emit(LEV)
+             .label("done")
+             .emit(LEA, static_cast<uint32_t>(-3)).emit(LI).emit(LEV);
+
+    auto image = assembler.finish();
+    image.data.assign(text.begin(), text.end());
+    image.data.push_back('\0');
+    image.bss_size = length;
+
+    const auto letters = std::count(text.begin(), text.end(), 'o');
+
+    return {image, static_cast<int32_t>(letters * rounds)};
+}
+
+/**********************************************************************************************//**
+ * \brief Fills an array with pseudo random numbers and insertion sorts it, a mix of word loads,
+ *        stores and comparisons
+ * \param count The number of words to sort
+ * \returns The program, which exits with the number of elements left out of order, so zero
+ *************************************************************************************************/
+Benchmark_Program Programs::sort(const uint32_t count)
+{
+    const auto array = static_cast<uint32_t>(DATA_START_ADDRESS);
+
+    // Locals: -1 is i, -2 is k, -3 is the key and -4 is the random state, later the disorder count
+    Assembler assembler;
+    emit_start(assembler);
+
+    assembler.label("main").emit(ENT, 4U);
+    emit_assign(assembler, -4, 12345U);
+    emit_assign(assembler, -1, 0U);
+
+    // state = (state * 1103515245 + 12345) & 0x7fffffff, a[i] = state % 10000
+    assembler.label("fill")
+             .emit(LEA, static_cast<uint32_t>(-1)).emit(LI).emit(PUSH).emit(IMM, count).emit(LT).emit(JZ, "sort")
+             .emit(LEA, static_cast<uint32_t>(-4)).emit(PUSH).emit(LI).emit(PUSH).emit(IMM, 1103515245U).emit(MUL)
+             .emit(PUSH).emit(IMM, 12345U).emit(ADD).emit(PUSH).emit(IMM, 0x7fffffffU).emit(AND).emit(SI);
+    emit_element_address(assembler, array, -1);
+    assembler.emit(PUSH).emit(LEA, static_cast<uint32_t>(-4)).emit(LI).emit(PUSH).emit(IMM, 10000U).emit(MOD).emit(SI);
+    emit_increment(assembler, -1);
+    assembler.emit(JMP, "fill");
+
+    assembler.label("sort");
+    emit_assign(assembler, -1, 1U);
+
+    assembler.label("outer")
+             .emit(LEA, static_cast<uint32_t>(-1)).emit(LI).emit(PUSH).emit(IMM, count).emit(LT).emit(JZ, "verify")
+             .emit(LEA, static_cast<uint32_t>(-3)).emit(PUSH);
+    emit_element_address(assembler, array, -1);
+    assembler.emit(LI).emit(SI)
+             .emit(LEA, static_cast<uint32_t>(-2)).emit(PUSH).emit(LEA, static_cast<uint32_t>(-1)).emit(LI).emit(SI);
+
+    // Shift larger elements up until the key's place is found
+    assembler.label("inner")
+             .emit(LEA, static_cast<uint32_t>(-2)).emit(LI).emit(JZ, "place");
+    emit_element_address(assembler, array, -2);
+    assembler.emit(PUSH).emit(IMM, Memory_Map::WORD_SIZE).emit(SUB).emit(LI)
+             .emit(PUSH).emit(LEA, static_cast<uint32_t>(-3)).emit(LI).emit(GT).emit(JZ, "place");
+    emit_element_address(assembler, array, -2);
+    assembler.emit(PUSH).emit(PUSH).emit(IMM, Memory_Map::WORD_SIZE).emit(SUB).emit(LI).emit(SI)
+             .emit(LEA, static_cast<uint32_t>(-2)).emit(PUSH).emit(LI).emit(PUSH).emit(IMM, 1U).emit(SUB).emit(SI)
+             .emit(JMP, "inner");
+
+    assembler.label("place");
+    emit_element_address(assembler, array, -2);
+    assembler.emit(PUSH).emit(LEA, static_cast<uint32_t>(-3)).emit(LI).emit(SI);
+    emit_increment(assembler, -1);
+    assembler.emit(JMP, "outer");
+
+    // Count the elements smaller than the one before them
+    assembler.label("verify");
+    emit_assign(assembler, -4, 0U);
+    emit_assign(assembler, -1, 1U);
+
+    assembler.label("check")
+             .emit(LEA, static_cast<uint32_t>(-1)).emit(LI).emit(PUSH).emit(IMM, count).emit(LT).emit(JZ, "done")
+             .emit(LEA, static_cast<uint32_t>(-4)).emit(PUSH);
+    emit_element_address(assembler, array, -1);
+    assembler.emit(PUSH).emit(IMM, Memory_Map::WORD_SIZE).emit(SUB).emit(LI).emit(PUSH);
+    emit_element_address(assembler, array, -1);
+    assembler.emit(LI).emit(GT)
+             .emit(PUSH).emit(LEA, static_cast<uint32_t>(-4)).emit(LI).emit(ADD).emit(SI);
+    emit_increment(assembler, -1);
+    assembler.emit(JMP, "check")
+             .label("done")
+             .emit(LEA, static_cast<uint32_t>(-4)).emit(LI).emit(LEV);
+
+    auto image = assembler.finish();
+    image.bss_size = count * Memory_Map::WORD_SIZE;
+
+    return {image, 0};
+}
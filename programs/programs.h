@@ -0,0 +1,60 @@
+#ifndef PROGRAMS_H
+#define PROGRAMS_H
+
+#include "../src/program-image.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**************************************************************************************************
+ * \brief Builds a text segment one instruction at a time. Jump and call targets may be labels
+ *        which haven't been placed yet, and are patched in when the image is finished.
+ *************************************************************************************************/
+class Assembler
+{
+public:
+    Assembler& emit(uint8_t opcode);
+    Assembler& emit(uint8_t opcode, uint32_t operand);
+    Assembler& emit(uint8_t opcode, const std::string& label);
+    Assembler& label(const std::string& name);
+
+    Program_Image finish(const std::string& entry = "_start");
+
+private:
+    std::vector<uint8_t> text;
+    std::unordered_map<std::string, uint32_t> labels;
+    std::vector<std::pair<uint32_t, std::string>> fixups; // Operand offset to the label it names
+};
+
+/**************************************************************************************************
+ * \brief A hand assembled program, along with the exit status it must finish with. A benchmark
+ *        which finishes any other way is measuring a broken program.
+ *************************************************************************************************/
+struct Benchmark_Program
+{
+    Program_Image image;
+    int32_t exit_status;
+};
+
+namespace Programs
+{
+    // Runs body, which must leave the stack as it found it, repetitions times in an unrolled loop
+    Benchmark_Program unrolled_loop(const std::vector<std::pair<uint8_t, uint32_t>>& body, uint32_t repetitions);
+
+    Benchmark_Program dispatch();
+    Benchmark_Program load_word();
+    Benchmark_Program store_word();
+    Benchmark_Program load_byte();
+    Benchmark_Program store_byte();
+    Benchmark_Program load_stack_word();
+    Benchmark_Program arithmetic(uint8_t opcode);
+
+    Benchmark_Program fib(uint32_t n);
+    Benchmark_Program sieve(uint32_t limit);
+    Benchmark_Program strings(uint32_t rounds);
+    Benchmark_Program sort(uint32_t count);
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "call-tree.h"
+
+/**********************************************************************************************//**
+ * \brief Constructor for the call tree
+ * \param entry_point Offset of the function the program starts in, which is called once
+ *************************************************************************************************/
+Call_Tree::Call_Tree(const uint32_t entry_point)
+{
+    tree.push_back({entry_point, NO_PARENT, 0UL, 1UL});
+}
+
+/**********************************************************************************************//**
+ * \brief Moves into the node for a called function, creating it the first time this call stack
+ *        is seen
+ * \param function Offset of the called function
+ *************************************************************************************************/
+void Call_Tree::enter(const uint32_t function)
+{
+    const auto key = (static_cast<uint64_t>(current) << 32U) | function;
+
+    const auto [entry, inserted] = children.emplace(key, static_cast<uint32_t>(tree.size()));
+    if(inserted)
+    {
+        tree.push_back({function, current, 0UL, 0UL});
+    }
+
+    current = entry->second;
+    ++tree[current].calls;
+}
+
+/**********************************************************************************************//**
+ * \brief Returns to the caller's node. Leaving the outermost function keeps counting in it.
+ *************************************************************************************************/
+void Call_Tree::leave()
+{
+    if(tree[current].parent != NO_PARENT)
+    {
+        current = tree[current].parent;
+    }
+}
+
+/**********************************************************************************************//**
+ * \brief Lists every call stack seen so far
+ * \returns The nodes. The first is the function at the entry point.
+ *************************************************************************************************/
+const std::vector<Call_Tree::Node>& Call_Tree::nodes() const
+{
+    return tree;
+}
+
+/**********************************************************************************************//**
+ * \brief Counts the instructions retired in each node and everything it called
+ * \returns The totals, indexed the same way as nodes()
+ *************************************************************************************************/
+std::vector<uint64_t> Call_Tree::totals() const
+{
+    std::vector<uint64_t> result(tree.size(), 0UL);
+
+    // Children are always created after their parents, so walking backwards sums bottom up
+    for(auto i = tree.size(); i-- != 0UL; )
+    {
+        result[i] += tree[i].instructions;
+        if(tree[i].parent != NO_PARENT)
+        {
+            result[tree[i].parent] += result[i];
+        }
+    }
+
+    return result;
+}
+
+/**********************************************************************************************//**
+ * \brief Names a call stack
+ * \param node The innermost call
+ * \param names The program's function names
+ * \returns The function names from the outermost call inwards, separated by semicolons
+ *************************************************************************************************/
+std::string Call_Tree::stack_name(const uint32_t node, const Function_Names& names) const
+{
+    std::vector<uint32_t> path;
+    for(auto call = node; call != NO_PARENT; call = tree[call].parent)
+    {
+        path.push_back(call);
+    }
+
+    std::string result;
+    for(auto i = path.rbegin(); i != path.rend(); ++i)
+    {
+        if(!result.empty())
+        {
+            result += ';';
+        }
+        result += function_name(names, tree[*i].function);
+    }
+
+    return result;
+}
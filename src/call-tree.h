@@ -0,0 +1,57 @@
+#ifndef CALL_TREE_H
+#define CALL_TREE_H
+
+#include "program-image.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**************************************************************************************************
+ * \brief Follows a program's calls and returns, keeping one node per distinct call stack. Each
+ *        instruction is counted against the innermost call at the time, so a node's count is the
+ *        work done in that function when reached along that stack.
+ *
+ *        Nodes are only ever added, and always after their parent, so a node's children are the
+ *        later nodes naming it as their parent, in the order they were first called.
+ *************************************************************************************************/
+class Call_Tree
+{
+public:
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+    struct Node
+    {
+        uint32_t function;
+        uint32_t parent;
+        uint64_t instructions; // Retired while this was the innermost call
+        uint64_t calls;
+    };
+
+    explicit Call_Tree(uint32_t entry_point);
+
+    void retire();
+    void enter(uint32_t function);
+    void leave();
+
+    const std::vector<Node>& nodes() const;
+    std::vector<uint64_t> totals() const;
+    std::string stack_name(uint32_t node, const Function_Names& names) const;
+
+private:
+    std::vector<Node> tree;
+    std::unordered_map<uint64_t, uint32_t> children; // (parent << 32 | function) to node
+    uint32_t current{0U};
+};
+
+/**********************************************************************************************//**
+ * \brief Counts an instruction against the innermost call. Kept in the header so the execute loop
+ *        can inline it.
+ *************************************************************************************************/
+inline void Call_Tree::retire()
+{
+    ++tree[current].instructions;
+}
+
+#endif
@@ -0,0 +1,237 @@
+#include "data-layout.h"
+
+#include <algorithm>
+
+namespace
+{
+
+/**********************************************************************************************//**
+ * \brief Rounds an alignment up to a power of two. Zero is treated as no alignment requirement.
+ * \param alignment The requested alignment, in bytes
+ * \returns The smallest power of two no smaller than the request
+ *************************************************************************************************/
+uint32_t normalise_alignment(const uint32_t alignment)
+{
+    uint32_t result = 1U;
+    while(result < alignment)
+    {
+        result <<= 1U;
+    }
+
+    return result;
+}
+
+/**********************************************************************************************//**
+ * \brief Pads a segment with zeroes until its size is a multiple of the alignment
+ * \param size The current size of the segment
+ * \param alignment A power of two
+ * \returns The padded size
+ *************************************************************************************************/
+std::size_t align_to(const std::size_t size, const uint32_t alignment)
+{
+    return (size + (alignment - 1UL)) & ~(static_cast<std::size_t>(alignment) - 1UL);
+}
+
+/**********************************************************************************************//**
+ * \brief Checks whether the first string finishes with the second
+ * \param text The longer string
+ * \param tail The candidate tail
+ * \returns True if the bytes of tail end text
+ *************************************************************************************************/
+bool ends_with(const std::vector<uint8_t>& text, const std::vector<uint8_t>& tail)
+{
+    return (tail.size() <= text.size()) && std::equal(tail.rbegin(), tail.rend(), text.rbegin());
+}
+
+};
+
+/**********************************************************************************************//**
+ * \brief Adds a string literal, including its terminating null
+ * \param literal The contents of the literal
+ * \returns The symbol naming the literal's first character
+ *************************************************************************************************/
+std::string Data_Layout::add_string(const std::string& literal)
+{
+    std::vector<uint8_t> bytes(literal.begin(), literal.end());
+    bytes.push_back(0U);
+
+    return intern(bytes, 1U, true);
+}
+
+/**********************************************************************************************//**
+ * \brief Adds a read only table, e.g. a const array with a constant initialiser
+ * \param bytes The contents of the table
+ * \param alignment Required alignment of the first byte
+ * \returns The symbol naming the table
+ *************************************************************************************************/
+std::string Data_Layout::add_constant(const std::vector<uint8_t>& bytes, const uint32_t alignment)
+{
+    return intern(bytes, normalise_alignment(alignment), false);
+}
+
+/**********************************************************************************************//**
+ * \brief Adds a named global variable. Globals are never merged, even if their contents match.
+ * \param name The name of the symbol to define
+ * \param binding Whether other translation units can see the global
+ * \param size The size of the global, in bytes
+ * \param alignment Required alignment of the global
+ * \param is_hot True if the global is accessed often enough to be kept with the other hot ones
+ * \param initialiser Starting contents. Missing bytes are zero.
+ *************************************************************************************************/
+void Data_Layout::add_global(const std::string& name, const Binding binding, const uint32_t size,
+                             const uint32_t alignment, const bool is_hot,
+                             const std::vector<uint8_t>& initialiser)
+{
+    Global global{name, binding, size, normalise_alignment(alignment), is_hot, initialiser};
+    global.initialiser.resize(std::min<std::size_t>(global.initialiser.size(), size));
+
+    // An initialiser of nothing but zeroes is no different to having no initialiser at all
+    if(std::all_of(global.initialiser.begin(), global.initialiser.end(), [](const uint8_t byte) { return byte == 0U; }))
+    {
+        global.initialiser.clear();
+    }
+
+    globals.push_back(std::move(global));
+}
+
+/**********************************************************************************************//**
+ * \brief Appends the laid out data to an object file, along with a symbol for every entry. Any
+ *        data already in the object is left where it is. The object's segment alignments are
+ *        raised to the largest alignment placed in each.
+ * \param object The object file being built
+ *************************************************************************************************/
+void Data_Layout::emit(Object_File& object) const
+{
+    const auto by_alignment = [](const auto& lhs, const auto& rhs) { return lhs.alignment > rhs.alignment; };
+
+    std::vector<Global> hot;
+    std::vector<Global> initialised;
+    std::vector<Global> zeroed;
+    for(const auto& global : globals)
+    {
+        if(global.is_hot)
+        {
+            hot.push_back(global);
+        }
+        else if(!global.initialiser.empty())
+        {
+            initialised.push_back(global);
+        }
+        else
+        {
+            zeroed.push_back(global);
+        }
+    }
+
+    std::stable_sort(hot.begin(), hot.end(), by_alignment);
+    std::stable_sort(initialised.begin(), initialised.end(), by_alignment);
+    std::stable_sort(zeroed.begin(), zeroed.end(), by_alignment);
+
+    // Each string which is the tail of another is stored inside it. Sorting the reversed strings
+    // puts every tail directly before the strings which end with it.
+    std::vector<std::size_t> strings;
+    for(std::size_t i = 0UL; i < constants.size(); ++i)
+    {
+        if(constants[i].is_string)
+        {
+            strings.push_back(i);
+        }
+    }
+
+    std::sort(strings.begin(), strings.end(), [this](const std::size_t lhs, const std::size_t rhs)
+    {
+        const auto& left = constants[lhs].bytes;
+        const auto& right = constants[rhs].bytes;
+        return std::lexicographical_compare(left.rbegin(), left.rend(), right.rbegin(), right.rend());
+    });
+
+    std::vector<std::size_t> owners(constants.size());
+    for(std::size_t i = 0UL; i < constants.size(); ++i)
+    {
+        owners[i] = i;
+    }
+
+    for(std::size_t i = strings.size(); i > 1UL; --i)
+    {
+        const auto shorter = strings[i - 2UL];
+        const auto owner = owners[strings[i - 1UL]];
+        if(ends_with(constants[owner].bytes, constants[shorter].bytes))
+        {
+            owners[shorter] = owner;
+        }
+    }
+
+    std::vector<std::size_t> stored;
+    for(std::size_t i = 0UL; i < constants.size(); ++i)
+    {
+        if(owners[i] == i)
+        {
+            stored.push_back(i);
+        }
+    }
+
+    std::stable_sort(stored.begin(), stored.end(), [this](const std::size_t lhs, const std::size_t rhs)
+    {
+        return constants[lhs].alignment > constants[rhs].alignment;
+    });
+
+    // Initialised data, hot globals first
+    const auto place_global = [&object](const Global& global)
+    {
+        const auto offset = align_to(object.data.size(), global.alignment);
+        object.data.resize(offset + global.size, 0U);
+        object.data_alignment = std::max(object.data_alignment, global.alignment);
+        std::copy(global.initialiser.begin(), global.initialiser.end(), object.data.begin() + offset);
+        object.symbols.push_back({global.name, Segment::Data, static_cast<uint32_t>(offset), global.binding});
+    };
+
+    std::for_each(hot.begin(), hot.end(), place_global);
+    std::for_each(initialised.begin(), initialised.end(), place_global);
+
+    std::vector<std::size_t> offsets(constants.size(), 0UL);
+    for(const auto i : stored)
+    {
+        const auto& constant = constants[i];
+        offsets[i] = align_to(object.data.size(), constant.alignment);
+        object.data.resize(offsets[i], 0U);
+        object.data_alignment = std::max(object.data_alignment, constant.alignment);
+        object.data.insert(object.data.end(), constant.bytes.begin(), constant.bytes.end());
+    }
+
+    for(std::size_t i = 0UL; i < constants.size(); ++i)
+    {
+        const auto owner = owners[i];
+        const auto offset = offsets[owner] + (constants[owner].bytes.size() - constants[i].bytes.size());
+        object.symbols.push_back({constants[i].symbol, Segment::Data, static_cast<uint32_t>(offset), Binding::Local});
+    }
+
+    // Zero initialised data only takes up room once loaded
+    for(const auto& global : zeroed)
+    {
+        const auto offset = align_to(object.bss_size, global.alignment);
+        object.bss_size = static_cast<uint32_t>(offset + global.size);
+        object.bss_alignment = std::max(object.bss_alignment, global.alignment);
+        object.symbols.push_back({global.name, Segment::Bss, static_cast<uint32_t>(offset), global.binding});
+    }
+}
+
+/**********************************************************************************************//**
+ * \brief Finds or creates the constant with the given contents
+ * \param bytes The contents of the constant
+ * \param alignment Required alignment, already a power of two
+ * \param is_string True if the constant is a null terminated string, and so may share a tail
+ * \returns The symbol naming the constant
+ *************************************************************************************************/
+std::string Data_Layout::intern(const std::vector<uint8_t>& bytes, const uint32_t alignment, const bool is_string)
+{
+    const auto [entry, inserted] = constant_indices.emplace(std::make_pair(bytes, alignment), constants.size());
+    if(!inserted)
+    {
+        return constants[entry->second].symbol;
+    }
+
+    const auto symbol = (is_string ? ".str." : ".const.") + std::to_string(constants.size());
+    constants.push_back({bytes, alignment, symbol, is_string});
+
+    return symbol;
+}
@@ -0,0 +1,62 @@
+#ifndef DATA_LAYOUT_H
+#define DATA_LAYOUT_H
+
+#include "object-file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**************************************************************************************************
+ * \brief Collects everything a translation unit wants in its data segment and decides where it all
+ *        goes. Code refers to the entries by symbol name, through Symbol_Address relocations, so
+ *        nothing needs an offset until the layout is emitted.
+ *
+ *        - Identical string literals and constant tables share a single copy. A string which is the
+ *          tail of a longer string shares the longer string's bytes.
+ *        - Hot globals are placed together at the start of the data segment.
+ *        - Remaining entries are sorted by alignment, largest first, so padding is only ever needed
+ *          between alignment classes.
+ *        - Cold globals without an initialiser go in the BSS segment, which takes up no space in
+ *          the object file or the linked image.
+ *************************************************************************************************/
+class Data_Layout
+{
+public:
+    std::string add_string(const std::string& literal);
+    std::string add_constant(const std::vector<uint8_t>& bytes, uint32_t alignment);
+    void add_global(const std::string& name, Binding binding, uint32_t size, uint32_t alignment,
+                    bool is_hot, const std::vector<uint8_t>& initialiser = {});
+
+    void emit(Object_File& object) const;
+
+private:
+    struct Constant
+    {
+        std::vector<uint8_t> bytes;
+        uint32_t alignment;
+        std::string symbol;
+        bool is_string;
+    };
+
+    struct Global
+    {
+        std::string name;
+        Binding binding;
+        uint32_t size;
+        uint32_t alignment;
+        bool is_hot;
+        std::vector<uint8_t> initialiser; // Empty when the global starts out as zero
+    };
+
+    std::string intern(const std::vector<uint8_t>& bytes, uint32_t alignment, bool is_string);
+
+    std::vector<Constant> constants;
+    std::map<std::pair<std::vector<uint8_t>, uint32_t>, std::size_t> constant_indices;
+    std::vector<Global> globals;
+};
+
+#endif
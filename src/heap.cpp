@@ -0,0 +1,364 @@
+#include "heap.h"
+
+#include <algorithm>
+
+/**********************************************************************************************//**
+ * \brief Measures how badly the free space below the bump pointer is broken up
+ * \returns Zero when all of the free space is in one block, approaching one as it is scattered
+ *          over many small blocks
+ *************************************************************************************************/
+double Heap_Statistics::fragmentation() const
+{
+    if(free_bytes == 0U)
+    {
+        return 0.0;
+    }
+
+    return 1.0 - (static_cast<double>(largest_free_block) / static_cast<double>(free_bytes));
+}
+
+/**********************************************************************************************//**
+ * \brief Discards every allocation and hands the heap a new region
+ * \param region_start Offset of the first usable byte. Rounded up to the granule.
+ * \param region_end Offset one past the last usable byte
+ *************************************************************************************************/
+void Heap::reset(const uint32_t region_start, const uint32_t region_end)
+{
+    start = ((region_start + (GRANULE - 1U)) / GRANULE) * GRANULE;
+    capacity = (region_end > start) ? ((region_end - start) / GRANULE) : 0U;
+    top = 0U;
+
+    sizes.assign(capacity, 0U);
+    states.assign(capacity, Block_State::None);
+    next.assign(capacity, NO_GRANULE);
+    previous.assign(capacity, NO_GRANULE);
+    footers.assign(capacity, NO_GRANULE);
+
+    small_lists.fill(NO_GRANULE);
+    large_bins.fill(NO_GRANULE);
+    occupied_bins = 0U;
+
+    counters = Heap_Statistics{};
+}
+
+/**********************************************************************************************//**
+ * \brief Allocates a block. A request for zero bytes still returns a unique block.
+ * \param size The number of bytes requested
+ * \param offset Receives the offset of the block within the data segment
+ * \returns False if the heap has no room for the request
+ *************************************************************************************************/
+bool Heap::allocate(const uint32_t size, uint32_t& offset)
+{
+    const auto granules = std::max(1U, (size / GRANULE) + (((size % GRANULE) != 0U) ? 1U : 0U));
+
+    auto granule = NO_GRANULE;
+    if((granules <= SMALL_CLASS_COUNT) && (small_lists[granules - 1U] != NO_GRANULE))
+    {
+        granule = pop_small(granules - 1U);
+    }
+    else if((granules <= SMALL_CLASS_COUNT) && bump(granules, granule))
+    {
+        // Fresh memory is cheaper than splitting a large block
+    }
+    else if(!take_large(granules, granule) && !bump(granules, granule))
+    {
+        ++counters.failed_allocations;
+        return false;
+    }
+
+    mark_used(granule, granules);
+    offset = start + (granule * GRANULE);
+
+    return true;
+}
+
+/**********************************************************************************************//**
+ * \brief Returns a block to the heap
+ * \param offset Offset of the block within the data segment, as returned by allocate
+ * \returns False if the offset isn't the start of a live allocation
+ *************************************************************************************************/
+bool Heap::release(const uint32_t offset)
+{
+    if((offset < start) || (((offset - start) % GRANULE) != 0U))
+    {
+        return false;
+    }
+
+    auto granule = (offset - start) / GRANULE;
+    if((granule >= top) || (states[granule] != Block_State::Used))
+    {
+        return false;
+    }
+
+    auto granules = sizes[granule];
+
+    ++counters.frees;
+    counters.bytes_in_use -= granules * GRANULE;
+
+    if(granules <= SMALL_CLASS_COUNT)
+    {
+        push_small(granule);
+        return true;
+    }
+
+    const auto following = granule + granules;
+    if((following < top) && (states[following] == Block_State::Free_Large))
+    {
+        granules += sizes[following];
+        remove_large(following);
+        states[following] = Block_State::None;
+    }
+
+    if(granule > 0U)
+    {
+        const auto preceding = footers[granule - 1U];
+        if((preceding != NO_GRANULE) && (states[preceding] == Block_State::Free_Large) &&
+           ((preceding + sizes[preceding]) == granule))
+        {
+            granules += sizes[preceding];
+            remove_large(preceding);
+            states[granule] = Block_State::None;
+            granule = preceding;
+        }
+    }
+
+    // A block at the top goes back to the bump pointer, where it can be reused at any size
+    if((granule + granules) == top)
+    {
+        states[granule] = Block_State::None;
+        top = granule;
+        counters.heap_size = top * GRANULE;
+        return true;
+    }
+
+    insert_large(granule, granules);
+    return true;
+}
+
+/**********************************************************************************************//**
+ * \brief Gathers the current statistics
+ * \returns The statistics. The largest free block is found by walking the bins, so this isn't
+ *          intended for use on every allocation.
+ *************************************************************************************************/
+Heap_Statistics Heap::statistics() const
+{
+    auto result = counters;
+
+    result.largest_free_block = 0U;
+    for(uint32_t size_class = SMALL_CLASS_COUNT; size_class > 0U; --size_class)
+    {
+        if(small_lists[size_class - 1U] != NO_GRANULE)
+        {
+            result.largest_free_block = size_class * GRANULE;
+            break;
+        }
+    }
+
+    for(uint32_t bin = LARGE_BIN_COUNT; bin > 0U; --bin)
+    {
+        if(large_bins[bin - 1U] == NO_GRANULE)
+        {
+            continue;
+        }
+
+        for(auto granule = large_bins[bin - 1U]; granule != NO_GRANULE; granule = next[granule])
+        {
+            result.largest_free_block = std::max(result.largest_free_block, sizes[granule] * GRANULE);
+        }
+        break;
+    }
+
+    return result;
+}
+
+/**********************************************************************************************//**
+ * \brief Carves a fresh block off the top of the heap
+ * \param granules Size of the block
+ * \param granule Receives the first granule of the block
+ * \returns False if the heap is full
+ *************************************************************************************************/
+bool Heap::bump(const uint32_t granules, uint32_t& granule)
+{
+    if(granules > (capacity - top))
+    {
+        return false;
+    }
+
+    granule = top;
+    top += granules;
+
+    counters.heap_size = top * GRANULE;
+    counters.peak_heap_size = std::max(counters.peak_heap_size, counters.heap_size);
+
+    return true;
+}
+
+/**********************************************************************************************//**
+ * \brief Finds a large free block which fits, splitting off whatever isn't needed. Any block in a
+ *        higher bin is big enough, so the request's own bin is only searched as a last resort.
+ * \param granules Size of the request
+ * \param granule Receives the first granule of the block
+ * \returns False if no free block is big enough
+ *************************************************************************************************/
+bool Heap::take_large(const uint32_t granules, uint32_t& granule)
+{
+    const auto bin = bin_of(granules);
+
+    granule = NO_GRANULE;
+    const auto higher_bins = (bin + 1U < LARGE_BIN_COUNT) ? (occupied_bins & ~((2U << bin) - 1U)) : 0U;
+    if(higher_bins != 0U)
+    {
+        auto lowest = 0U;
+        while((higher_bins & (1U << lowest)) == 0U)
+        {
+            ++lowest;
+        }
+        granule = large_bins[lowest];
+    }
+    else
+    {
+        for(auto candidate = large_bins[bin]; candidate != NO_GRANULE; candidate = next[candidate])
+        {
+            if(sizes[candidate] >= granules)
+            {
+                granule = candidate;
+                break;
+            }
+        }
+    }
+
+    if(granule == NO_GRANULE)
+    {
+        return false;
+    }
+
+    const auto available = sizes[granule];
+    remove_large(granule);
+
+    if(available > granules)
+    {
+        insert_large(granule + granules, available - granules);
+    }
+
+    return true;
+}
+
+/**********************************************************************************************//**
+ * \brief Records a block as handed out
+ * \param granule First granule of the block
+ * \param granules Size of the block
+ *************************************************************************************************/
+void Heap::mark_used(const uint32_t granule, const uint32_t granules)
+{
+    sizes[granule] = granules;
+    states[granule] = Block_State::Used;
+    footers[granule + granules - 1U] = NO_GRANULE;
+
+    ++counters.allocations;
+    counters.bytes_in_use += granules * GRANULE;
+    counters.peak_bytes_in_use = std::max(counters.peak_bytes_in_use, counters.bytes_in_use);
+}
+
+/**********************************************************************************************//**
+ * \brief Pushes a freed small block onto the list for its size
+ * \param granule First granule of the block
+ *************************************************************************************************/
+void Heap::push_small(const uint32_t granule)
+{
+    const auto size_class = sizes[granule] - 1U;
+
+    states[granule] = Block_State::Free_Small;
+    next[granule] = small_lists[size_class];
+    small_lists[size_class] = granule;
+
+    counters.free_bytes += sizes[granule] * GRANULE;
+}
+
+/**********************************************************************************************//**
+ * \brief Pops a block off a size class list
+ * \param size_class The list to pop from, which must not be empty
+ * \returns First granule of the block
+ *************************************************************************************************/
+uint32_t Heap::pop_small(const uint32_t size_class)
+{
+    const auto granule = small_lists[size_class];
+    small_lists[size_class] = next[granule];
+
+    counters.free_bytes -= sizes[granule] * GRANULE;
+
+    return granule;
+}
+
+/**********************************************************************************************//**
+ * \brief Adds a free block to the front of its bin, and tags its last granule so the block after
+ *        it can find it when merging
+ * \param granule First granule of the block
+ * \param granules Size of the block
+ *************************************************************************************************/
+void Heap::insert_large(const uint32_t granule, const uint32_t granules)
+{
+    const auto bin = bin_of(granules);
+
+    sizes[granule] = granules;
+    states[granule] = Block_State::Free_Large;
+    footers[granule + granules - 1U] = granule;
+
+    previous[granule] = NO_GRANULE;
+    next[granule] = large_bins[bin];
+    if(large_bins[bin] != NO_GRANULE)
+    {
+        previous[large_bins[bin]] = granule;
+    }
+
+    large_bins[bin] = granule;
+    occupied_bins |= (1U << bin);
+
+    counters.free_bytes += granules * GRANULE;
+}
+
+/**********************************************************************************************//**
+ * \brief Unlinks a free block from its bin
+ * \param granule First granule of the block
+ *************************************************************************************************/
+void Heap::remove_large(const uint32_t granule)
+{
+    const auto bin = bin_of(sizes[granule]);
+
+    if(previous[granule] != NO_GRANULE)
+    {
+        next[previous[granule]] = next[granule];
+    }
+    else
+    {
+        large_bins[bin] = next[granule];
+    }
+
+    if(next[granule] != NO_GRANULE)
+    {
+        previous[next[granule]] = previous[granule];
+    }
+
+    if(large_bins[bin] == NO_GRANULE)
+    {
+        occupied_bins &= ~(1U << bin);
+    }
+
+    footers[granule + sizes[granule] - 1U] = NO_GRANULE;
+    counters.free_bytes -= sizes[granule] * GRANULE;
+}
+
+/**********************************************************************************************//**
+ * \brief Picks the bin for a large block
+ * \param granules Size of the block
+ * \returns The position of the highest set bit in the size
+ *************************************************************************************************/
+uint32_t Heap::bin_of(const uint32_t granules)
+{
+    uint32_t bin = 0U;
+    while((granules >> (bin + 1U)) != 0U)
+    {
+        ++bin;
+    }
+
+    return bin;
+}
@@ -0,0 +1,97 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/**************************************************************************************************
+ * \brief A snapshot of how the heap is being used
+ *************************************************************************************************/
+struct Heap_Statistics
+{
+    uint32_t bytes_in_use{0U};       // Held by live allocations, after rounding to the granule
+    uint32_t peak_bytes_in_use{0U};
+    uint32_t heap_size{0U};          // Distance from the start of the heap to the bump pointer
+    uint32_t peak_heap_size{0U};
+    uint32_t free_bytes{0U};         // Free blocks below the bump pointer
+    uint32_t largest_free_block{0U};
+    uint64_t allocations{0UL};
+    uint64_t frees{0UL};
+    uint64_t failed_allocations{0UL};
+
+    double fragmentation() const;
+};
+
+/**************************************************************************************************
+ * \brief Allocator for a region of the data segment. The bookkeeping lives on the host rather than
+ *        in the region itself, so a misbehaving program can't corrupt it.
+ *
+ *        - Requests up to SMALL_CLASS_COUNT granules are served from a free list per size.
+ *          Freeing one pushes it back on its list, with no splitting or merging.
+ *        - Larger blocks are kept in bins by power of two. They are split on allocation, and merged
+ *          with free neighbours when released.
+ *        - When no free block fits, a fresh one is bumped off the top of the heap. Large blocks
+ *          released at the top are handed back to the bump pointer.
+ *
+ *        Every operation is constant time, other than the search of a single bin when a large
+ *        request falls within the same power of two as the free blocks.
+ *************************************************************************************************/
+class Heap
+{
+public:
+    static constexpr uint32_t GRANULE = 8U;
+    static constexpr uint32_t SMALL_CLASS_COUNT = 32U;
+    static constexpr uint32_t LARGE_BIN_COUNT = 32U;
+
+    Heap() = default;
+
+    void reset(uint32_t start, uint32_t end);
+
+    bool allocate(uint32_t size, uint32_t& offset);
+    bool release(uint32_t offset);
+
+    Heap_Statistics statistics() const;
+
+private:
+    enum class Block_State : uint8_t
+    {
+        None,       // Not the first granule of a block
+        Used,
+        Free_Small, // On one of the size class lists
+        Free_Large  // In one of the bins, and may be merged with its neighbours
+    };
+
+    static constexpr uint32_t NO_GRANULE = UINT32_MAX;
+
+    bool bump(uint32_t granules, uint32_t& granule);
+    bool take_large(uint32_t granules, uint32_t& granule);
+
+    void mark_used(uint32_t granule, uint32_t granules);
+    void push_small(uint32_t granule);
+    uint32_t pop_small(uint32_t size_class);
+    void insert_large(uint32_t granule, uint32_t granules);
+    void remove_large(uint32_t granule);
+
+    static uint32_t bin_of(uint32_t granules);
+
+    uint32_t start{0U};
+    uint32_t capacity{0U}; // In granules
+    uint32_t top{0U};      // Bump pointer, in granules from the start
+
+    // Indexed by granule. Only meaningful for the first granule of a block, apart from the footers
+    // which are written to the last granule of each large free block.
+    std::vector<uint32_t> sizes;
+    std::vector<Block_State> states;
+    std::vector<uint32_t> next;
+    std::vector<uint32_t> previous;
+    std::vector<uint32_t> footers;
+
+    std::array<uint32_t, SMALL_CLASS_COUNT> small_lists{};
+    std::array<uint32_t, LARGE_BIN_COUNT> large_bins{};
+    uint32_t occupied_bins{0U}; // Bit set for every non-empty large bin
+
+    Heap_Statistics counters;
+};
+
+#endif
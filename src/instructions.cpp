@@ -0,0 +1,140 @@
+#include "instructions.h"
+#include "memory-map.h"
+
+namespace
+{
+
+constexpr const char* MNEMONICS[INSTRUCTION_COUNT] = {
+    "LEA",  "IMM",  "PUSH", "JMP",  "JZ",   "JNZ",  "CALL", "ENT",
+    "ADJ",  "LEV",  "LI",   "LC",   "SI",   "SC",   "OR",   "XOR",
+    "AND",  "EQ",   "NE",   "LT",   "GT",   "LE",   "GE",   "SHL",
+    "SHR",  "ADD",  "SUB",  "MUL",  "DIV",  "MOD",  "OPEN", "READ",
+    "CLOS", "PRTF", "MALC", "MSET", "MCMP", "EXIT",
+    "FREE", "MCPY"
+};
+
+};
+
+/**********************************************************************************************//**
+ * \brief Checks whether the instruction is followed by a word sized argument
+ * \param opcode The instruction being queried
+ * \returns True if the opcode takes an argument
+ *************************************************************************************************/
+bool has_operand(const uint8_t opcode)
+{
+    switch(opcode)
+    {
+        case Instructions::LEA:
+        case Instructions::IMM:
+        case Instructions::JMP:
+        case Instructions::JZ:
+        case Instructions::JNZ:
+        case Instructions::CALL:
+        case Instructions::ENT:
+        case Instructions::ADJ:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/**********************************************************************************************//**
+ * \brief Checks whether the instruction's argument is an address in the text segment
+ * \param opcode The instruction being queried
+ * \returns True for jumps and calls
+ *************************************************************************************************/
+bool is_branch(const uint8_t opcode)
+{
+    return (opcode == Instructions::JMP) ||
+           (opcode == Instructions::JZ)  ||
+           (opcode == Instructions::JNZ) ||
+           (opcode == Instructions::CALL);
+}
+
+/**********************************************************************************************//**
+ * \brief Checks whether the instruction pops its left hand side off the stack and combines it with
+ *        the ax register
+ * \param opcode The instruction being queried
+ * \returns True for OR through MOD
+ *************************************************************************************************/
+bool is_binary_operation(const uint8_t opcode)
+{
+    return (opcode >= Instructions::OR) && (opcode <= Instructions::MOD);
+}
+
+/**********************************************************************************************//**
+ * \brief Computes how many bytes of text the instruction occupies
+ * \param opcode The instruction being queried
+ * \returns The size of the opcode plus its argument
+ *************************************************************************************************/
+uint32_t instruction_size(const uint8_t opcode)
+{
+    return has_operand(opcode) ? (1U + Memory_Map::WORD_SIZE) : 1U;
+}
+
+/**********************************************************************************************//**
+ * \brief Retrieves the printable name of an instruction
+ * \param opcode The instruction being queried
+ * \returns The mnemonic, or "???" for bytes which aren't instructions
+ *************************************************************************************************/
+const char* mnemonic(const uint8_t opcode)
+{
+    if(opcode >= INSTRUCTION_COUNT)
+    {
+        return "???";
+    }
+
+    return MNEMONICS[opcode];
+}
+
+/**********************************************************************************************//**
+ * \brief Splits a block of text into instructions. Decoding stops early if the final instruction's
+ *        argument is cut short by the end of the text.
+ * \param text The encoded instructions
+ * \returns The decoded instructions, in order
+ *************************************************************************************************/
+std::vector<Instruction> decode(const std::vector<uint8_t>& text)
+{
+    std::vector<Instruction> instructions;
+
+    std::size_t offset = 0UL;
+    while(offset < text.size())
+    {
+        const auto opcode = text[offset];
+        if((offset + instruction_size(opcode)) > text.size())
+        {
+            break;
+        }
+
+        const auto operand = has_operand(opcode) ? Memory_Map::load_word(text, offset + 1UL) : 0U;
+        instructions.push_back({static_cast<uint32_t>(offset), opcode, operand});
+
+        offset += instruction_size(opcode);
+    }
+
+    return instructions;
+}
+
+/**********************************************************************************************//**
+ * \brief Encodes instructions back into text. The offsets of the instructions are ignored, they
+ *        are packed one after the other.
+ * \param instructions The instructions to encode
+ * \returns The encoded text
+ *************************************************************************************************/
+std::vector<uint8_t> encode(const std::vector<Instruction>& instructions)
+{
+    std::vector<uint8_t> text;
+
+    for(const auto& instruction : instructions)
+    {
+        text.push_back(instruction.opcode);
+        if(has_operand(instruction.opcode))
+        {
+            text.resize(text.size() + Memory_Map::WORD_SIZE);
+            Memory_Map::store_word(text, text.size() - Memory_Map::WORD_SIZE, instruction.operand);
+        }
+    }
+
+    return text;
+}
@@ -0,0 +1,84 @@
+#ifndef INSTRUCTIONS_H
+#define INSTRUCTIONS_H
+
+#include <cstdint>
+#include <vector>
+
+// Every instruction is a single opcode byte. Instructions which take an argument are followed by
+// a big endian word holding that argument.
+enum Instructions : uint8_t
+{
+    LEA = 0x00,
+    IMM, // Replacement for the MOV instruction
+
+    // Function foundation instructions
+    PUSH,
+    JMP,
+    JZ,
+    JNZ,
+
+    //
+    CALL,
+    ENT,
+    ADJ,
+    LEV,
+
+    // Replacements for the MOV instruction
+    LI,
+    LC,
+    SI,
+    SC,
+
+    // Arithmetic Operations
+    OR,
+    XOR,
+    AND,
+    EQ,
+    NE,
+    LT,
+    GT,
+    LE,
+    GE,
+    SHL,
+    SHR,
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    MOD,
+
+    // Shortcuts for system calls
+    OPEN,
+    READ,
+    CLOS,
+    PRTF,
+    MALC,
+    MSET,
+    MCMP,
+    EXIT,
+    FREE, // Returns a block from MALC to the heap
+    MCPY, // memmove, so overlapping ranges are safe
+
+    INSTRUCTION_COUNT
+};
+
+/**************************************************************************************************
+ * \brief A single decoded instruction
+ *************************************************************************************************/
+struct Instruction
+{
+    uint32_t offset;  // Offset of the opcode within the text it was decoded from
+    uint8_t opcode;
+    uint32_t operand; // Zero for instructions without an argument
+};
+
+bool has_operand(uint8_t opcode);
+bool is_branch(uint8_t opcode);
+bool is_binary_operation(uint8_t opcode);
+uint32_t instruction_size(uint8_t opcode);
+const char* mnemonic(uint8_t opcode);
+
+std::vector<Instruction> decode(const std::vector<uint8_t>& text);
+std::vector<uint8_t> encode(const std::vector<Instruction>& instructions);
+
+#endif
@@ -1,9 +1,20 @@
 #include "interpreter.h"
+#include "data-layout.h"
+#include "instructions.h"
+#include "linker.h"
+#include "perf-counters.h"
+#include "profiler.h"
+#include "syscall-log.h"
+#include "trace.h"
 #include "virtual-machine.h"
 
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <thread>
 
 namespace Interpreter
 {
@@ -11,8 +22,12 @@ namespace Interpreter
 /**********************************************************************************************//**
  * \brief Function to process the provided file_contents
  * \param file_contents The text for the provided file
+ * \param data Collects the literals and globals declared by the file. There's no parser yet, so
+ *        nothing is added and the layout's interning and placement don't run through Interpret.
+ *        Once there is, the code refers to each entry by the symbol add_string, add_constant or
+ *        add_global returns, and compile_file emits the layout into the object.
  *************************************************************************************************/
-std::vector<uint8_t> evaluate_tokens(const std::string& file_contents)
+std::vector<uint8_t> evaluate_tokens(const std::string& file_contents, [[maybe_unused]] Data_Layout& data)
 {
     std::vector<uint8_t> result;
 
@@ -25,33 +40,323 @@ std::vector<uint8_t> evaluate_tokens(const std::string& file_contents)
 }
 
 /**********************************************************************************************//**
- * \brief Main entry point to the interpreter
+ * \brief The outcome of compiling a single translation unit
+ *************************************************************************************************/
+struct Compilation
+{
+    Response_Code status;
+    Object_File object;
+    Optimizer::Statistics statistics;
+};
+
+/**********************************************************************************************//**
+ * \brief Compiles a single file into a relocatable object. Safe to call from multiple threads, as
+ *        no state is shared between translation units.
  * \param file_path Path to the provided file
+ * \param options Controls how the file is compiled
  *************************************************************************************************/
-Response_Code Interpret(const std::string& file_path)
+Compilation compile_file(const std::string& file_path, const Options& options)
 {
-	if(file_path.back() != 'c')
-	{
-		return Response_Code::Invalid_File_Type;
-	}
+    Compilation result{Response_Code::Success, {}, {}};
+    result.object.source_path = file_path;
+
+    if(file_path.empty() || (file_path.back() != 'c'))
+    {
+        result.status = Response_Code::Invalid_File_Type;
+        return result;
+    }
 
     std::ifstream stream(file_path);
     if(stream.fail())
     {
-        return Response_Code::File_Read_Error;
+        result.status = Response_Code::File_Read_Error;
+        return result;
     }
 
     std::stringstream buffer;
     buffer << stream.rdbuf();
 
     const auto file_contents = buffer.str();
-    const auto program = evaluate_tokens(file_contents);
+    Data_Layout data;
+    result.object.text = evaluate_tokens(file_contents, data);
+    data.emit(result.object);
+
+    result.statistics = Optimizer::optimize(result.object, options.optimization_level);
+
+    return result;
+}
+
+/**********************************************************************************************//**
+ * \brief Compiles every file, spreading the translation units over the available cores. Results
+ *        are returned in the same order as the provided paths so the link order is stable.
+ * \param file_paths Paths to the provided files
+ * \param options Controls how the files are compiled
+ *************************************************************************************************/
+std::vector<Compilation> compile_files(const std::vector<std::string>& file_paths, const Options& options)
+{
+    std::vector<Compilation> results(file_paths.size());
+
+    const auto hardware_threads = std::max(1U, std::thread::hardware_concurrency());
+    const auto worker_count = std::min<std::size_t>(hardware_threads, file_paths.size());
+
+    std::atomic<std::size_t> next_file{0UL};
+    const auto worker = [&]()
+    {
+        for(auto i = next_file++; i < file_paths.size(); i = next_file++)
+        {
+            results[i] = compile_file(file_paths[i], options);
+        }
+    };
+
+    // The calling thread takes a share of the work rather than sitting idle in join()
+    std::vector<std::thread> workers;
+    for(std::size_t i = 1UL; i < worker_count; ++i)
+    {
+        workers.emplace_back(worker);
+    }
+
+    worker();
+
+    for(auto& thread : workers)
+    {
+        thread.join();
+    }
+
+    return results;
+}
+
+/**********************************************************************************************//**
+ * \brief Describes the trap which stopped a program, along with the machine's state at the time
+ * \param trap The trap raised by the virtual machine
+ *************************************************************************************************/
+void report_trap(const Trap& trap)
+{
+    const char* description = "unknown fault";
+    switch(trap.code)
+    {
+        case Fault_Code::Bad_Address:     description = "bad address";                    break;
+        case Fault_Code::Divide_By_Zero:  description = "divide by zero";                 break;
+        case Fault_Code::Stack_Overflow:  description = "stack overflow";                 break;
+        case Fault_Code::Bad_Opcode:      description = "bad opcode";                     break;
+        case Fault_Code::Replay_Mismatch: description = "diverged from the recorded run"; break;
+        default:                                                                          break;
+    }
+
+    std::cerr << "Fatal error: " << description;
+    if((trap.code == Fault_Code::Bad_Address) || (trap.code == Fault_Code::Stack_Overflow))
+    {
+        std::cerr << " at 0x" << std::hex << std::setw(8) << std::setfill('0') << trap.address << std::dec;
+    }
+
+    std::cerr << " in " << mnemonic(trap.opcode) << " at pc " << trap.program_counter
+              << " (ax " << trap.ax << ", bp " << trap.base_pointer << ", sp " << trap.stack_pointer << ")"
+              << std::endl;
+}
+
+/**********************************************************************************************//**
+ * \brief Writes the folded call stacks and the JSON summary collected by a profiler
+ * \param profiler The profile of the finished run
+ * \param path The path to write to, before the extension is added
+ *************************************************************************************************/
+void write_profile(const Profiler& profiler, const std::string& path)
+{
+    std::ofstream folded(path + ".folded");
+    profiler.write_folded_stacks(folded);
+
+    std::ofstream summary(path + ".json");
+    profiler.write_summary(summary);
+
+    if(folded.fail() || summary.fail())
+    {
+        std::cerr << "Unable to write the profile to " << path << std::endl;
+    }
+}
+
+/**********************************************************************************************//**
+ * \brief Converts the trap which stopped a program into the interpreter's result
+ * \param trap The trap raised by the virtual machine
+ * \returns Success if the program exited, otherwise the code for the fault
+ *************************************************************************************************/
+Response_Code to_response_code(const Trap& trap)
+{
+    switch(trap.code)
+    {
+        case Fault_Code::Bad_Address:     return Response_Code::Bad_Address;
+        case Fault_Code::Divide_By_Zero:  return Response_Code::Divide_By_Zero;
+        case Fault_Code::Stack_Overflow:  return Response_Code::Stack_Overflow;
+        case Fault_Code::Bad_Opcode:      return Response_Code::Bad_Opcode;
+        case Fault_Code::Replay_Mismatch: return Response_Code::Replay_Mismatch;
+        default:                          return Response_Code::Success;
+    }
+}
+
+/**********************************************************************************************//**
+ * \brief Main entry point to the interpreter
+ * \param file_path Path to the provided file
+ * \param options Controls how the file is compiled and run
+ *************************************************************************************************/
+Response_Code Interpret(const std::string& file_path, const Options& options)
+{
+    return Interpret(std::vector<std::string>{file_path}, options);
+}
+
+/**********************************************************************************************//**
+ * \brief Main entry point to the interpreter for programs spread over multiple translation units.
+ *        Each file is compiled independently, then the objects are linked into a single image.
+ * \param file_paths Paths to the provided files, in link order
+ * \param options Controls how the files are compiled and run
+ *************************************************************************************************/
+Response_Code Interpret(const std::vector<std::string>& file_paths, const Options& options)
+{
+    auto compilations = compile_files(file_paths, options);
+
+    std::vector<Object_File> objects;
+    objects.reserve(compilations.size());
+
+    Optimizer::Statistics totals;
+    for(auto& compilation : compilations)
+    {
+        if(compilation.status != Response_Code::Success)
+        {
+            return compilation.status;
+        }
+
+        totals.instructions_before += compilation.statistics.instructions_before;
+        totals.instructions_after += compilation.statistics.instructions_after;
+        objects.push_back(std::move(compilation.object));
+    }
+
+    if(options.optimization_level != Optimizer::Level::O0)
+    {
+        std::cout << "Instructions: " << totals.instructions_before << " before optimisation, "
+                  << totals.instructions_after << " after" << std::endl;
+    }
+
+    // Nothing was compiled, so there is nothing to link or run
+    const auto has_code = std::any_of(objects.begin(), objects.end(), [](const Object_File& object)
+    {
+        return !object.text.empty();
+    });
+    if(!has_code)
+    {
+        return Response_Code::Success;
+    }
+
+    Program_Image image;
+    const auto [status, detail] = Linker::link(objects, image);
+    if(status != Linker::Link_Status::Success)
+    {
+        std::cerr << detail << std::endl;
+        return Response_Code::Link_Error;
+    }
 
     Virtual_Machine vm;
-    vm.load(program);
-    vm.execute();
+    if(!vm.load(image))
+    {
+        std::cerr << "The program doesn't fit in the virtual machine's memory" << std::endl;
+        return Response_Code::Load_Error;
+    }
+
+    Syscall_Log syscalls(options.replay_path.empty() ? Syscall_Log::Mode::Record : Syscall_Log::Mode::Replay);
+    if(!options.replay_path.empty())
+    {
+        if(!options.record_path.empty())
+        {
+            std::cerr << "A run can't be recorded while it's replayed, so it's only replayed" << std::endl;
+        }
+
+        std::string error;
+        if(!syscalls.load(options.replay_path, error))
+        {
+            std::cerr << error << std::endl;
+            return Response_Code::File_Read_Error;
+        }
+        syscalls.set_compares_addresses(options.use_strict_replay);
+        vm.set_syscall_log(&syscalls);
+    }
+    else if(!options.record_path.empty())
+    {
+        vm.set_syscall_log(&syscalls);
+    }
+
+    Trace_Writer tracer;
+    const auto is_tracing = !options.trace_path.empty() && tracer.open(options.trace_path, image);
+    if(is_tracing)
+    {
+        vm.set_trace(&tracer);
+    }
+    else if(!options.trace_path.empty())
+    {
+        // The program still runs, just without the trace
+        std::cerr << tracer.error() << std::endl;
+    }
+
+    Trap trap;
+    if(!options.profile_path.empty())
+    {
+        if(options.use_perf_counters)
+        {
+            std::cerr << "Performance counters can't be combined with profiling, so only the profile is collected" << std::endl;
+        }
+
+        Profiler profiler(image);
+        trap = vm.execute(profiler);
+        write_profile(profiler, options.profile_path);
+    }
+    else if(options.use_perf_counters)
+    {
+        Perf_Counters counters;
+        if(counters.open())
+        {
+            counters.start();
+            trap = vm.execute(counters);
+            counters.stop();
+        }
+        else
+        {
+            // The program still runs, just without the counters
+            trap = vm.execute();
+        }
+
+        counters.write_report(std::cerr);
+    }
+    else
+    {
+        trap = vm.execute();
+    }
+
+    if(is_tracing)
+    {
+        vm.set_trace(nullptr);
+        if(!tracer.close())
+        {
+            std::cerr << tracer.error() << std::endl;
+        }
+    }
+
+    if(!options.replay_path.empty())
+    {
+        if((trap.code == Fault_Code::Exit) && (syscalls.remaining() != 0UL))
+        {
+            std::cerr << "The program exited with " << syscalls.remaining()
+                      << " recorded system calls still to replay" << std::endl;
+        }
+    }
+    else if(!options.record_path.empty())
+    {
+        std::string error;
+        if(!syscalls.save(options.record_path, error))
+        {
+            std::cerr << error << std::endl;
+        }
+    }
+
+    if(trap.code != Fault_Code::Exit)
+    {
+        report_trap(trap);
+    }
 
-    return Response_Code::Success;
+    return to_response_code(trap);
 }
 
 } // Namespace Interpreter
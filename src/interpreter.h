@@ -1,7 +1,10 @@
 #ifndef INTERPRETER_H
 #define INTERPRETER_H
 
+#include "optimizer.h"
+
 #include <string>
+#include <vector>
 #include <cstdint>
 
 namespace Interpreter
@@ -10,10 +13,47 @@ namespace Interpreter
 	{
         Success = 0,
         Invalid_File_Type = -1,
-        File_Read_Error = -2
+        File_Read_Error = -2,
+        Link_Error = -3,
+
+        // The program was stopped by a fault
+        Bad_Address = -4,
+        Divide_By_Zero = -5,
+        Stack_Overflow = -6,
+        Bad_Opcode = -7,
+        Replay_Mismatch = -8,
+
+        // The linked program doesn't fit in the virtual machine's memory
+        Load_Error = -9
+	};
+
+	struct Options
+	{
+        Optimizer::Level optimization_level{Optimizer::Level::O0};
+
+        // When set, the program is profiled and the results written to this path with ".folded"
+        // and ".json" appended
+        std::string profile_path;
+
+        // Samples the host's performance counters and reports each opcode's share of the samples,
+        // its IPC and branch miss rate where the host allows rdpmc, and the whole run's counters
+        bool use_perf_counters{false};
+
+        // When set, every instruction executed is traced to this file, which trace-decoder reads
+        std::string trace_path;
+
+        // Records the result of every system call to this file, or replays them from it. A
+        // replayed run doesn't touch the host's files or print anything.
+        std::string record_path;
+        std::string replay_path;
+
+        // When replaying, MALC must return the same addresses as the recorded run rather than
+        // only failing in the same places
+        bool use_strict_replay{false};
 	};
 
-	Response_Code Interpret(const std::string& file_path);
+	Response_Code Interpret(const std::string& file_path, const Options& options = Options{});
+	Response_Code Interpret(const std::vector<std::string>& file_paths, const Options& options = Options{});
 };
 
 #endif
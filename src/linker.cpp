@@ -0,0 +1,249 @@
+#include "instructions.h"
+#include "linker.h"
+#include "memory-map.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace Linker
+{
+
+namespace
+{
+
+/**********************************************************************************************//**
+ * \brief Where a single object file ended up inside the final image
+ *************************************************************************************************/
+struct Placement
+{
+    uint32_t text_base;
+    uint32_t data_base;
+    uint32_t bss_base; // Offset from the start of the data segment, as BSS follows all of the data
+};
+
+/**********************************************************************************************//**
+ * \brief Rounds the given size up to the next multiple of an alignment. Every segment starts on at
+ *        least a word boundary, whatever its object asks for.
+ * \param size The unaligned size
+ * \param alignment The alignment the object's segment needs
+ * \returns The aligned size
+ *************************************************************************************************/
+std::size_t align_to(const std::size_t size, const uint32_t alignment = 1U)
+{
+    const auto boundary = std::max<std::size_t>(Memory_Map::WORD_SIZE, alignment);
+    return ((size + (boundary - 1UL)) / boundary) * boundary;
+}
+
+/**********************************************************************************************//**
+ * \brief Encodes the start up code placed at the front of every image. It calls main, then exits
+ *        with whatever main returns, so main has a caller frame to return to.
+ * \param main_address Where main was placed
+ * \returns The code, padded to a whole number of words
+ *************************************************************************************************/
+std::vector<uint8_t> start_stub(const uint32_t main_address)
+{
+    auto stub = encode({{0, Instructions::CALL, main_address},
+                        {0, Instructions::PUSH, 0},
+                        {0, Instructions::EXIT, 0}});
+    stub.resize(align_to(stub.size()), 0U);
+    return stub;
+}
+
+/**********************************************************************************************//**
+ * \brief Computes the final address of a symbol. Text addresses are offsets into the text
+ *        segment, as that is what the program counter holds. Data addresses are absolute.
+ * \param symbol The symbol being resolved
+ * \param placement Where the symbol's object file was placed
+ * \returns The address the symbol resolves to
+ *************************************************************************************************/
+uint32_t symbol_address(const Symbol& symbol, const Placement& placement)
+{
+    if(symbol.segment == Segment::Text)
+    {
+        return placement.text_base + symbol.offset;
+    }
+
+    if(symbol.segment == Segment::Bss)
+    {
+        return static_cast<uint32_t>(Memory_Map::DATA_START_ADDRESS) + placement.bss_base + symbol.offset;
+    }
+
+    return static_cast<uint32_t>(Memory_Map::DATA_START_ADDRESS) + placement.data_base + symbol.offset;
+}
+
+/**********************************************************************************************//**
+ * \brief Builds a printable name for an object file, for use in link errors
+ * \param object The object being described
+ * \param index Position of the object in the link order
+ * \returns The object's source path, or its index when the path is unknown
+ *************************************************************************************************/
+std::string describe(const Object_File& object, const std::size_t index)
+{
+    if(object.source_path.empty())
+    {
+        return "object #" + std::to_string(index);
+    }
+
+    return object.source_path;
+}
+
+};
+
+/**********************************************************************************************//**
+ * \brief Merges a set of relocatable object files into a single program image. The image starts
+ *        with a stub, named _start, which calls main and exits with its result. Objects are laid
+ *        out after it in the order provided. Each segment starts on a word boundary, or on the
+ *        object's own alignment for that segment if larger. The BSS of every object is placed
+ *        after all of the initialised data, so it never has to be stored in the image.
+ * \param objects The object files to merge
+ * \param image The resulting image. Only valid when the link succeeds.
+ * \returns The status of the link, plus a description of the first error encountered
+ *************************************************************************************************/
+Link_Result link(const std::vector<Object_File>& objects, Program_Image& image)
+{
+    image = Program_Image{};
+
+    // Pass one: decide where each object lives
+    std::vector<Placement> placements;
+    placements.reserve(objects.size());
+
+    std::size_t text_size = start_stub(0U).size();
+    std::size_t data_size = 0UL;
+    for(const auto& object : objects)
+    {
+        const auto data_base = align_to(data_size, object.data_alignment);
+        placements.push_back({static_cast<uint32_t>(text_size), static_cast<uint32_t>(data_base), 0U});
+        text_size += align_to(object.text.size());
+        data_size = data_base + object.data.size();
+    }
+    data_size = align_to(data_size);
+
+    std::size_t bss_end = data_size;
+    for(std::size_t i = 0UL; i < objects.size(); ++i)
+    {
+        const auto bss_base = align_to(bss_end, objects[i].bss_alignment);
+        placements[i].bss_base = static_cast<uint32_t>(bss_base);
+        bss_end = bss_base + objects[i].bss_size;
+    }
+    const auto bss_size = align_to(bss_end) - data_size;
+
+    if(text_size > Memory_Map::TEXT_SIZE)
+    {
+        return {Link_Status::Image_Too_Large, "Text segment needs " + std::to_string(text_size) + " bytes"};
+    }
+
+    if((data_size + bss_size) > Memory_Map::DATA_SIZE)
+    {
+        return {Link_Status::Image_Too_Large, "Data segment needs " + std::to_string(data_size + bss_size) + " bytes"};
+    }
+
+    // Pass two: build the global symbol table
+    image.symbols.emplace("_start", 0U);
+    for(std::size_t i = 0UL; i < objects.size(); ++i)
+    {
+        for(const auto& symbol : objects[i].symbols)
+        {
+            if(symbol.binding != Binding::Global)
+            {
+                continue;
+            }
+
+            const auto [entry, inserted] = image.symbols.emplace(symbol.name, symbol_address(symbol, placements[i]));
+            if(!inserted)
+            {
+                return {Link_Status::Duplicate_Symbol, "'" + symbol.name + "' redefined in " + describe(objects[i], i)};
+            }
+        }
+    }
+
+    // Pass three: copy the segments in and patch every relocation
+    image.text.resize(text_size, 0U);
+    image.data.resize(data_size, 0U);
+    image.bss_size = static_cast<uint32_t>(bss_size);
+
+    for(std::size_t i = 0UL; i < objects.size(); ++i)
+    {
+        const auto& object = objects[i];
+        const auto& placement = placements[i];
+
+        std::copy(object.text.begin(), object.text.end(), image.text.begin() + placement.text_base);
+        std::copy(object.data.begin(), object.data.end(), image.data.begin() + placement.data_base);
+
+        std::unordered_map<std::string, uint32_t> local_symbols;
+        for(const auto& symbol : object.symbols)
+        {
+            if(symbol.binding == Binding::Local)
+            {
+                local_symbols[symbol.name] = symbol_address(symbol, placement);
+            }
+        }
+
+        for(const auto& relocation : object.relocations)
+        {
+            if(relocation.segment == Segment::Bss)
+            {
+                return {Link_Status::Bad_Relocation,
+                        "Relocation at " + std::to_string(relocation.offset) + " is inside the BSS of " + describe(object, i)};
+            }
+
+            const auto& source = (relocation.segment == Segment::Text) ? object.text : object.data;
+            auto& destination = (relocation.segment == Segment::Text) ? image.text : image.data;
+            const auto base = (relocation.segment == Segment::Text) ? placement.text_base : placement.data_base;
+
+            if((static_cast<std::size_t>(relocation.offset) + Memory_Map::WORD_SIZE) > source.size())
+            {
+                return {Link_Status::Bad_Relocation,
+                        "Relocation at " + std::to_string(relocation.offset) + " overruns " + describe(object, i)};
+            }
+
+            uint32_t adjustment{0U};
+            switch(relocation.type)
+            {
+                case Relocation_Type::Text_Address:
+                    adjustment = placement.text_base;
+                    break;
+
+                case Relocation_Type::Data_Address:
+                    adjustment = static_cast<uint32_t>(Memory_Map::DATA_START_ADDRESS) + placement.data_base;
+                    break;
+
+                case Relocation_Type::Symbol_Address:
+                {
+                    const auto local = local_symbols.find(relocation.symbol);
+                    const auto global = image.symbols.find(relocation.symbol);
+                    if(local != local_symbols.end())
+                    {
+                        adjustment = local->second;
+                    }
+                    else if(global != image.symbols.end())
+                    {
+                        adjustment = global->second;
+                    }
+                    else
+                    {
+                        return {Link_Status::Undefined_Symbol,
+                                "'" + relocation.symbol + "' referenced from " + describe(object, i)};
+                    }
+                    break;
+                }
+            }
+
+            const auto address = base + relocation.offset;
+            Memory_Map::store_word(destination, address, Memory_Map::load_word(destination, address) + adjustment);
+        }
+    }
+
+    const auto main_symbol = image.symbols.find("main");
+    if(main_symbol == image.symbols.end())
+    {
+        return {Link_Status::Missing_Entry_Point, "'main' isn't defined by any object"};
+    }
+
+    const auto stub = start_stub(main_symbol->second);
+    std::copy(stub.begin(), stub.end(), image.text.begin());
+    image.entry_point = 0U;
+
+    return {Link_Status::Success, ""};
+}
+
+} // Namespace Linker
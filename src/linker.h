@@ -0,0 +1,32 @@
+#ifndef LINKER_H
+#define LINKER_H
+
+#include "object-file.h"
+#include "program-image.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Linker
+{
+    enum class Link_Status : int32_t
+    {
+        Success = 0,
+        Duplicate_Symbol = -1,
+        Undefined_Symbol = -2,
+        Image_Too_Large = -3,
+        Bad_Relocation = -4,
+        Missing_Entry_Point = -5
+    };
+
+    struct Link_Result
+    {
+        Link_Status status;
+        std::string detail; // Human readable description of the failure, empty on success
+    };
+
+    Link_Result link(const std::vector<Object_File>& objects, Program_Image& image);
+};
+
+#endif
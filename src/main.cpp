@@ -1,6 +1,8 @@
 #include "interpreter.h"
 
 #include <iostream>
+#include <string>
+#include <vector>
 
 namespace
 {
@@ -25,11 +27,55 @@ void demux_response_code(const Interpreter::Response_Code response)
             std::cerr << "Cannot access file provided to interpreter" << std::endl;
             break;
 
+        case Interpreter::Response_Code::Link_Error:
+            std::cerr << "Unable to link the provided files" << std::endl;
+            break;
+
+        case Interpreter::Response_Code::Load_Error:
+            std::cerr << "Unable to load the linked program" << std::endl;
+            break;
+
+        case Interpreter::Response_Code::Bad_Address:
+        case Interpreter::Response_Code::Divide_By_Zero:
+        case Interpreter::Response_Code::Stack_Overflow:
+        case Interpreter::Response_Code::Bad_Opcode:
+            std::cerr << "The program was stopped by a fault" << std::endl;
+            break;
+
+        case Interpreter::Response_Code::Replay_Mismatch:
+            std::cerr << "The program didn't repeat the recorded run" << std::endl;
+            break;
+
         default:
             break;
     }
 }
 
+/**********************************************************************************************//**
+ * \brief Converts a -O flag into an optimisation level. Anything above the highest level is
+ *        treated as the highest level.
+ * \param flag The flag, e.g. "-O2"
+ * \returns The requested level
+ *************************************************************************************************/
+Optimizer::Level parse_optimization_level(const std::string& flag)
+{
+    const auto level = flag.substr(2);
+    if(level.empty() || (level == "1"))
+    {
+        return Optimizer::Level::O1;
+    }
+    else if(level == "0")
+    {
+        return Optimizer::Level::O0;
+    }
+    else if(level == "2")
+    {
+        return Optimizer::Level::O2;
+    }
+
+    return Optimizer::Level::O3;
+}
+
 };
 
 /**********************************************************************************************//**
@@ -39,14 +85,66 @@ void demux_response_code(const Interpreter::Response_Code response)
  *************************************************************************************************/
 int main(int argc, char** argv)
 {
-	if(argc != 2)
+	if(argc < 2)
 	{
         std::cerr << "Please provide a file name." << std::endl;
         return 0;
 	}
 
-	const std::string file_path(argv[1]);
-    demux_response_code(Interpreter::Interpret(file_path));
+    Interpreter::Options options;
+    std::vector<std::string> file_paths;
+    for(auto i = 1; i < argc; ++i)
+    {
+        const std::string argument(argv[i]);
+        if(argument.rfind("-O", 0) == 0)
+        {
+            options.optimization_level = parse_optimization_level(argument);
+        }
+        else if(argument == "--profile")
+        {
+            options.profile_path = "profile";
+        }
+        else if(argument.rfind("--profile=", 0) == 0)
+        {
+            options.profile_path = argument.substr(10);
+        }
+        else if(argument == "--perf-counters")
+        {
+            options.use_perf_counters = true;
+        }
+        else if(argument == "--trace")
+        {
+            options.trace_path = "trace.bin";
+        }
+        else if(argument.rfind("--trace=", 0) == 0)
+        {
+            options.trace_path = argument.substr(8);
+        }
+        else if(argument.rfind("--record=", 0) == 0)
+        {
+            options.record_path = argument.substr(9);
+        }
+        else if(argument.rfind("--replay=", 0) == 0)
+        {
+            options.replay_path = argument.substr(9);
+        }
+        else if(argument == "--replay-strict")
+        {
+            options.use_strict_replay = true;
+        }
+        else
+        {
+            file_paths.push_back(argument);
+        }
+    }
+
+    if(file_paths.empty())
+    {
+        std::cerr << "Please provide a file name." << std::endl;
+        return 0;
+    }
+
+    demux_response_code(Interpreter::Interpret(file_paths, options));
 
 	return 0;
 }
\ No newline at end of file
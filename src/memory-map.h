@@ -0,0 +1,55 @@
+#ifndef MEMORY_MAP_H
+#define MEMORY_MAP_H
+
+#include <cstdint>
+#include <vector>
+
+namespace Memory_Map
+{
+    constexpr auto WORD_SIZE = 4UL;
+
+    // Random numbers called out by the instructions
+    constexpr auto STACK_SIZE = 256UL * 1024UL;
+    constexpr auto STACK_START_ADDRESS = 0UL;
+    constexpr auto STACK_END_ADDRESS = STACK_SIZE - 1UL;
+
+    // Random numbers called out by the instructions
+    constexpr auto DATA_SIZE = 256UL * 1024UL;
+    constexpr auto DATA_START_ADDRESS = STACK_SIZE;
+    constexpr auto DATA_END_ADDRESS = (STACK_SIZE + DATA_SIZE) - 1UL;
+
+    // Random numbers called out by the instructions
+    constexpr auto TEXT_SIZE = 256UL * 1024UL;
+    constexpr auto TEXT_START_ADDRESS = (STACK_SIZE + DATA_SIZE);
+    constexpr auto TEXT_END_ADDRESS = (STACK_SIZE + DATA_SIZE + TEXT_SIZE) - 1UL;
+
+    /**********************************************************************************************//**
+     * \brief Reads a big endian word out of a raw segment image, such as an object file's text
+     * \param bytes The segment image
+     * \param offset Offset of the first byte of the word. The caller is responsible for bounds
+     * \returns The word stored at the offset
+     *************************************************************************************************/
+    inline uint32_t load_word(const std::vector<uint8_t>& bytes, const std::size_t offset)
+    {
+        return (static_cast<uint32_t>(bytes[offset + 0UL]) << 24UL) |
+               (static_cast<uint32_t>(bytes[offset + 1UL]) << 16UL) |
+               (static_cast<uint32_t>(bytes[offset + 2UL]) <<  8UL) |
+               (static_cast<uint32_t>(bytes[offset + 3UL]) <<  0UL);
+    }
+
+    /**********************************************************************************************//**
+     * \brief Writes a big endian word into a raw segment image
+     * \param bytes The segment image
+     * \param offset Offset of the first byte of the word. The caller is responsible for bounds
+     * \param word The value to store
+     *************************************************************************************************/
+    inline void store_word(std::vector<uint8_t>& bytes, const std::size_t offset, const uint32_t word)
+    {
+        bytes[offset + 0UL] = static_cast<uint8_t>((word >> 24UL) & 0xFFUL);
+        bytes[offset + 1UL] = static_cast<uint8_t>((word >> 16UL) & 0xFFUL);
+        bytes[offset + 2UL] = static_cast<uint8_t>((word >>  8UL) & 0xFFUL);
+        bytes[offset + 3UL] = static_cast<uint8_t>((word >>  0UL) & 0xFFUL);
+    }
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef OBJECT_FILE_H
+#define OBJECT_FILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class Segment : uint8_t
+{
+    Text,
+    Data,
+    Bss   // Zero initialised data. Only its size is stored, so nothing inside it can be relocated.
+};
+
+enum class Binding : uint8_t
+{
+    Local,  // Only visible to relocations from the same translation unit
+    Global  // Visible to every translation unit handed to the linker
+};
+
+/**************************************************************************************************
+ * \brief A named location inside one of an object file's segments, e.g. a function or a global
+ *************************************************************************************************/
+struct Symbol
+{
+    std::string name;
+    Segment segment;
+    uint32_t offset;
+    Binding binding;
+};
+
+enum class Relocation_Type : uint8_t
+{
+    Text_Address,   // Word holds an offset into this object's text. The text base is added.
+    Data_Address,   // Word holds an offset into this object's data. The data address is added.
+    Symbol_Address  // Word holds an addend. The address of the named symbol is added.
+};
+
+/**************************************************************************************************
+ * \brief A word inside one of the object's segments which can only be finalised once the linker
+ *        has decided where every object lives in the image
+ *************************************************************************************************/
+struct Relocation
+{
+    Segment segment;  // The segment containing the word to patch
+    uint32_t offset;  // Offset of the word within that segment
+    Relocation_Type type;
+    std::string symbol; // Only used by Symbol_Address relocations
+};
+
+/**************************************************************************************************
+ * \brief The relocatable output of compiling a single translation unit
+ *************************************************************************************************/
+struct Object_File
+{
+    std::string source_path;
+
+    std::vector<uint8_t> text;
+    std::vector<uint8_t> data;
+    uint32_t bss_size{0U};
+
+    // Largest alignment needed by anything in the data and BSS segments. The linker starts each
+    // segment on a multiple of it, so offsets aligned within the object stay aligned in the image.
+    uint32_t data_alignment{1U};
+    uint32_t bss_alignment{1U};
+
+    std::vector<Symbol> symbols;
+    std::vector<Relocation> relocations;
+};
+
+#endif
@@ -0,0 +1,1823 @@
+#include "optimizer.h"
+#include "instructions.h"
+#include "memory-map.h"
+
+#include <algorithm>
+#include <climits>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Optimizer
+{
+
+namespace
+{
+
+constexpr auto NO_RELOCATION = -1;
+
+constexpr auto UNKNOWN_DEPTH = INT64_MIN;
+
+// Frame slot tracked by forward_loads when ax holds nothing it knows about
+constexpr auto NO_SLOT = INT32_MIN;
+
+// Largest callee body, in instructions, that will be copied into its callers
+constexpr auto INLINE_BUDGET = 16UL;
+
+/**********************************************************************************************//**
+ * \brief An instruction in the listing. Instructions from the original text keep the offset they
+ *        were decoded from, so jumps can be remapped. Instructions added by a pass are synthetic
+ *        and can't be the target of a jump.
+ *************************************************************************************************/
+struct Node
+{
+    Instruction instruction;
+    bool live;
+    int relocation; // Index of the relocation patching this instruction's argument
+    bool synthetic;
+};
+
+/**********************************************************************************************//**
+ * \brief A function in the listing: a text symbol whose first instruction is ENT
+ *************************************************************************************************/
+struct Function
+{
+    uint32_t offset;      // Original offset of the ENT
+    std::size_t entry;    // Node index of the ENT
+    std::size_t end;      // Node index one past the function's last instruction
+    uint32_t local_count; // Words reserved by the ENT
+};
+
+/**********************************************************************************************//**
+ * \brief A natural loop. The generated code is structured, so the body is contiguous.
+ *************************************************************************************************/
+struct Loop
+{
+    std::size_t header; // Node index of the first instruction, the target of the back edge
+    std::size_t latch;  // Node index of the branch back to the header
+};
+
+/**********************************************************************************************//**
+ * \brief What a loop does to memory
+ *************************************************************************************************/
+struct Loop_Summary
+{
+    // Frame slot, in words from the base pointer -> number of stores to it inside the loop
+    std::unordered_map<int32_t, std::size_t> stores;
+};
+
+/**********************************************************************************************//**
+ * \brief Builds a synthetic instruction
+ * \param opcode The instruction
+ * \param operand Its argument, if it has one
+ * \returns The node to insert into the listing
+ *************************************************************************************************/
+Node synthesize(const uint8_t opcode, const uint32_t operand = 0U)
+{
+    return {{0U, opcode, operand}, true, NO_RELOCATION, true};
+}
+
+/**********************************************************************************************//**
+ * \brief Computes how many words an instruction leaves on the stack, relative to the stack
+ *        pointer set up by the function's ENT
+ * \param instruction The instruction being executed
+ * \returns The change in depth. Calls are balanced by the callee's LEV.
+ *************************************************************************************************/
+int64_t stack_effect(const Instruction& instruction)
+{
+    if(is_binary_operation(instruction.opcode))
+    {
+        return -1;
+    }
+
+    switch(instruction.opcode)
+    {
+        case Instructions::PUSH: return 1;
+        case Instructions::SI:   return -1;
+        case Instructions::SC:   return -1;
+        case Instructions::ADJ:  return -static_cast<int64_t>(static_cast<int32_t>(instruction.operand));
+        default:                 return 0;
+    }
+}
+
+/**********************************************************************************************//**
+ * \brief Applies a binary operation exactly as the virtual machine's handlers would
+ * \param opcode One of the binary operations
+ * \param left_side The value popped off the stack
+ * \param right_side The value in the ax register
+ * \param result Receives the folded value
+ * \returns False if the operation can't be folded without changing the program's behaviour
+ *************************************************************************************************/
+bool evaluate(const uint8_t opcode, const uint32_t left_side, const uint32_t right_side, uint32_t& result)
+{
+    switch(opcode)
+    {
+        case Instructions::OR:  result = (left_side | right_side);  return true;
+        case Instructions::XOR: result = (left_side ^ right_side);  return true;
+        case Instructions::AND: result = (left_side & right_side);  return true;
+        case Instructions::EQ:  result = (left_side == right_side); return true;
+        case Instructions::NE:  result = (left_side != right_side); return true;
+        case Instructions::LT:  result = (left_side < right_side);  return true;
+        case Instructions::GT:  result = (left_side > right_side);  return true;
+        case Instructions::LE:  result = (left_side <= right_side); return true;
+        case Instructions::GE:  result = (left_side >= right_side); return true;
+        case Instructions::ADD: result = (left_side + right_side);  return true;
+        case Instructions::SUB: result = (left_side - right_side);  return true;
+        case Instructions::MUL: result = (left_side * right_side);  return true;
+
+        // Out of range shifts are left for the machine they'll run on
+        case Instructions::SHL:
+        case Instructions::SHR:
+            if(right_side >= 32U)
+            {
+                return false;
+            }
+            result = (opcode == Instructions::SHL) ? (left_side << right_side) : (left_side >> right_side);
+            return true;
+
+        // Division by zero has to fault at run time, not at compile time
+        case Instructions::DIV:
+        case Instructions::MOD:
+            if(right_side == 0U)
+            {
+                return false;
+            }
+            result = (opcode == Instructions::DIV) ? (left_side / right_side) : (left_side % right_side);
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/**********************************************************************************************//**
+ * \brief The decoded text of an object file, along with everything needed to re-emit it once the
+ *        passes have run
+ *************************************************************************************************/
+class Listing
+{
+public:
+    explicit Listing(Object_File& object);
+
+    bool valid() const { return is_valid; }
+    std::size_t live_count() const;
+
+    bool fold_constants();
+    bool simplify_branches();
+    bool remove_unreachable();
+    bool inline_calls();
+    bool eliminate_tail_calls();
+    bool hoist_loop_invariants();
+    bool reduce_induction_variables();
+    bool forward_loads();
+
+    void emit();
+
+private:
+    bool has_local_target(const Node& node) const;
+    bool has_relocation(const Node& node) const;
+    bool is_leader(const Node& node) const;
+
+    std::size_t index_of(uint32_t offset) const;
+    std::size_t next_live(std::size_t index) const;
+    std::vector<std::size_t> live_indices() const;
+
+    bool call_target(const Node& node, uint32_t& target) const;
+    bool is_global_address(const Node& node) const;
+    std::vector<Function> functions() const;
+    bool stack_depths(const Function& function, std::vector<int64_t>& depths) const;
+    bool inline_body(const Function& function, std::vector<Node>& body) const;
+
+    std::vector<Loop> loops(const Function& function) const;
+    bool summarize(const Loop& loop, Loop_Summary& summary) const;
+    bool has_preheader(const Function& function, const Loop& loop) const;
+    bool is_invariant_slot(const Function& function, const Loop_Summary& summary, int32_t offset) const;
+    bool match_invariant(const Function& function, const Loop_Summary& summary,
+                         const std::vector<std::size_t>& body, std::size_t& cursor,
+                         std::size_t& operations) const;
+    int32_t allocate_local(Function& function);
+
+    void replace(std::size_t index, std::vector<Node> replacement);
+    void insert(std::size_t index, std::vector<Node> insertion);
+    int copy_relocation(int relocation);
+
+private:
+    Object_File& object;
+    std::vector<Node> nodes;
+
+    // Original offset of each instruction -> its node
+    std::unordered_map<uint32_t, std::size_t> node_at;
+
+    // Offsets which control can arrive at from somewhere other than the previous instruction
+    std::unordered_set<uint32_t> leaders;
+
+    // Offsets which may be entered from outside this object, or through a stored address
+    std::vector<uint32_t> roots;
+
+    bool is_valid;
+};
+
+/**********************************************************************************************//**
+ * \brief Decodes the object's text and gathers jump targets. If anything about the text can't be
+ *        understood, the listing is marked invalid and the object must be left alone.
+ * \param object The object file to optimize in place
+ *************************************************************************************************/
+Listing::Listing(Object_File& object) :
+    object(object),
+    nodes(),
+    node_at(),
+    leaders(),
+    roots(),
+    is_valid(true)
+{
+    std::size_t decoded_size = 0UL;
+    for(const auto& instruction : decode(object.text))
+    {
+        node_at[instruction.offset] = nodes.size();
+        nodes.push_back({instruction, true, NO_RELOCATION, false});
+        decoded_size += instruction_size(instruction.opcode);
+    }
+
+    if(decoded_size != object.text.size())
+    {
+        is_valid = false;
+        return;
+    }
+
+    // Every relocation into the text has to patch an instruction's argument
+    for(std::size_t i = 0UL; i < object.relocations.size(); ++i)
+    {
+        const auto& relocation = object.relocations[i];
+        if(relocation.segment == Segment::Bss)
+        {
+            is_valid = false;
+            return;
+        }
+
+        if(relocation.segment == Segment::Data)
+        {
+            if((static_cast<std::size_t>(relocation.offset) + Memory_Map::WORD_SIZE) > object.data.size())
+            {
+                is_valid = false;
+                return;
+            }
+
+            if(relocation.type == Relocation_Type::Text_Address)
+            {
+                roots.push_back(Memory_Map::load_word(object.data, relocation.offset));
+            }
+            continue;
+        }
+
+        const auto node = node_at.find(relocation.offset - 1U);
+        if((relocation.offset == 0U) || (node == node_at.end()) ||
+           !has_operand(nodes[node->second].instruction.opcode))
+        {
+            is_valid = false;
+            return;
+        }
+
+        nodes[node->second].relocation = static_cast<int>(i);
+    }
+
+    roots.push_back(0U);
+    for(const auto& symbol : object.symbols)
+    {
+        if(symbol.segment == Segment::Text)
+        {
+            roots.push_back(symbol.offset);
+        }
+    }
+
+    // Stored code addresses might be called from anywhere. Jump targets only matter to the
+    // instructions that reach them.
+    std::vector<uint32_t> targets(roots);
+    for(const auto& node : nodes)
+    {
+        const auto& instruction = node.instruction;
+        if(has_local_target(node))
+        {
+            auto& destination = (instruction.opcode == Instructions::IMM) ? roots : targets;
+            destination.push_back(instruction.operand);
+            targets.push_back(instruction.operand);
+        }
+    }
+
+    for(const auto target : targets)
+    {
+        if((node_at.find(target) == node_at.end()) && (target != object.text.size()))
+        {
+            is_valid = false;
+            return;
+        }
+
+        leaders.insert(target);
+    }
+}
+
+/**********************************************************************************************//**
+ * \brief Checks whether the instruction's argument is an address inside this object's text.
+ *        Branches without a relocation are assumed to target this object.
+ * \param node The instruction to check
+ * \returns True if the argument must be remapped when the text moves
+ *************************************************************************************************/
+bool Listing::has_local_target(const Node& node) const
+{
+    const auto opcode = node.instruction.opcode;
+    if(node.relocation == NO_RELOCATION)
+    {
+        return is_branch(opcode);
+    }
+
+    const auto& relocation = object.relocations[node.relocation];
+    return (relocation.type == Relocation_Type::Text_Address) &&
+           (is_branch(opcode) || (opcode == Instructions::IMM));
+}
+
+/**********************************************************************************************//**
+ * \brief Checks whether the instruction's argument is only known at link time
+ * \param node The instruction to check
+ * \returns True if a relocation patches the argument
+ *************************************************************************************************/
+bool Listing::has_relocation(const Node& node) const
+{
+    return node.relocation != NO_RELOCATION;
+}
+
+/**********************************************************************************************//**
+ * \brief Checks whether control can arrive at the instruction by a jump
+ * \param node The instruction to check
+ * \returns True if the instruction starts a basic block
+ *************************************************************************************************/
+bool Listing::is_leader(const Node& node) const
+{
+    return !node.synthetic && (leaders.count(node.instruction.offset) != 0UL);
+}
+
+/**********************************************************************************************//**
+ * \brief Finds the node decoded from the given offset
+ * \param offset Original offset of the instruction
+ * \returns The node's index, or the node count for the end of the text
+ *************************************************************************************************/
+std::size_t Listing::index_of(const uint32_t offset) const
+{
+    const auto node = node_at.find(offset);
+    return (node == node_at.end()) ? nodes.size() : node->second;
+}
+
+/**********************************************************************************************//**
+ * \brief Finds the first instruction at or after the given node which is still alive. Control that
+ *        would have arrived at a removed instruction falls through to this one instead.
+ * \param index The node to start from
+ * \returns The index of the live node, or the node count if there isn't one
+ *************************************************************************************************/
+std::size_t Listing::next_live(std::size_t index) const
+{
+    while((index < nodes.size()) && !nodes[index].live)
+    {
+        ++index;
+    }
+
+    return index;
+}
+
+/**********************************************************************************************//**
+ * \brief Collects the indices of the instructions still alive, in program order
+ * \returns The live indices
+ *************************************************************************************************/
+std::vector<std::size_t> Listing::live_indices() const
+{
+    std::vector<std::size_t> indices;
+    for(std::size_t i = 0UL; i < nodes.size(); ++i)
+    {
+        if(nodes[i].live)
+        {
+            indices.push_back(i);
+        }
+    }
+
+    return indices;
+}
+
+/**********************************************************************************************//**
+ * \brief Counts the instructions still alive
+ * \returns The number of instructions that will be emitted
+ *************************************************************************************************/
+std::size_t Listing::live_count() const
+{
+    return live_indices().size();
+}
+
+/**********************************************************************************************//**
+ * \brief Replaces IMM a; PUSH; IMM b; <op> with IMM (a op b). Nested expressions fold over
+ *        repeated calls.
+ * \returns True if anything was folded
+ *************************************************************************************************/
+bool Listing::fold_constants()
+{
+    auto changed = false;
+    const auto live = live_indices();
+
+    for(std::size_t k = 0UL; (k + 3UL) < live.size(); ++k)
+    {
+        auto& left = nodes[live[k]];
+        auto& push = nodes[live[k + 1UL]];
+        auto& right = nodes[live[k + 2UL]];
+        auto& operation = nodes[live[k + 3UL]];
+
+        if((left.instruction.opcode != Instructions::IMM) || has_relocation(left) ||
+           (push.instruction.opcode != Instructions::PUSH) || is_leader(push) ||
+           (right.instruction.opcode != Instructions::IMM) || has_relocation(right) || is_leader(right) ||
+           !is_binary_operation(operation.instruction.opcode) || is_leader(operation))
+        {
+            continue;
+        }
+
+        uint32_t result{0U};
+        if(!evaluate(operation.instruction.opcode, left.instruction.operand, right.instruction.operand, result))
+        {
+            continue;
+        }
+
+        left.instruction.operand = result;
+        push.live = false;
+        right.live = false;
+        operation.live = false;
+
+        changed = true;
+        k += 3UL;
+    }
+
+    return changed;
+}
+
+/**********************************************************************************************//**
+ * \brief Resolves conditional jumps on constant conditions into either an unconditional jump or
+ *        nothing at all, and removes jumps to the very next instruction
+ * \returns True if any branch was simplified
+ *************************************************************************************************/
+bool Listing::simplify_branches()
+{
+    auto changed = false;
+    const auto live = live_indices();
+
+    for(std::size_t k = 0UL; k < live.size(); ++k)
+    {
+        auto& node = nodes[live[k]];
+        const auto opcode = node.instruction.opcode;
+
+        if(((opcode == Instructions::JZ) || (opcode == Instructions::JNZ)) && (k > 0UL) && !is_leader(node))
+        {
+            const auto& condition = nodes[live[k - 1UL]];
+            if((condition.instruction.opcode != Instructions::IMM) || has_relocation(condition))
+            {
+                continue;
+            }
+
+            const auto is_zero = (condition.instruction.operand == 0U);
+            const auto taken = (opcode == Instructions::JZ) ? is_zero : !is_zero;
+            if(taken)
+            {
+                node.instruction.opcode = Instructions::JMP;
+            }
+            else
+            {
+                node.live = false;
+            }
+
+            changed = true;
+        }
+        else if((opcode == Instructions::JMP) && has_local_target(node))
+        {
+            if(next_live(index_of(node.instruction.operand)) == next_live(live[k] + 1UL))
+            {
+                node.live = false;
+                changed = true;
+            }
+        }
+    }
+
+    return changed;
+}
+
+/**********************************************************************************************//**
+ * \brief Removes every instruction that can't be reached from the object's entry points
+ * \returns True if anything was removed
+ *************************************************************************************************/
+bool Listing::remove_unreachable()
+{
+    std::vector<bool> reached(nodes.size(), false);
+    std::vector<std::size_t> pending;
+
+    const auto visit = [&](const std::size_t index)
+    {
+        const auto target = next_live(index);
+        if((target < nodes.size()) && !reached[target])
+        {
+            reached[target] = true;
+            pending.push_back(target);
+        }
+    };
+
+    for(const auto root : roots)
+    {
+        visit(index_of(root));
+    }
+
+    while(!pending.empty())
+    {
+        const auto index = pending.back();
+        pending.pop_back();
+
+        const auto& node = nodes[index];
+        const auto opcode = node.instruction.opcode;
+
+        if(has_local_target(node) && (opcode != Instructions::IMM))
+        {
+            visit(index_of(node.instruction.operand));
+        }
+
+        if((opcode != Instructions::JMP) && (opcode != Instructions::LEV) && (opcode != Instructions::EXIT))
+        {
+            visit(index + 1UL);
+        }
+    }
+
+    auto changed = false;
+    for(std::size_t i = 0UL; i < nodes.size(); ++i)
+    {
+        if(nodes[i].live && !reached[i])
+        {
+            nodes[i].live = false;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+/**********************************************************************************************//**
+ * \brief Works out which function in this object a call instruction enters
+ * \param node The call
+ * \param target Receives the original offset of the callee
+ * \returns False if the callee lives in another object, or the node isn't a call
+ *************************************************************************************************/
+bool Listing::call_target(const Node& node, uint32_t& target) const
+{
+    if(node.instruction.opcode != Instructions::CALL)
+    {
+        return false;
+    }
+
+    if(has_local_target(node))
+    {
+        target = node.instruction.operand;
+        return true;
+    }
+
+    const auto& relocation = object.relocations[node.relocation];
+    if((relocation.type != Relocation_Type::Symbol_Address) || (node.instruction.operand != 0U))
+    {
+        return false;
+    }
+
+    // A symbol defined here can't be defined anywhere else, or the link would fail
+    for(const auto& symbol : object.symbols)
+    {
+        if((symbol.segment == Segment::Text) && (symbol.name == relocation.symbol))
+        {
+            target = symbol.offset;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**********************************************************************************************//**
+ * \brief Checks whether an instruction's operand is relocated to the address of a global, either
+ *        through this object's data or a symbol this object places in data or BSS
+ * \param node The instruction
+ * \returns False if the operand isn't relocated, or may be the address of anything else
+ *************************************************************************************************/
+bool Listing::is_global_address(const Node& node) const
+{
+    if(!has_relocation(node))
+    {
+        return false;
+    }
+
+    const auto& relocation = object.relocations[node.relocation];
+    if(relocation.type == Relocation_Type::Data_Address)
+    {
+        return true;
+    }
+    else if(relocation.type != Relocation_Type::Symbol_Address)
+    {
+        return false;
+    }
+
+    for(const auto& symbol : object.symbols)
+    {
+        if(symbol.name == relocation.symbol)
+        {
+            return (symbol.segment == Segment::Data) || (symbol.segment == Segment::Bss);
+        }
+    }
+
+    return false;
+}
+
+/**********************************************************************************************//**
+ * \brief Splits the listing into functions. Each text symbol starts a region which runs up to the
+ *        next text symbol; regions which don't open with ENT aren't treated as functions.
+ * \returns The functions, in program order
+ *************************************************************************************************/
+std::vector<Function> Listing::functions() const
+{
+    std::vector<uint32_t> starts;
+    for(const auto& symbol : object.symbols)
+    {
+        if(symbol.segment == Segment::Text)
+        {
+            starts.push_back(symbol.offset);
+        }
+    }
+
+    std::sort(starts.begin(), starts.end());
+    starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+
+    std::vector<Function> result;
+    for(std::size_t i = 0UL; i < starts.size(); ++i)
+    {
+        const auto entry = index_of(starts[i]);
+        if((entry >= nodes.size()) || !nodes[entry].live ||
+           (nodes[entry].instruction.opcode != Instructions::ENT))
+        {
+            continue;
+        }
+
+        const auto end = ((i + 1UL) < starts.size()) ? index_of(starts[i + 1UL]) : nodes.size();
+        result.push_back({starts[i], entry, end, nodes[entry].instruction.operand});
+    }
+
+    return result;
+}
+
+/**********************************************************************************************//**
+ * \brief Computes the number of words pushed since the function's ENT, before each instruction of
+ *        the function runs. The generated code keeps the stack balanced wherever control flow
+ *        merges; if it doesn't, or control leaves the function other than by LEV, this fails.
+ * \param function The function to analyse
+ * \param depths Receives the depth of each node, indexed from the ENT. Unreached nodes are
+ *        UNKNOWN_DEPTH.
+ * \returns True if every reachable instruction has a single, non-negative depth
+ *************************************************************************************************/
+bool Listing::stack_depths(const Function& function, std::vector<int64_t>& depths) const
+{
+    depths.assign(function.end - function.entry, UNKNOWN_DEPTH);
+
+    std::vector<std::size_t> pending;
+    auto consistent = true;
+
+    const auto visit = [&](const std::size_t index, const int64_t depth)
+    {
+        const auto target = next_live(index);
+        if((target <= function.entry) || (target >= function.end) || (depth < 0))
+        {
+            consistent = false;
+            return;
+        }
+
+        auto& known = depths[target - function.entry];
+        if(known == UNKNOWN_DEPTH)
+        {
+            known = depth;
+            pending.push_back(target);
+        }
+        else if(known != depth)
+        {
+            consistent = false;
+        }
+    };
+
+    visit(function.entry + 1UL, 0);
+    while(consistent && !pending.empty())
+    {
+        const auto index = pending.back();
+        pending.pop_back();
+
+        const auto& node = nodes[index];
+        const auto opcode = node.instruction.opcode;
+        const auto depth = depths[index - function.entry] + stack_effect(node.instruction);
+
+        if(opcode == Instructions::ENT)
+        {
+            return false;
+        }
+
+        if(is_branch(opcode) && (opcode != Instructions::CALL))
+        {
+            if(!has_local_target(node))
+            {
+                return false;
+            }
+
+            visit(index_of(node.instruction.operand), depth);
+        }
+
+        if((opcode != Instructions::JMP) && (opcode != Instructions::LEV) && (opcode != Instructions::EXIT))
+        {
+            visit(index + 1UL, depth);
+        }
+    }
+
+    return consistent;
+}
+
+/**********************************************************************************************//**
+ * \brief Checks whether a function is small enough, and simple enough, to be copied into its
+ *        callers. It must be straight line code which makes no calls, fits in INLINE_BUDGET,
+ *        leaves the stack balanced, and only touches its own arguments and locals.
+ * \param function The candidate callee
+ * \param body Receives the instructions between the ENT and the first LEV
+ * \returns True if the function can be inlined
+ *************************************************************************************************/
+bool Listing::inline_body(const Function& function, std::vector<Node>& body) const
+{
+    body.clear();
+
+    int64_t depth{0};
+    for(auto index = next_live(function.entry + 1UL); index < function.end; index = next_live(index + 1UL))
+    {
+        const auto& node = nodes[index];
+        const auto opcode = node.instruction.opcode;
+
+        if(opcode == Instructions::LEV)
+        {
+            return (depth == 0);
+        }
+
+        const auto offset = static_cast<int32_t>(node.instruction.operand);
+        if(is_branch(opcode) || (opcode == Instructions::ENT) || (opcode == Instructions::EXIT) ||
+           is_leader(node) || (body.size() >= INLINE_BUDGET) ||
+           ((opcode == Instructions::LEA) && (offset >= 0) && (offset < 2)))
+        {
+            return false;
+        }
+
+        depth += stack_effect(node.instruction);
+        if(depth < 0)
+        {
+            return false;
+        }
+
+        body.push_back(node);
+    }
+
+    return false;
+}
+
+/**********************************************************************************************//**
+ * \brief Replaces a node with a sequence of synthetic nodes
+ * \param index The node to replace
+ * \param replacement The nodes to put in its place
+ *************************************************************************************************/
+void Listing::replace(const std::size_t index, std::vector<Node> replacement)
+{
+    nodes.erase(nodes.begin() + index);
+    insert(index, std::move(replacement));
+}
+
+/**********************************************************************************************//**
+ * \brief Inserts synthetic nodes ahead of an existing node. Jumps to that node skip the new code.
+ * \param index The node to insert in front of
+ * \param insertion The nodes to insert
+ *************************************************************************************************/
+void Listing::insert(const std::size_t index, std::vector<Node> insertion)
+{
+    nodes.insert(nodes.begin() + index, insertion.begin(), insertion.end());
+
+    node_at.clear();
+    for(std::size_t i = 0UL; i < nodes.size(); ++i)
+    {
+        if(!nodes[i].synthetic)
+        {
+            node_at[nodes[i].instruction.offset] = i;
+        }
+    }
+}
+
+/**********************************************************************************************//**
+ * \brief Duplicates a relocation, for an instruction that has been copied
+ * \param relocation Index of the relocation to copy, or NO_RELOCATION
+ * \returns Index of the copy. Emitting the listing moves it to the copied instruction.
+ *************************************************************************************************/
+int Listing::copy_relocation(const int relocation)
+{
+    if(relocation == NO_RELOCATION)
+    {
+        return NO_RELOCATION;
+    }
+
+    object.relocations.push_back(object.relocations[relocation]);
+    return static_cast<int>(object.relocations.size() - 1UL);
+}
+
+/**********************************************************************************************//**
+ * \brief Copies small leaf functions into their callers. The callee's frame is laid out directly
+ *        below the arguments the caller already pushed, so the body addresses its arguments and
+ *        locals relative to the caller's base pointer and no CALL, ENT, LEV or return address is
+ *        needed.
+ * \returns True if any call was inlined
+ *************************************************************************************************/
+bool Listing::inline_calls()
+{
+    const auto all_functions = functions();
+
+    // Collected first and applied back to front, so indices stay valid while nodes are inserted
+    std::vector<std::pair<std::size_t, std::vector<Node>>> expansions;
+    std::vector<std::size_t> adjustments;
+
+    for(const auto& caller : all_functions)
+    {
+        std::vector<int64_t> depths;
+        if(!stack_depths(caller, depths))
+        {
+            continue;
+        }
+
+        for(auto index = caller.entry + 1UL; index < caller.end; ++index)
+        {
+            const auto& node = nodes[index];
+            const auto depth = depths[index - caller.entry];
+
+            uint32_t target{0U};
+            if(!node.live || (depth == UNKNOWN_DEPTH) || !call_target(node, target))
+            {
+                continue;
+            }
+
+            const auto callee = std::find_if(all_functions.begin(), all_functions.end(),
+                                             [&](const Function& function) { return function.offset == target; });
+
+            std::vector<Node> body;
+            if((callee == all_functions.end()) || !inline_body(*callee, body))
+            {
+                continue;
+            }
+
+            // The caller's ADJ pops the arguments. It's folded into the ADJ that ends the body.
+            uint32_t argument_count{0U};
+            const auto next = next_live(index + 1UL);
+            const auto has_adjust = (next < caller.end) && (nodes[next].instruction.opcode == Instructions::ADJ);
+            if(has_adjust)
+            {
+                if(is_leader(nodes[next]))
+                {
+                    continue;
+                }
+                argument_count = nodes[next].instruction.operand;
+            }
+
+            if(depth < static_cast<int64_t>(argument_count))
+            {
+                continue;
+            }
+
+            // Offset, in words from the caller's base pointer, of the last argument pushed
+            const auto base = -static_cast<int64_t>(caller.local_count) - depth;
+            const auto local_count = callee->local_count;
+
+            std::vector<Node> expansion;
+            if(local_count > 0U)
+            {
+                expansion.push_back(synthesize(Instructions::ADJ, static_cast<uint32_t>(-static_cast<int64_t>(local_count))));
+            }
+
+            for(auto copy : body)
+            {
+                if(copy.instruction.opcode == Instructions::LEA)
+                {
+                    const auto offset = static_cast<int32_t>(copy.instruction.operand);
+                    const auto remapped = (offset >= 2) ? (base + offset - 2) : (base + offset);
+                    copy.instruction.operand = static_cast<uint32_t>(remapped);
+                }
+
+                copy.synthetic = true;
+                copy.relocation = copy_relocation(copy.relocation);
+                expansion.push_back(copy);
+            }
+
+            if((local_count + argument_count) > 0U)
+            {
+                expansion.push_back(synthesize(Instructions::ADJ, local_count + argument_count));
+            }
+
+            if(has_adjust)
+            {
+                adjustments.push_back(next);
+            }
+            expansions.emplace_back(index, std::move(expansion));
+        }
+    }
+
+    for(const auto adjustment : adjustments)
+    {
+        nodes[adjustment].live = false;
+    }
+
+    std::sort(expansions.begin(), expansions.end(),
+              [](const auto& left, const auto& right) { return left.first > right.first; });
+    for(auto& [index, expansion] : expansions)
+    {
+        replace(index, std::move(expansion));
+    }
+
+    return !expansions.empty();
+}
+
+/**********************************************************************************************//**
+ * \brief Turns CALL self; ADJ n; LEV into a jump back to the top of the function. The new
+ *        arguments are copied over the current ones and the frame is reused, so tail recursion
+ *        runs in constant stack space.
+ * \returns True if any tail call was eliminated
+ *************************************************************************************************/
+bool Listing::eliminate_tail_calls()
+{
+    std::vector<std::pair<std::size_t, std::vector<Node>>> rewrites;
+    std::vector<std::size_t> adjustments;
+
+    for(const auto& function : functions())
+    {
+        std::vector<int64_t> depths;
+        if(!stack_depths(function, depths))
+        {
+            continue;
+        }
+
+        const auto body_start = next_live(function.entry + 1UL);
+        if((body_start >= function.end) || nodes[body_start].synthetic)
+        {
+            continue;
+        }
+
+        for(auto index = function.entry + 1UL; index < function.end; ++index)
+        {
+            const auto& node = nodes[index];
+            const auto depth = depths[index - function.entry];
+
+            uint32_t target{0U};
+            if(!node.live || (depth == UNKNOWN_DEPTH) || !call_target(node, target) || (target != function.offset))
+            {
+                continue;
+            }
+
+            uint32_t argument_count{0U};
+            auto next = next_live(index + 1UL);
+            const auto adjust = next;
+            const auto has_adjust = (next < function.end) && (nodes[next].instruction.opcode == Instructions::ADJ);
+            if(has_adjust)
+            {
+                if(is_leader(nodes[next]))
+                {
+                    continue;
+                }
+                argument_count = nodes[next].instruction.operand;
+                next = next_live(next + 1UL);
+            }
+
+            // Only the arguments may be on the stack, and the result must be returned untouched
+            if((next >= function.end) || (nodes[next].instruction.opcode != Instructions::LEV) ||
+               (depth != static_cast<int64_t>(argument_count)))
+            {
+                continue;
+            }
+
+            const auto base = -static_cast<int64_t>(function.local_count) - depth;
+
+            // Argument i lives i words above the last one pushed, both in the caller's
+            // temporaries and in the frame's parameter slots
+            std::vector<Node> rewrite;
+            for(uint32_t i = 0U; i < argument_count; ++i)
+            {
+                rewrite.push_back(synthesize(Instructions::LEA, 2U + i));
+                rewrite.push_back(synthesize(Instructions::PUSH));
+                rewrite.push_back(synthesize(Instructions::LEA, static_cast<uint32_t>(base + i)));
+                rewrite.push_back(synthesize(Instructions::LI));
+                rewrite.push_back(synthesize(Instructions::SI));
+            }
+
+            if(argument_count > 0U)
+            {
+                rewrite.push_back(synthesize(Instructions::ADJ, argument_count));
+                adjustments.push_back(adjust);
+            }
+
+            object.relocations.push_back({Segment::Text, 0U, Relocation_Type::Text_Address, ""});
+            auto jump = synthesize(Instructions::JMP, nodes[body_start].instruction.offset);
+            jump.relocation = static_cast<int>(object.relocations.size() - 1UL);
+            rewrite.push_back(jump);
+
+            leaders.insert(nodes[body_start].instruction.offset);
+            rewrites.emplace_back(index, std::move(rewrite));
+        }
+    }
+
+    for(const auto adjustment : adjustments)
+    {
+        nodes[adjustment].live = false;
+    }
+
+    std::sort(rewrites.begin(), rewrites.end(),
+              [](const auto& left, const auto& right) { return left.first > right.first; });
+    for(auto& [index, rewrite] : rewrites)
+    {
+        replace(index, std::move(rewrite));
+    }
+
+    return !rewrites.empty();
+}
+
+/**********************************************************************************************//**
+ * \brief Finds the loops in a function. Generated code is structured, so a loop is the run of
+ *        instructions from the target of a backward branch up to that branch, and nothing outside
+ *        it may jump into the middle.
+ * \param function The function to search
+ * \returns The loops, innermost first
+ *************************************************************************************************/
+std::vector<Loop> Listing::loops(const Function& function) const
+{
+    std::vector<std::pair<std::size_t, std::size_t>> branches;
+    for(auto index = function.entry + 1UL; index < function.end; ++index)
+    {
+        const auto& node = nodes[index];
+        if(node.live && is_branch(node.instruction.opcode) &&
+           (node.instruction.opcode != Instructions::CALL) && has_local_target(node))
+        {
+            branches.emplace_back(index, next_live(index_of(node.instruction.operand)));
+        }
+    }
+
+    std::vector<Loop> result;
+    for(const auto& [latch, header] : branches)
+    {
+        if((header <= function.entry) || (header > latch))
+        {
+            continue;
+        }
+
+        const auto enters_body = std::any_of(branches.begin(), branches.end(), [&](const auto& branch)
+        {
+            const auto outside = (branch.first < header) || (branch.first > latch);
+            return outside && (branch.second > header) && (branch.second <= latch);
+        });
+
+        if(!enters_body)
+        {
+            result.push_back({header, latch});
+        }
+    }
+
+    std::sort(result.begin(), result.end(), [](const Loop& left, const Loop& right)
+    {
+        return (left.latch - left.header) < (right.latch - right.header);
+    });
+
+    return result;
+}
+
+/**********************************************************************************************//**
+ * \brief Records which frame slots a loop stores to. Stores are matched to the LEA that produced
+ *        their address by tracking what each PUSH put on the stack.
+ * \param loop The loop to summarise
+ * \param summary Receives the store counts
+ * \returns False if the loop calls out, makes a system call, or stores through an address that
+ *          isn't a frame slot. Nothing in memory can be treated as invariant in such a loop.
+ *************************************************************************************************/
+bool Listing::summarize(const Loop& loop, Loop_Summary& summary) const
+{
+    summary.stores.clear();
+
+    // Frame slot whose address is in ax, and the same for each word pushed inside the loop
+    std::optional<int32_t> address;
+    std::vector<std::optional<int32_t>> stack;
+
+    const auto pop = [&]()
+    {
+        std::optional<int32_t> top;
+        if(!stack.empty())
+        {
+            top = stack.back();
+            stack.pop_back();
+        }
+        return top;
+    };
+
+    // Inlined code reserves space with a negative ADJ
+    const auto adjust = [&](int32_t count)
+    {
+        for(; count > 0; --count)
+        {
+            pop();
+        }
+        for(; count < 0; ++count)
+        {
+            stack.emplace_back();
+        }
+    };
+
+    for(auto index = loop.header; index <= loop.latch; index = next_live(index + 1UL))
+    {
+        const auto& node = nodes[index];
+        const auto opcode = node.instruction.opcode;
+
+        if(is_leader(node))
+        {
+            address.reset();
+        }
+
+        if((opcode == Instructions::CALL) || (opcode == Instructions::ENT) || (opcode >= Instructions::OPEN))
+        {
+            return false;
+        }
+
+        switch(opcode)
+        {
+            case Instructions::LEA:
+                address = static_cast<int32_t>(node.instruction.operand);
+                continue;
+
+            case Instructions::PUSH:
+                stack.push_back(address);
+                break;
+
+            case Instructions::SI:
+            case Instructions::SC:
+            {
+                const auto destination = pop();
+                if(!destination)
+                {
+                    return false;
+                }
+                ++summary.stores[*destination];
+                break;
+            }
+
+            case Instructions::ADJ:
+                adjust(static_cast<int32_t>(node.instruction.operand));
+                break;
+
+            default:
+                if(is_binary_operation(opcode))
+                {
+                    pop();
+                }
+                break;
+        }
+
+        address.reset();
+    }
+
+    return true;
+}
+
+/**********************************************************************************************//**
+ * \brief Checks whether code can be placed in front of a loop's header and run exactly once on
+ *        the way in. The only way in must be falling through into the header, and the header must
+ *        overwrite ax before reading it, as the inserted code leaves its own value there.
+ * \param function The function holding the loop
+ * \param loop The loop being entered
+ * \returns True if a preheader can be inserted
+ *************************************************************************************************/
+bool Listing::has_preheader(const Function& function, const Loop& loop) const
+{
+    const auto opcode = nodes[loop.header].instruction.opcode;
+    if((opcode != Instructions::IMM) && (opcode != Instructions::LEA))
+    {
+        return false;
+    }
+
+    auto previous = loop.header - 1UL;
+    while((previous > function.entry) && !nodes[previous].live)
+    {
+        --previous;
+    }
+
+    const auto previous_opcode = nodes[previous].instruction.opcode;
+    if((previous_opcode == Instructions::JMP) || (previous_opcode == Instructions::LEV) ||
+       (previous_opcode == Instructions::EXIT))
+    {
+        return false;
+    }
+
+    for(auto index = function.entry + 1UL; index < function.end; ++index)
+    {
+        const auto& node = nodes[index];
+        const auto outside = (index < loop.header) || (index > loop.latch);
+        if(outside && node.live && is_branch(node.instruction.opcode) && has_local_target(node) &&
+           (next_live(index_of(node.instruction.operand)) == loop.header))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**********************************************************************************************//**
+ * \brief Checks whether a frame slot holds the same value on every iteration of a loop. Only the
+ *        function's arguments and locals qualify. The temporaries below them change with every
+ *        PUSH, and the saved base pointer and return address aren't program values.
+ * \param function The function holding the loop
+ * \param summary The loop's stores
+ * \param offset The frame slot, in words from the base pointer
+ * \returns True if the slot is never written inside the loop
+ *************************************************************************************************/
+bool Listing::is_invariant_slot(const Function& function, const Loop_Summary& summary, const int32_t offset) const
+{
+    const auto is_argument = (offset >= 2);
+    const auto is_local = (offset < 0) && (offset >= -static_cast<int32_t>(function.local_count));
+
+    return (is_argument || is_local) && (summary.stores.count(offset) == 0UL);
+}
+
+/**********************************************************************************************//**
+ * \brief Matches a self contained, side effect free expression made only of loop invariant values,
+ *        e.g. LEA n; LI; PUSH; IMM 4; MUL. Loads are limited to frame slots and globals, so the
+ *        expression can't fault when moved ahead of a loop that never runs. Division is left in
+ *        place for the same reason.
+ * \param function The function holding the loop
+ * \param summary The loop's stores
+ * \param body Live node indices of the loop, in order
+ * \param cursor Position in the body to match from. Advanced past the expression on success.
+ * \param operations Incremented for every binary operation matched
+ * \returns True if an expression was matched
+ *************************************************************************************************/
+bool Listing::match_invariant(const Function& function, const Loop_Summary& summary,
+                              const std::vector<std::size_t>& body, std::size_t& cursor,
+                              std::size_t& operations) const
+{
+    if(cursor >= body.size())
+    {
+        return false;
+    }
+
+    const auto& atom = nodes[body[cursor]];
+    const auto is_load = ((cursor + 1UL) < body.size()) &&
+                         ((nodes[body[cursor + 1UL]].instruction.opcode == Instructions::LI) ||
+                          (nodes[body[cursor + 1UL]].instruction.opcode == Instructions::LC));
+
+    if(atom.instruction.opcode == Instructions::LEA)
+    {
+        const auto offset = static_cast<int32_t>(atom.instruction.operand);
+        if(is_load && !is_invariant_slot(function, summary, offset))
+        {
+            return false;
+        }
+    }
+    else if(atom.instruction.opcode == Instructions::IMM)
+    {
+        const auto is_global = is_global_address(atom);
+        if((has_relocation(atom) && !is_global) || (is_load && !is_global))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    cursor += is_load ? 2UL : 1UL;
+
+    while((cursor < body.size()) && (nodes[body[cursor]].instruction.opcode == Instructions::PUSH))
+    {
+        auto right = cursor + 1UL;
+        auto right_operations = operations;
+        if(!match_invariant(function, summary, body, right, right_operations) || (right >= body.size()))
+        {
+            break;
+        }
+
+        const auto opcode = nodes[body[right]].instruction.opcode;
+        if(!is_binary_operation(opcode) || (opcode == Instructions::DIV) || (opcode == Instructions::MOD))
+        {
+            break;
+        }
+
+        cursor = right + 1UL;
+        operations = right_operations + 1UL;
+    }
+
+    return true;
+}
+
+/**********************************************************************************************//**
+ * \brief Adds a local to a function's frame. Temporaries addressed below the existing locals, by
+ *        inlined code, move down a word to make room.
+ * \param function The function to grow. Its local count is updated.
+ * \returns The new local's offset from the base pointer
+ *************************************************************************************************/
+int32_t Listing::allocate_local(Function& function)
+{
+    const auto lowest_local = -static_cast<int32_t>(function.local_count);
+
+    for(auto index = function.entry + 1UL; index < function.end; ++index)
+    {
+        auto& instruction = nodes[index].instruction;
+        if((instruction.opcode == Instructions::LEA) && (static_cast<int32_t>(instruction.operand) < lowest_local))
+        {
+            --instruction.operand;
+        }
+    }
+
+    ++function.local_count;
+    nodes[function.entry].instruction.operand = function.local_count;
+
+    return -static_cast<int32_t>(function.local_count);
+}
+
+/**********************************************************************************************//**
+ * \brief Moves one loop invariant expression into a new local, computed once ahead of the loop.
+ *        The expression inside the loop becomes a load of that local.
+ * \returns True if an expression was hoisted. The listing has changed, so callers should come back
+ *          for the next one.
+ *************************************************************************************************/
+bool Listing::hoist_loop_invariants()
+{
+    for(auto function : functions())
+    {
+        for(const auto& loop : loops(function))
+        {
+            Loop_Summary summary;
+            if(!summarize(loop, summary) || !has_preheader(function, loop))
+            {
+                continue;
+            }
+
+            std::vector<std::size_t> body;
+            for(auto index = loop.header; index <= loop.latch; index = next_live(index + 1UL))
+            {
+                body.push_back(index);
+            }
+
+            for(std::size_t start = 0UL; start < body.size(); ++start)
+            {
+                auto end = start;
+                std::size_t operations{0UL};
+                if(!match_invariant(function, summary, body, end, operations) || (operations == 0UL))
+                {
+                    continue;
+                }
+
+                const auto enters_midway = std::any_of(body.begin() + start + 1UL, body.begin() + end,
+                                                       [&](const std::size_t index) { return is_leader(nodes[index]); });
+                if(enters_midway)
+                {
+                    continue;
+                }
+
+                const auto slot = static_cast<uint32_t>(allocate_local(function));
+
+                std::vector<Node> preheader = {synthesize(Instructions::LEA, slot), synthesize(Instructions::PUSH)};
+                for(auto position = start; position < end; ++position)
+                {
+                    auto copy = nodes[body[position]];
+                    copy.synthetic = true;
+                    copy.relocation = copy_relocation(copy.relocation);
+                    preheader.push_back(copy);
+                }
+                preheader.push_back(synthesize(Instructions::SI));
+
+                // The first node keeps its offset, in case something jumps to the expression
+                auto& first = nodes[body[start]];
+                first.instruction = {first.instruction.offset, Instructions::LEA, slot};
+                first.relocation = NO_RELOCATION;
+
+                auto& second = nodes[body[start + 1UL]];
+                second.instruction = {second.instruction.offset, Instructions::LI, 0U};
+                second.relocation = NO_RELOCATION;
+
+                for(auto position = start + 2UL; position < end; ++position)
+                {
+                    nodes[body[position]].live = false;
+                }
+
+                insert(loop.header, std::move(preheader));
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/**********************************************************************************************//**
+ * \brief Replaces repeated i * k inside a loop with a second induction variable that is stepped
+ *        alongside i. Every instruction costs about the same to interpret, so this only pays when
+ *        the product is used at least three times per iteration; stepping the new variable costs
+ *        eight instructions and each use saves three.
+ * \returns True if a multiplication was reduced. The listing has changed, so callers should come
+ *          back for the next one.
+ *************************************************************************************************/
+bool Listing::reduce_induction_variables()
+{
+    constexpr auto USE_LENGTH = 5UL;
+    constexpr auto MINIMUM_USES = 3UL;
+
+    for(auto function : functions())
+    {
+        for(const auto& loop : loops(function))
+        {
+            Loop_Summary summary;
+            if(!summarize(loop, summary) || !has_preheader(function, loop))
+            {
+                continue;
+            }
+
+            std::vector<std::size_t> body;
+            for(auto index = loop.header; index <= loop.latch; index = next_live(index + 1UL))
+            {
+                body.push_back(index);
+            }
+
+            const auto matches = [&](const std::size_t position, const std::vector<uint8_t>& pattern)
+            {
+                if((position + pattern.size()) > body.size())
+                {
+                    return false;
+                }
+
+                for(std::size_t i = 0UL; i < pattern.size(); ++i)
+                {
+                    const auto& node = nodes[body[position + i]];
+                    if((node.instruction.opcode != pattern[i]) || has_relocation(node) ||
+                       ((i > 0UL) && is_leader(node)))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            };
+
+            for(std::size_t update = 0UL; update < body.size(); ++update)
+            {
+                // i = i + c is LEA i; PUSH; LEA i; LI; PUSH; IMM c; ADD|SUB; SI. ++i and i += c
+                // load through the address already in ax, so drop the second LEA i.
+                const auto is_assignment = matches(update, {LEA, PUSH, LEA, LI});
+                const auto update_length = is_assignment ? 8UL : 7UL;
+                const auto step_position = update + update_length - 2UL;
+
+                const uint8_t step_opcode = (step_position < body.size()) ? nodes[body[step_position]].instruction.opcode : 0U;
+                if(((step_opcode != Instructions::ADD) && (step_opcode != Instructions::SUB)) ||
+                   (is_assignment && !matches(update, {LEA, PUSH, LEA, LI, PUSH, IMM, step_opcode, SI})) ||
+                   (!is_assignment && !matches(update, {LEA, PUSH, LI, PUSH, IMM, step_opcode, SI})))
+                {
+                    continue;
+                }
+
+                const auto variable = nodes[body[update]].instruction.operand;
+                const auto step = nodes[body[step_position - 1UL]].instruction.operand;
+                if((is_assignment && (nodes[body[update + 2UL]].instruction.operand != variable)) ||
+                   (summary.stores[static_cast<int32_t>(variable)] != 1UL) ||
+                   !is_invariant_slot(function, Loop_Summary{}, static_cast<int32_t>(variable)))
+                {
+                    continue;
+                }
+
+                // The step must run once on every iteration, so no branch inside the loop may
+                // jump over it, and the value it leaves in ax must not be used
+                const auto update_node = body[update];
+                const auto skipped = std::any_of(body.begin(), body.end(), [&](const std::size_t index)
+                {
+                    const auto& node = nodes[index];
+                    if((index == loop.latch) || !is_branch(node.instruction.opcode) || !has_local_target(node))
+                    {
+                        return false;
+                    }
+
+                    const auto target = next_live(index_of(node.instruction.operand));
+                    const auto inside = (target >= loop.header) && (target <= loop.latch);
+                    return inside && (std::min(index, target) <= update_node) && (std::max(index, target) > update_node);
+                });
+
+                const auto after = update + update_length;
+                const uint8_t after_opcode = (after < body.size()) ? nodes[body[after]].instruction.opcode : 0U;
+                if(skipped || ((after_opcode != Instructions::IMM) && (after_opcode != Instructions::LEA) &&
+                               !((after_opcode == Instructions::JMP) && (body[after] == loop.latch))))
+                {
+                    continue;
+                }
+
+                // LEA i; LI; PUSH; IMM k; MUL, grouped by k
+                std::unordered_map<uint32_t, std::vector<std::size_t>> uses;
+                for(std::size_t position = 0UL; position < body.size(); ++position)
+                {
+                    const auto overlaps = (position + USE_LENGTH > update) && (position < after);
+                    if(!overlaps && matches(position, {LEA, LI, PUSH, IMM, MUL}) &&
+                       (nodes[body[position]].instruction.operand == variable))
+                    {
+                        uses[nodes[body[position + 3UL]].instruction.operand].push_back(position);
+                        position += USE_LENGTH - 1UL;
+                    }
+                }
+
+                for(const auto& [factor, positions] : uses)
+                {
+                    if(positions.size() < MINIMUM_USES)
+                    {
+                        continue;
+                    }
+
+                    const auto product = static_cast<uint32_t>(allocate_local(function));
+
+                    for(const auto position : positions)
+                    {
+                        auto& first = nodes[body[position]];
+                        first.instruction = {first.instruction.offset, Instructions::LEA, product};
+
+                        auto& second = nodes[body[position + 1UL]];
+                        second.instruction = {second.instruction.offset, Instructions::LI, 0U};
+
+                        for(auto i = 2UL; i < USE_LENGTH; ++i)
+                        {
+                            nodes[body[position + i]].live = false;
+                        }
+                    }
+
+                    insert(body[after - 1UL] + 1UL, {
+                        synthesize(Instructions::LEA, product), synthesize(Instructions::PUSH),
+                        synthesize(Instructions::LEA, product), synthesize(Instructions::LI),
+                        synthesize(Instructions::PUSH), synthesize(Instructions::IMM, step * factor),
+                        synthesize(step_opcode), synthesize(Instructions::SI)
+                    });
+
+                    insert(loop.header, {
+                        synthesize(Instructions::LEA, product), synthesize(Instructions::PUSH),
+                        synthesize(Instructions::LEA, variable), synthesize(Instructions::LI),
+                        synthesize(Instructions::PUSH), synthesize(Instructions::IMM, factor),
+                        synthesize(Instructions::MUL), synthesize(Instructions::SI)
+                    });
+
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+/**********************************************************************************************//**
+ * \brief Keeps frame slots in the accumulator. After LEA x; LI, PUSH, or a store to x, ax already
+ *        holds x, so a following LEA x; LI is dropped. Knowledge is discarded at jump targets,
+ *        calls, and anything that writes ax or might write x.
+ * \returns True if any load was removed
+ *************************************************************************************************/
+bool Listing::forward_loads()
+{
+    auto changed = false;
+
+    for(const auto& function : functions())
+    {
+        int32_t value{NO_SLOT};   // Frame slot whose value is in ax
+        int32_t address{NO_SLOT}; // Frame slot whose address is in ax
+        std::vector<int32_t> stack;
+
+        const auto forget = [&]()
+        {
+            value = NO_SLOT;
+            address = NO_SLOT;
+            stack.clear();
+        };
+
+        const auto pop = [&]()
+        {
+            auto top = NO_SLOT;
+            if(!stack.empty())
+            {
+                top = stack.back();
+                stack.pop_back();
+            }
+            return top;
+        };
+
+        const auto adjust = [&](int32_t count)
+        {
+            for(; count > 0; --count)
+            {
+                pop();
+            }
+            for(; count < 0; ++count)
+            {
+                stack.push_back(NO_SLOT);
+            }
+        };
+
+        for(auto index = next_live(function.entry + 1UL); index < function.end; index = next_live(index + 1UL))
+        {
+            auto& node = nodes[index];
+            const auto opcode = node.instruction.opcode;
+
+            if(is_leader(node))
+            {
+                forget();
+            }
+
+            const auto next = next_live(index + 1UL);
+            if((opcode == Instructions::LEA) && (value != NO_SLOT) && (static_cast<int32_t>(node.instruction.operand) == value) &&
+               (next < function.end) && (nodes[next].instruction.opcode == Instructions::LI) && !is_leader(nodes[next]))
+            {
+                node.live = false;
+                nodes[next].live = false;
+                changed = true;
+                continue;
+            }
+
+            switch(opcode)
+            {
+                case Instructions::LEA:
+                    address = static_cast<int32_t>(node.instruction.operand);
+                    value = NO_SLOT;
+                    break;
+
+                case Instructions::LI:
+                    value = address;
+                    address = NO_SLOT;
+                    break;
+
+                case Instructions::PUSH:
+                    stack.push_back(address);
+                    break;
+
+                case Instructions::SI:
+                {
+                    const auto destination = pop();
+                    value = destination;
+                    address = NO_SLOT;
+                    break;
+                }
+
+                case Instructions::ADJ:
+                    adjust(static_cast<int32_t>(node.instruction.operand));
+                    break;
+
+                case Instructions::IMM:
+                    value = NO_SLOT;
+                    address = NO_SLOT;
+                    break;
+
+                case Instructions::JZ:
+                case Instructions::JNZ:
+                    // Nothing changes on the way through
+                    break;
+
+                default:
+                    if(is_binary_operation(opcode) || (opcode == Instructions::SC))
+                    {
+                        pop();
+                        value = NO_SLOT;
+                        address = NO_SLOT;
+                    }
+                    else
+                    {
+                        forget();
+                    }
+                    break;
+            }
+        }
+    }
+
+    return changed;
+}
+
+/**********************************************************************************************//**
+ * \brief Writes the surviving instructions back into the object, moving every jump target, symbol
+ *        and relocation to match the new layout
+ *************************************************************************************************/
+void Listing::emit()
+{
+    std::vector<uint32_t> new_offsets(nodes.size() + 1UL, 0U);
+
+    uint32_t offset{0U};
+    for(std::size_t i = 0UL; i < nodes.size(); ++i)
+    {
+        new_offsets[i] = offset;
+        if(nodes[i].live)
+        {
+            offset += instruction_size(nodes[i].instruction.opcode);
+        }
+    }
+    new_offsets[nodes.size()] = offset;
+
+    // Removed instructions map onto whatever now follows them
+    const auto remap = [&](const uint32_t old_offset)
+    {
+        return new_offsets[next_live(index_of(old_offset))];
+    };
+
+    std::vector<Instruction> instructions;
+    std::vector<Relocation> relocations;
+
+    for(std::size_t i = 0UL; i < nodes.size(); ++i)
+    {
+        auto node = nodes[i];
+        if(!node.live)
+        {
+            continue;
+        }
+
+        if(has_local_target(node))
+        {
+            node.instruction.operand = remap(node.instruction.operand);
+        }
+
+        if(has_relocation(node))
+        {
+            auto relocation = object.relocations[node.relocation];
+            relocation.offset = new_offsets[i] + 1U;
+            relocations.push_back(relocation);
+        }
+
+        instructions.push_back(node.instruction);
+    }
+
+    for(const auto& relocation : object.relocations)
+    {
+        if(relocation.segment != Segment::Data)
+        {
+            continue;
+        }
+
+        if(relocation.type == Relocation_Type::Text_Address)
+        {
+            const auto target = Memory_Map::load_word(object.data, relocation.offset);
+            Memory_Map::store_word(object.data, relocation.offset, remap(target));
+        }
+
+        relocations.push_back(relocation);
+    }
+
+    for(auto& symbol : object.symbols)
+    {
+        if(symbol.segment == Segment::Text)
+        {
+            symbol.offset = remap(symbol.offset);
+        }
+    }
+
+    object.text = encode(instructions);
+    object.relocations = std::move(relocations);
+}
+
+};
+
+/**********************************************************************************************//**
+ * \brief Runs the optimisation passes enabled by the given level over an object's text until none
+ *        of them can make further progress.
+ * \param object The object file to optimize in place
+ * \param level How aggressive to be
+ * \returns Instruction counts from before and after optimisation
+ *************************************************************************************************/
+Statistics optimize(Object_File& object, const Level level)
+{
+    Listing listing(object);
+
+    Statistics statistics;
+    statistics.instructions_before = listing.live_count();
+    statistics.instructions_after = statistics.instructions_before;
+
+    if(!listing.valid() || (level == Level::O0))
+    {
+        return statistics;
+    }
+
+    auto changed = true;
+    while(changed)
+    {
+        changed = listing.fold_constants();
+        changed = listing.simplify_branches() || changed;
+
+        if(level >= Level::O2)
+        {
+            changed = listing.inline_calls() || changed;
+            changed = listing.eliminate_tail_calls() || changed;
+            changed = listing.remove_unreachable() || changed;
+        }
+
+        if(level >= Level::O3)
+        {
+            changed = listing.hoist_loop_invariants() || changed;
+            changed = listing.reduce_induction_variables() || changed;
+            changed = listing.forward_loads() || changed;
+        }
+    }
+
+    listing.emit();
+    statistics.instructions_after = listing.live_count();
+
+    return statistics;
+}
+
+} // Namespace Optimizer
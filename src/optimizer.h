@@ -0,0 +1,28 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "object-file.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Optimizer
+{
+    enum class Level : uint8_t
+    {
+        O0 = 0, // Code is emitted exactly as generated
+        O1 = 1, // Constant folding and branch simplification
+        O2 = 2, // O1, plus inlining, tail call elimination and removal of unreachable code
+        O3 = 3  // O2, plus loop invariant hoisting, strength reduction and load forwarding
+    };
+
+    struct Statistics
+    {
+        std::size_t instructions_before{0UL};
+        std::size_t instructions_after{0UL};
+    };
+
+    Statistics optimize(Object_File& object, Level level);
+};
+
+#endif
@@ -0,0 +1,333 @@
+#include "output-buffer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/uio.h>
+
+namespace
+{
+
+constexpr std::size_t MAXIMUM_DIGITS = 32UL;
+constexpr const char* LOWER_CASE_DIGITS = "0123456789abcdef";
+constexpr const char* UPPER_CASE_DIGITS = "0123456789ABCDEF";
+
+};
+
+/**********************************************************************************************//**
+ * \brief Constructor for the output buffer
+ * \param descriptor The file descriptor to flush to. It isn't closed by the buffer.
+ * \param capacity The number of bytes gathered before a flush
+ *************************************************************************************************/
+Output_Buffer::Output_Buffer(const int descriptor, const std::size_t capacity) :
+    descriptor(descriptor),
+    buffer(std::max(capacity, MAXIMUM_DIGITS), '\0')
+{
+
+}
+
+/**********************************************************************************************//**
+ * \brief Destructor for the output buffer. Anything still buffered is flushed.
+ *************************************************************************************************/
+Output_Buffer::~Output_Buffer()
+{
+    flush();
+}
+
+/**********************************************************************************************//**
+ * \brief Appends bytes to the output
+ * \param bytes The bytes to append
+ * \param length The number of bytes
+ *************************************************************************************************/
+void Output_Buffer::write(const char* bytes, const std::size_t length)
+{
+    if(length <= (buffer.size() - used))
+    {
+        std::memcpy(buffer.data() + used, bytes, length);
+        used += length;
+        return;
+    }
+
+    write_all(bytes, length);
+}
+
+/**********************************************************************************************//**
+ * \brief Formats directly into the buffer, in the style of printf. Supports %d, %u, %x, %X, %c,
+ *        %s and %%, each with an optional width and the '-' and '0' flags.
+ * \param format The format string
+ * \param argument Retrieves the argument at the given position, counting from zero after the
+ *        format string
+ * \param resolve_string Finds the contents of a string argument from its address
+ * \returns The number of characters written
+ *************************************************************************************************/
+uint32_t Output_Buffer::print(const std::string_view format, const Argument_Source& argument,
+                              const String_Resolver& resolve_string)
+{
+    std::size_t written = 0UL;
+    std::size_t next_argument = 0UL;
+
+    std::size_t i = 0UL;
+    while(i < format.size())
+    {
+        const auto percent = format.find('%', i);
+        const auto literal_end = (percent == std::string_view::npos) ? format.size() : percent;
+        write(format.data() + i, literal_end - i);
+        written += literal_end - i;
+
+        if(percent == std::string_view::npos)
+        {
+            break;
+        }
+
+        Conversion conversion;
+        for(i = percent + 1UL; i < format.size(); ++i)
+        {
+            if(format[i] == '-')
+            {
+                conversion.left_justify = true;
+            }
+            else if(format[i] == '0')
+            {
+                conversion.zero_pad = true;
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        for(; (i < format.size()) && (format[i] >= '0') && (format[i] <= '9'); ++i)
+        {
+            conversion.width = std::min((conversion.width * 10UL) + static_cast<std::size_t>(format[i] - '0'), buffer.size());
+        }
+
+        if(i >= format.size())
+        {
+            break;
+        }
+
+        const auto specifier = format[i++];
+        switch(specifier)
+        {
+            case 'd':
+            {
+                const auto value = static_cast<int32_t>(argument(next_argument++));
+                const auto magnitude = (value < 0) ? (0U - static_cast<uint32_t>(value)) : static_cast<uint32_t>(value);
+                written += write_number(magnitude, value < 0, 10U, false, conversion);
+                break;
+            }
+
+            case 'u': written += write_number(argument(next_argument++), false, 10U, false, conversion); break;
+            case 'x': written += write_number(argument(next_argument++), false, 16U, false, conversion); break;
+            case 'X': written += write_number(argument(next_argument++), false, 16U, true, conversion);  break;
+
+            case 'c':
+            {
+                const auto character = static_cast<char>(argument(next_argument++));
+                written += write_padded(&character, 1UL, conversion);
+                break;
+            }
+
+            case 's':
+            {
+                const auto text = resolve_string(argument(next_argument++));
+                written += write_padded(text.data(), text.size(), conversion);
+                break;
+            }
+
+            case '%':
+                write("%", 1UL);
+                written += 1UL;
+                break;
+
+            // Anything unrecognised is printed as it was written
+            default:
+                write(format.data() + percent, i - percent);
+                written += i - percent;
+                break;
+        }
+    }
+
+    return static_cast<uint32_t>(written);
+}
+
+/**********************************************************************************************//**
+ * \brief Hands everything buffered to the file descriptor
+ * \returns False if the write failed. The buffered output is discarded either way.
+ *************************************************************************************************/
+bool Output_Buffer::flush()
+{
+    return write_all(nullptr, 0UL);
+}
+
+/**********************************************************************************************//**
+ * \brief Flushes anything buffered, then sends all later output to another file descriptor
+ * \param target The new descriptor, or a negative number to discard output
+ *************************************************************************************************/
+void Output_Buffer::redirect(const int target)
+{
+    flush();
+    descriptor = target;
+}
+
+/**********************************************************************************************//**
+ * \brief Makes room for a short run of bytes, flushing if necessary
+ * \param length The number of bytes needed. No larger than the capacity of the buffer.
+ * \returns Where the bytes should be written. The caller is responsible for advancing used.
+ *************************************************************************************************/
+char* Output_Buffer::reserve(const std::size_t length)
+{
+    if(length > (buffer.size() - used))
+    {
+        flush();
+    }
+
+    return buffer.data() + used;
+}
+
+/**********************************************************************************************//**
+ * \brief Writes bytes padded out to the width of a conversion. Strings are always padded with
+ *        spaces.
+ * \param bytes The bytes to write
+ * \param length The number of bytes
+ * \param conversion The width and justification
+ * \returns The number of characters written, including padding
+ *************************************************************************************************/
+std::size_t Output_Buffer::write_padded(const char* bytes, const std::size_t length, const Conversion& conversion)
+{
+    const auto padding = (conversion.width > length) ? (conversion.width - length) : 0UL;
+
+    if(!conversion.left_justify)
+    {
+        std::memset(reserve(padding), ' ', padding);
+        used += padding;
+    }
+
+    write(bytes, length);
+
+    if(conversion.left_justify)
+    {
+        std::memset(reserve(padding), ' ', padding);
+        used += padding;
+    }
+
+    return padding + length;
+}
+
+/**********************************************************************************************//**
+ * \brief Writes a number straight into the buffer
+ * \param magnitude The absolute value of the number
+ * \param is_negative True if a minus sign is needed
+ * \param base Either 10 or 16
+ * \param is_upper_case True for upper case hexadecimal digits
+ * \param conversion The width, justification and padding character
+ * \returns The number of characters written, including padding
+ *************************************************************************************************/
+std::size_t Output_Buffer::write_number(uint32_t magnitude, const bool is_negative, const uint32_t base,
+                                        const bool is_upper_case, const Conversion& conversion)
+{
+    const auto digits = is_upper_case ? UPPER_CASE_DIGITS : LOWER_CASE_DIGITS;
+
+    char text[MAXIMUM_DIGITS];
+    auto start = MAXIMUM_DIGITS;
+    do
+    {
+        text[--start] = digits[magnitude % base];
+        magnitude /= base;
+    } while(magnitude != 0U);
+
+    const auto length = (MAXIMUM_DIGITS - start) + (is_negative ? 1UL : 0UL);
+    const auto padding = (conversion.width > length) ? (conversion.width - length) : 0UL;
+    const auto zero_pad = conversion.zero_pad && !conversion.left_justify;
+
+    if(!conversion.left_justify && !zero_pad)
+    {
+        std::memset(reserve(padding), ' ', padding);
+        used += padding;
+    }
+
+    if(is_negative)
+    {
+        *reserve(1UL) = '-';
+        used += 1UL;
+    }
+
+    if(zero_pad)
+    {
+        std::memset(reserve(padding), '0', padding);
+        used += padding;
+    }
+
+    write(text + start, MAXIMUM_DIGITS - start);
+
+    if(conversion.left_justify)
+    {
+        std::memset(reserve(padding), ' ', padding);
+        used += padding;
+    }
+
+    return length + padding;
+}
+
+/**********************************************************************************************//**
+ * \brief Writes the buffered bytes, followed by any extra bytes, with as few writev calls as the
+ *        descriptor allows
+ * \param bytes Extra bytes to write after the buffer, or null
+ * \param length The number of extra bytes
+ * \returns False if the write failed
+ *************************************************************************************************/
+bool Output_Buffer::write_all(const char* bytes, const std::size_t length)
+{
+    if(descriptor < 0)
+    {
+        used = 0UL;
+        return true;
+    }
+
+    iovec vectors[2] = {
+        {buffer.data(), used},
+        {const_cast<char*>(bytes), length}
+    };
+
+    auto current = vectors;
+    auto count = 2;
+    while(count > 0)
+    {
+        if(current->iov_len == 0UL)
+        {
+            ++current;
+            --count;
+            continue;
+        }
+
+        const auto result = ::writev(descriptor, current, count);
+        if(result < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            used = 0UL;
+            return false;
+        }
+
+        auto remaining = static_cast<std::size_t>(result);
+        while((count > 0) && (remaining >= current->iov_len))
+        {
+            remaining -= current->iov_len;
+            ++current;
+            --count;
+        }
+
+        if(count > 0)
+        {
+            current->iov_base = static_cast<char*>(current->iov_base) + remaining;
+            current->iov_len -= remaining;
+        }
+    }
+
+    used = 0UL;
+    return true;
+}
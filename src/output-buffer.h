@@ -0,0 +1,54 @@
+#ifndef OUTPUT_BUFFER_H
+#define OUTPUT_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+/**************************************************************************************************
+ * \brief Collects a program's output and hands it to a file descriptor in large batches. Writes
+ *        too big for the remaining space are sent together with the buffered bytes in a single
+ *        writev, without being copied into the buffer first. Output sent to a negative descriptor
+ *        is formatted as usual, then discarded.
+ *************************************************************************************************/
+class Output_Buffer
+{
+public:
+    static constexpr std::size_t DEFAULT_CAPACITY = 64UL * 1024UL;
+
+    using Argument_Source = std::function<uint32_t(std::size_t)>;
+    using String_Resolver = std::function<std::string_view(uint32_t)>;
+
+    explicit Output_Buffer(int descriptor, std::size_t capacity = DEFAULT_CAPACITY);
+    ~Output_Buffer();
+
+    Output_Buffer(const Output_Buffer&) = delete;
+    Output_Buffer& operator=(const Output_Buffer&) = delete;
+
+    void write(const char* bytes, std::size_t length);
+    uint32_t print(std::string_view format, const Argument_Source& argument, const String_Resolver& resolve_string);
+    bool flush();
+    void redirect(int descriptor);
+
+private:
+    struct Conversion
+    {
+        bool left_justify{false};
+        bool zero_pad{false};
+        std::size_t width{0UL};
+    };
+
+    char* reserve(std::size_t length);
+    std::size_t write_padded(const char* bytes, std::size_t length, const Conversion& conversion);
+    std::size_t write_number(uint32_t magnitude, bool is_negative, uint32_t base, bool is_upper_case,
+                             const Conversion& conversion);
+    bool write_all(const char* bytes, std::size_t length);
+
+    int descriptor;
+    std::vector<char> buffer;
+    std::size_t used{0UL};
+};
+
+#endif
@@ -0,0 +1,537 @@
+#include "perf-counters.h"
+#include "instructions.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+namespace
+{
+
+constexpr uint64_t CYCLE_SAMPLE_PERIOD = 1000000UL;      // Cycles between samples
+constexpr uint64_t TASK_CLOCK_SAMPLE_PERIOD = 250000UL;  // Nanoseconds between samples
+constexpr uint64_t CALIBRATION_READS = 1000UL;           // Reads start() takes to find their cost
+
+constexpr const char* COUNTER_NAMES[] = {
+    "cycles", "instructions", "branches", "branch misses", "L1D read misses"
+};
+
+// Signal handlers can't be handed any context, so the session being sampled is kept here
+std::atomic<Perf_Counters*> active_session{nullptr};
+
+#ifdef __linux__
+
+/**********************************************************************************************//**
+ * \brief Opens a single counter for the calling thread, counting user space only
+ * \param type The kind of event, e.g. PERF_TYPE_HARDWARE
+ * \param config Which event of that kind
+ * \param group The group leader, or -1 to open a new group
+ * \param sample_period Events between overflow signals, zero for counters which don't signal
+ * \returns The file descriptor, or -1 with errno set
+ *************************************************************************************************/
+int open_counter(const uint32_t type, const uint64_t config, const int group, const uint64_t sample_period)
+{
+    perf_event_attr attributes{};
+    attributes.size = sizeof(attributes);
+    attributes.type = type;
+    attributes.config = config;
+    attributes.read_format = PERF_FORMAT_GROUP;
+    attributes.sample_period = sample_period;
+    attributes.disabled = (group == -1) ? 1U : 0U;
+    attributes.exclude_kernel = 1U;
+    attributes.exclude_hv = 1U;
+
+    return static_cast<int>(::syscall(SYS_perf_event_open, &attributes, 0, -1, group, PERF_FLAG_FD_CLOEXEC));
+}
+
+#endif
+
+/**********************************************************************************************//**
+ * \brief Divides two counts for the report
+ * \param numerator The top of the ratio
+ * \param denominator The bottom of the ratio
+ * \param scale Multiplies the ratio, e.g. 100 for a percentage
+ * \returns The scaled ratio, or zero if the denominator is zero
+ *************************************************************************************************/
+double ratio(const uint64_t numerator, const uint64_t denominator, const double scale)
+{
+    if(denominator == 0UL)
+    {
+        return 0.0;
+    }
+
+    return scale * static_cast<double>(numerator) / static_cast<double>(denominator);
+}
+
+};
+
+/**********************************************************************************************//**
+ * \brief Constructor for the counters. Nothing is opened until open() is called.
+ *************************************************************************************************/
+Perf_Counters::Perf_Counters() :
+    status("Hardware counters have not been opened")
+{
+    descriptors.fill(-1);
+}
+
+/**********************************************************************************************//**
+ * \brief Destructor for the counters. Stops sampling and closes every counter.
+ *************************************************************************************************/
+Perf_Counters::~Perf_Counters()
+{
+    stop();
+    close();
+}
+
+/**********************************************************************************************//**
+ * \brief Opens as many of the counters as the host allows and prepares the sampling signal
+ * \returns False if no counter could lead the group, in which case description() says why
+ *************************************************************************************************/
+bool Perf_Counters::open()
+{
+#ifdef __linux__
+    close();
+
+    leader_counts_cycles = true;
+    descriptors[Leader] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1, CYCLE_SAMPLE_PERIOD);
+
+    std::string fallback;
+    if(descriptors[Leader] < 0)
+    {
+        fallback = std::string("Hardware counters are unavailable (") + std::strerror(errno) + "). ";
+        leader_counts_cycles = false;
+        descriptors[Leader] = open_counter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, -1, TASK_CLOCK_SAMPLE_PERIOD);
+    }
+
+    if(descriptors[Leader] < 0)
+    {
+        status = std::string("Performance counters are unavailable: ") + std::strerror(errno);
+        return false;
+    }
+
+    const std::array<std::pair<uint32_t, uint64_t>, COUNTER_COUNT> events = {{
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                             (PERF_COUNT_HW_CACHE_OP_READ << 8U) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16U)}
+    }};
+
+    positions[Leader] = 0UL;
+    group_size = 1UL;
+    for(std::size_t counter = Instructions; counter < COUNTER_COUNT; ++counter)
+    {
+        descriptors[counter] = open_counter(events[counter].first, events[counter].second, descriptors[Leader], 0UL);
+        if(descriptors[counter] >= 0)
+        {
+            positions[counter] = group_size++;
+        }
+    }
+
+    // Overflows of the leader are delivered to this thread as SIGIO
+    struct sigaction action{};
+    action.sa_sigaction = &Perf_Counters::on_sample;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+
+    f_owner_ex owner{F_OWNER_TID, static_cast<pid_t>(::syscall(SYS_gettid))};
+    if((::fcntl(descriptors[Leader], F_SETFL, O_ASYNC | O_NONBLOCK) < 0) ||
+       (::fcntl(descriptors[Leader], F_SETSIG, SIGIO) < 0) ||
+       (::fcntl(descriptors[Leader], F_SETOWN_EX, &owner) < 0) ||
+       (::sigaction(SIGIO, &action, &previous_action) < 0))
+    {
+        status = std::string("Unable to sample the counters: ") + std::strerror(errno);
+        close();
+        return false;
+    }
+
+    is_handler_installed = true;
+    map_pages();
+
+    status = fallback + "Sampling " + (leader_counts_cycles ? COUNTER_NAMES[Leader] : "the task clock");
+    for(std::size_t counter = Instructions; counter < COUNTER_COUNT; ++counter)
+    {
+        if(descriptors[counter] >= 0)
+        {
+            status += std::string(", ") + COUNTER_NAMES[counter];
+        }
+    }
+
+    if(is_counting_per_opcode)
+    {
+        status += ". Counting per opcode with rdpmc";
+    }
+    else if(leader_counts_cycles && (descriptors[Instructions] >= 0))
+    {
+        status += ". The host doesn't allow rdpmc, so ratios are only reported for the whole run";
+    }
+
+    return true;
+#else
+    status = "Hardware counters are only supported on Linux";
+    return false;
+#endif
+}
+
+/**********************************************************************************************//**
+ * \brief Checks whether open() succeeded
+ * \returns True if samples will be taken once started
+ *************************************************************************************************/
+bool Perf_Counters::is_open() const
+{
+    return descriptors[Leader] >= 0;
+}
+
+/**********************************************************************************************//**
+ * \brief Describes what's being counted, or why nothing is
+ * \returns A line suitable for showing the user
+ *************************************************************************************************/
+const std::string& Perf_Counters::description() const
+{
+    return status;
+}
+
+/**********************************************************************************************//**
+ * \brief Zeroes the counters and starts sampling
+ *************************************************************************************************/
+void Perf_Counters::start()
+{
+#ifdef __linux__
+    if(!is_open() || is_running)
+    {
+        return;
+    }
+
+    run_totals.fill(0UL);
+    active_session = this;
+    is_running = true;
+
+    ::ioctl(descriptors[Leader], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ::ioctl(descriptors[Leader], PERF_EVENT_IOC_REFRESH, 1);
+
+    if(is_counting_per_opcode)
+    {
+        for(auto& totals : opcode_totals)
+        {
+            totals.fill(0UL);
+        }
+        dispatches.fill(0UL);
+
+        // The least each counter moves across back to back reads is what a read itself costs
+        read_cost.fill(UINT64_MAX);
+        read_counters(last_read);
+        for(uint64_t i = 0UL; i < CALIBRATION_READS; ++i)
+        {
+            Counts counts;
+            read_counters(counts);
+            for(std::size_t counter = Leader; counter < COUNTER_COUNT; ++counter)
+            {
+                read_cost[counter] = std::min(read_cost[counter], counts[counter] - last_read[counter]);
+            }
+            last_read = counts;
+        }
+
+        previous_opcode = NO_OPCODE;
+    }
+#endif
+}
+
+/**********************************************************************************************//**
+ * \brief Stops sampling and reads the run's totals. The report can be written once this returns.
+ *************************************************************************************************/
+void Perf_Counters::stop()
+{
+#ifdef __linux__
+    if(!is_running)
+    {
+        return;
+    }
+
+    // The last opcode to run hasn't been charged yet, as nothing was dispatched after it
+    if(is_counting_per_opcode)
+    {
+        charge(0U);
+    }
+
+    ::ioctl(descriptors[Leader], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    active_session = nullptr;
+    is_running = false;
+
+    uint64_t values[1UL + COUNTER_COUNT] = {};
+    const auto size = static_cast<ssize_t>(sizeof(uint64_t) * (1UL + group_size));
+    if(::read(descriptors[Leader], values, static_cast<std::size_t>(size)) == size)
+    {
+        for(std::size_t counter = Leader; counter < COUNTER_COUNT; ++counter)
+        {
+            if(descriptors[counter] >= 0)
+            {
+                run_totals[counter] = values[1UL + positions[counter]];
+            }
+        }
+    }
+#endif
+}
+
+/**********************************************************************************************//**
+ * \brief Counts the samples taken so far
+ * \returns The number of samples
+ *************************************************************************************************/
+uint64_t Perf_Counters::sample_count() const
+{
+    uint64_t count = 0UL;
+    for(const auto opcode_samples : samples)
+    {
+        count += opcode_samples;
+    }
+
+    return count;
+}
+
+/**********************************************************************************************//**
+ * \brief Checks whether the counters are read as each opcode is dispatched
+ * \returns True if the report will include IPC per opcode
+ *************************************************************************************************/
+bool Perf_Counters::counts_per_opcode() const
+{
+    return is_counting_per_opcode;
+}
+
+/**********************************************************************************************//**
+ * \brief Writes whichever ratios the open counters allow for the whole run, then a table of the
+ *        opcodes, busiest first, with their share of the samples. When counting per opcode the
+ *        table also has each opcode's share of the cycles, IPC and branch miss rate.
+ * \param stream Where to write
+ *************************************************************************************************/
+void Perf_Counters::write_report(std::ostream& stream) const
+{
+    stream << status << std::endl;
+    if(!is_open())
+    {
+        return;
+    }
+
+    const auto has = [this](const Counter counter) { return descriptors[counter] >= 0; };
+
+    stream << std::fixed << std::setprecision(2);
+    stream << "Whole run: ";
+    if(leader_counts_cycles)
+    {
+        stream << run_totals[Leader] << " cycles";
+    }
+    else
+    {
+        stream << ratio(run_totals[Leader], 1000000UL, 1.0) << " ms";
+    }
+
+    if(leader_counts_cycles && has(Instructions))
+    {
+        stream << ", IPC " << ratio(run_totals[Instructions], run_totals[Leader], 1.0);
+    }
+
+    if(has(Branches) && has(Branch_Misses))
+    {
+        stream << ", branch miss " << ratio(run_totals[Branch_Misses], run_totals[Branches], 100.0) << "%";
+    }
+
+    if(has(Instructions) && has(L1D_Misses))
+    {
+        stream << ", L1D misses/1k " << ratio(run_totals[L1D_Misses], run_totals[Instructions], 1000.0);
+    }
+    stream << std::endl;
+
+    // Counts charged to an opcode, less what reading the counters cost each time it was dispatched
+    const auto net = [this](const std::size_t opcode, const Counter counter)
+    {
+        const auto cost = read_cost[counter] * dispatches[opcode];
+        return (opcode_totals[opcode][counter] > cost) ? (opcode_totals[opcode][counter] - cost) : 0UL;
+    };
+
+    std::vector<std::size_t> opcodes;
+    uint64_t counted_cycles = 0UL;
+    for(std::size_t opcode = 0UL; opcode < samples.size(); ++opcode)
+    {
+        if((samples[opcode] != 0UL) || (is_counting_per_opcode && (dispatches[opcode] != 0UL)))
+        {
+            opcodes.push_back(opcode);
+            counted_cycles += is_counting_per_opcode ? net(opcode, Leader) : 0UL;
+        }
+    }
+
+    std::stable_sort(opcodes.begin(), opcodes.end(), [this, &net](const std::size_t lhs, const std::size_t rhs)
+    {
+        if(is_counting_per_opcode)
+        {
+            return net(lhs, Leader) > net(rhs, Leader);
+        }
+
+        return samples[lhs] > samples[rhs];
+    });
+
+    const auto has_misses = (pages[Branches] != nullptr) && (pages[Branch_Misses] != nullptr);
+
+    const auto total = sample_count();
+    stream << total << " samples" << std::endl;
+    stream << std::left << std::setw(8) << "Opcode" << std::right
+           << std::setw(10) << "Samples" << std::setw(10) << "Share%";
+    if(is_counting_per_opcode)
+    {
+        stream << std::setw(14) << "Dispatches" << std::setw(10) << "Cycles%" << std::setw(8) << "IPC";
+        if(has_misses)
+        {
+            stream << std::setw(12) << "Branch miss%";
+        }
+    }
+    stream << std::endl;
+
+    for(const auto opcode : opcodes)
+    {
+        stream << std::left << std::setw(8) << mnemonic(static_cast<uint8_t>(opcode)) << std::right
+               << std::setw(10) << samples[opcode]
+               << std::setw(10) << ratio(samples[opcode], total, 100.0);
+        if(is_counting_per_opcode)
+        {
+            stream << std::setw(14) << dispatches[opcode]
+                   << std::setw(10) << ratio(net(opcode, Leader), counted_cycles, 100.0)
+                   << std::setw(8) << ratio(net(opcode, Instructions), net(opcode, Leader), 1.0);
+            if(has_misses)
+            {
+                stream << std::setw(12) << ratio(net(opcode, Branch_Misses), net(opcode, Branches), 100.0);
+            }
+        }
+        stream << std::endl;
+    }
+
+    stream << std::defaultfloat;
+}
+
+/**********************************************************************************************//**
+ * \brief Signal handler for overflows of the group leader
+ *************************************************************************************************/
+void Perf_Counters::on_sample(int, siginfo_t*, void*)
+{
+    const auto saved_errno = errno;
+
+    const auto session = active_session.load();
+    if(session != nullptr)
+    {
+        session->sample();
+    }
+
+    errno = saved_errno;
+}
+
+/**********************************************************************************************//**
+ * \brief Credits a sample to the current opcode, then re-arms the leader for the next overflow.
+ *        Called from the signal handler, so only uses async signal safe calls.
+ *************************************************************************************************/
+void Perf_Counters::sample()
+{
+#ifdef __linux__
+    ++samples[static_cast<uint8_t>(current_opcode)];
+
+    ::ioctl(descriptors[Leader], PERF_EVENT_IOC_REFRESH, 1);
+#endif
+}
+
+/**********************************************************************************************//**
+ * \brief Maps the perf page of every counter which can be read with rdpmc. Counting per opcode
+ *        needs at least cycles and instructions, otherwise nothing is left mapped.
+ *************************************************************************************************/
+void Perf_Counters::map_pages()
+{
+#ifdef PERF_COUNTERS_HAVE_RDPMC
+    if(!leader_counts_cycles)
+    {
+        return;
+    }
+
+    // Only the counters reported per opcode are read, since every read adds to what's measured
+    const auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    for(std::size_t counter = Leader; counter <= Branch_Misses; ++counter)
+    {
+        if(descriptors[counter] < 0)
+        {
+            continue;
+        }
+
+        auto mapping = ::mmap(nullptr, page_size, PROT_READ, MAP_SHARED, descriptors[counter], 0);
+        if(mapping == MAP_FAILED)
+        {
+            continue;
+        }
+
+        const auto page = static_cast<perf_event_mmap_page*>(mapping);
+        if(page->cap_user_rdpmc == 0U)
+        {
+            ::munmap(mapping, page_size);
+            continue;
+        }
+
+        pages[counter] = page;
+    }
+
+    is_counting_per_opcode = (pages[Leader] != nullptr) && (pages[Instructions] != nullptr);
+    if(!is_counting_per_opcode)
+    {
+        unmap_pages();
+    }
+#endif
+}
+
+/**********************************************************************************************//**
+ * \brief Unmaps every counter's perf page, which stops counting per opcode
+ *************************************************************************************************/
+void Perf_Counters::unmap_pages()
+{
+    const auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    for(auto& page : pages)
+    {
+        if(page != nullptr)
+        {
+            ::munmap(page, page_size);
+            page = nullptr;
+        }
+    }
+
+    is_counting_per_opcode = false;
+}
+
+/**********************************************************************************************//**
+ * \brief Closes every counter and puts back whatever handled SIGIO before
+ *************************************************************************************************/
+void Perf_Counters::close()
+{
+    unmap_pages();
+
+    if(is_handler_installed)
+    {
+        ::sigaction(SIGIO, &previous_action, nullptr);
+        is_handler_installed = false;
+    }
+
+    for(auto& descriptor : descriptors)
+    {
+        if(descriptor >= 0)
+        {
+            ::close(descriptor);
+            descriptor = -1;
+        }
+    }
+
+    group_size = 0UL;
+}
@@ -0,0 +1,203 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <array>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Counting per opcode reads the counters from user space with rdpmc, which only x86 has
+#if defined(__linux__) && (defined(__x86_64__) || defined(__i386__))
+#define PERF_COUNTERS_HAVE_RDPMC 1
+#include <atomic>
+#include <linux/perf_event.h>
+#endif
+
+struct perf_event_mmap_page;
+
+/**************************************************************************************************
+ * \brief Samples the host's hardware performance counters while the virtual machine runs, and
+ *        attributes each sample to the opcode being executed when it was taken.
+ *
+ *        The counters are opened as a single group with perf_event_open, led by a cycle counter.
+ *        Every SAMPLE_PERIOD cycles the kernel signals the process, and the handler credits the
+ *        sample to the current opcode, so an opcode's share of the samples estimates its share of
+ *        the time. A sample spans thousands of dispatches, so samples alone can't split the other
+ *        counters by opcode.
+ *
+ *        Where the host lets user space read the counters with rdpmc, each counter's perf page is
+ *        mapped and begin() reads every counter as it dispatches an opcode. The change since the
+ *        previous read is charged to the opcode which just retired, so IPC and branch miss rate
+ *        can be reported per opcode. Reading the counters has a cost of its own, which start()
+ *        measures so the report can take it off again. Without rdpmc only the whole run's ratios
+ *        are reported, since a read() system call per opcode would swamp what it measured.
+ *
+ *        Any counter the host refuses is left out of the report. If there is no cycle counter at
+ *        all, as is common in containers and virtual machines, the task clock leads the group so
+ *        time per opcode is still reported.
+ *************************************************************************************************/
+class Perf_Counters
+{
+public:
+    Perf_Counters();
+    ~Perf_Counters();
+
+    Perf_Counters(const Perf_Counters&) = delete;
+    Perf_Counters& operator=(const Perf_Counters&) = delete;
+
+    bool open();
+    bool is_open() const;
+    const std::string& description() const;
+
+    void start();
+    void stop();
+
+    void begin(uint8_t opcode);
+    void retire(uint32_t, uint8_t, uint32_t) {}
+
+    uint64_t sample_count() const;
+    bool counts_per_opcode() const;
+    void write_report(std::ostream& stream) const;
+
+private:
+    enum Counter : std::size_t
+    {
+        Leader = 0,    // Cycles, or nanoseconds of task clock when there is no cycle counter
+        Instructions,
+        Branches,
+        Branch_Misses,
+        L1D_Misses,
+        COUNTER_COUNT
+    };
+
+    using Counts = std::array<uint64_t, COUNTER_COUNT>;
+
+    // The row charged for whatever ran before the first opcode, which is left out of the report
+    static constexpr std::size_t NO_OPCODE = 256UL;
+
+    static void on_sample(int signal, siginfo_t* information, void* context);
+    void sample();
+    void close();
+
+    void map_pages();
+    void unmap_pages();
+    void read_counters(Counts& counts) const;
+    void charge(uint8_t opcode);
+
+    std::array<int, COUNTER_COUNT> descriptors;
+    std::array<std::size_t, COUNTER_COUNT> positions{}; // Where each counter appears in a group read
+    std::size_t group_size{0UL};
+    bool leader_counts_cycles{false};
+    bool is_running{false};
+    bool is_handler_installed{false};
+    std::string status;
+
+    // Written by the execute loop, read by the signal handler
+    volatile std::sig_atomic_t current_opcode{0};
+
+    // Only written by the signal handler, and only read once sampling has stopped
+    std::array<uint64_t, 256> samples{};
+
+    // Every counter's value over the whole run, read when sampling stops
+    Counts run_totals{};
+
+    // Each counter's perf page while it can be read with rdpmc, otherwise nullptr
+    std::array<perf_event_mmap_page*, COUNTER_COUNT> pages{};
+    bool is_counting_per_opcode{false};
+
+    // What the counters read at the last dispatch, and which opcode the counts since belong to
+    Counts last_read{};
+    std::size_t previous_opcode{NO_OPCODE};
+
+    // Counted between each opcode's dispatch and the next, and how many times it was dispatched
+    std::array<Counts, NO_OPCODE + 1UL> opcode_totals{};
+    std::array<uint64_t, NO_OPCODE + 1UL> dispatches{};
+
+    // The least each counter moved across one read of them all, measured by start()
+    Counts read_cost{};
+
+    struct sigaction previous_action{};
+};
+
+/**********************************************************************************************//**
+ * \brief Notes the opcode about to be executed, so samples taken during it are credited to it
+ * \param opcode The instruction being dispatched
+ *************************************************************************************************/
+inline void Perf_Counters::begin(const uint8_t opcode)
+{
+    current_opcode = opcode;
+
+    if(is_counting_per_opcode)
+    {
+        charge(opcode);
+    }
+}
+
+/**********************************************************************************************//**
+ * \brief Reads every mapped counter without entering the kernel, following the retry protocol
+ *        described in linux/perf_event.h. Counters without a page read as zero.
+ * \param counts Receives each counter's value
+ *************************************************************************************************/
+inline void Perf_Counters::read_counters(Counts& counts) const
+{
+#ifdef PERF_COUNTERS_HAVE_RDPMC
+    for(std::size_t counter = Leader; counter < COUNTER_COUNT; ++counter)
+    {
+        const volatile perf_event_mmap_page* const page = pages[counter];
+        if(page == nullptr)
+        {
+            counts[counter] = 0UL;
+            continue;
+        }
+
+        // The kernel bumps lock whenever it moves the counter, so read again if it changed
+        uint32_t sequence = 0U;
+        uint64_t count = 0UL;
+        do
+        {
+            sequence = page->lock;
+            std::atomic_signal_fence(std::memory_order_acquire);
+
+            count = page->offset;
+            const auto index = page->index;
+            if(index != 0U)
+            {
+                // Sign extend the hardware counter from its width
+                const auto shift = 64U - page->pmc_width;
+                const auto value = static_cast<uint64_t>(__builtin_ia32_rdpmc(static_cast<int>(index - 1U)));
+                count += static_cast<uint64_t>(static_cast<int64_t>(value << shift) >> shift);
+            }
+
+            std::atomic_signal_fence(std::memory_order_acquire);
+        } while(page->lock != sequence);
+
+        counts[counter] = count;
+    }
+#else
+    counts.fill(0UL);
+#endif
+}
+
+/**********************************************************************************************//**
+ * \brief Charges the counts since the last dispatch to the opcode which just retired
+ * \param opcode The instruction being dispatched, which the next counts will be charged to
+ *************************************************************************************************/
+inline void Perf_Counters::charge(const uint8_t opcode)
+{
+    Counts counts;
+    read_counters(counts);
+
+    auto& totals = opcode_totals[previous_opcode];
+    for(std::size_t counter = Leader; counter < COUNTER_COUNT; ++counter)
+    {
+        totals[counter] += counts[counter] - last_read[counter];
+    }
+    ++dispatches[previous_opcode];
+
+    last_read = counts;
+    previous_opcode = opcode;
+}
+
+#endif
@@ -0,0 +1,199 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+
+constexpr std::size_t HOT_SPOT_COUNT = 20UL;
+
+/**********************************************************************************************//**
+ * \brief Quotes a string for use in JSON
+ * \param text The string to quote
+ * \returns The string in double quotes, with quotes, backslashes and control characters escaped
+ *************************************************************************************************/
+std::string quote(const std::string& text)
+{
+    std::string result("\"");
+    for(const auto character : text)
+    {
+        if((character == '"') || (character == '\\'))
+        {
+            result += '\\';
+            result += character;
+        }
+        else if(static_cast<unsigned char>(character) < 0x20U)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(character));
+            result += escaped;
+        }
+        else
+        {
+            result += character;
+        }
+    }
+
+    return result + "\"";
+}
+
+};
+
+/**********************************************************************************************//**
+ * \brief Constructor for the profiler
+ * \param image The program about to be run. Its global text symbols name the functions.
+ *************************************************************************************************/
+Profiler::Profiler(const Program_Image& image) :
+    program_counter_counts(image.text.size(), 0UL),
+    text(image.text),
+    calls(image.entry_point),
+    names(function_names(image))
+{
+
+}
+
+/**********************************************************************************************//**
+ * \brief Counts every instruction retired so far
+ * \returns The total
+ *************************************************************************************************/
+uint64_t Profiler::instructions() const
+{
+    return std::accumulate(opcode_counts.begin(), opcode_counts.end(), uint64_t{0UL});
+}
+
+/**********************************************************************************************//**
+ * \brief Counts the retired instructions with the given opcode
+ * \param opcode The instruction
+ * \returns The number retired
+ *************************************************************************************************/
+uint64_t Profiler::opcode_count(const uint8_t opcode) const
+{
+    return opcode_counts[opcode];
+}
+
+/**********************************************************************************************//**
+ * \brief Writes one line per call stack, naming each function from the outermost inwards followed
+ *        by the instructions retired in it. This is the folded format read by flame graph tools.
+ * \param stream Where to write
+ *************************************************************************************************/
+void Profiler::write_folded_stacks(std::ostream& stream) const
+{
+    const auto& nodes = calls.nodes();
+    for(uint32_t i = 0U; i < nodes.size(); ++i)
+    {
+        if(nodes[i].instructions != 0UL)
+        {
+            stream << calls.stack_name(i, names) << ' ' << nodes[i].instructions << '\n';
+        }
+    }
+}
+
+/**********************************************************************************************//**
+ * \brief Writes a JSON summary of the run: the instruction total, counts per opcode, the busiest
+ *        program counters, and the instructions retired by each function. A function's total
+ *        includes everything it called, while its self count doesn't.
+ * \param stream Where to write
+ *************************************************************************************************/
+void Profiler::write_summary(std::ostream& stream) const
+{
+    stream << "{\n  \"instructions\": " << instructions() << ",\n  \"opcodes\": {";
+
+    auto separator = "\n";
+    for(std::size_t opcode = 0UL; opcode < opcode_counts.size(); ++opcode)
+    {
+        if(opcode_counts[opcode] != 0UL)
+        {
+            stream << separator << "    " << quote(mnemonic(static_cast<uint8_t>(opcode))) << ": " << opcode_counts[opcode];
+            separator = ",\n";
+        }
+    }
+
+    std::vector<uint32_t> hot_spots;
+    for(uint32_t program_counter = 0U; program_counter < program_counter_counts.size(); ++program_counter)
+    {
+        if(program_counter_counts[program_counter] != 0UL)
+        {
+            hot_spots.push_back(program_counter);
+        }
+    }
+
+    std::stable_sort(hot_spots.begin(), hot_spots.end(), [this](const uint32_t lhs, const uint32_t rhs)
+    {
+        return program_counter_counts[lhs] > program_counter_counts[rhs];
+    });
+    hot_spots.resize(std::min(hot_spots.size(), HOT_SPOT_COUNT));
+
+    stream << "\n  },\n  \"hot_spots\": [";
+    separator = "\n";
+    for(const auto program_counter : hot_spots)
+    {
+        stream << separator << "    {\"pc\": " << program_counter
+               << ", \"opcode\": " << quote(mnemonic(text[program_counter]))
+               << ", \"count\": " << program_counter_counts[program_counter] << "}";
+        separator = ",\n";
+    }
+
+    struct Function_Totals
+    {
+        uint32_t function;
+        uint64_t self;
+        uint64_t total;
+        uint64_t calls;
+    };
+
+    std::vector<Function_Totals> functions;
+    std::unordered_map<uint32_t, std::size_t> function_indices;
+    const auto totals_for = [&](const uint32_t function) -> Function_Totals&
+    {
+        const auto [entry, inserted] = function_indices.emplace(function, functions.size());
+        if(inserted)
+        {
+            functions.push_back({function, 0UL, 0UL, 0UL});
+        }
+        return functions[entry->second];
+    };
+
+    const auto& nodes = calls.nodes();
+    for(const auto& frame : nodes)
+    {
+        auto& totals = totals_for(frame.function);
+        totals.self += frame.instructions;
+        totals.calls += frame.calls;
+
+        // Recursive functions appear on the stack more than once, but only count once
+        std::unordered_set<uint32_t> counted;
+        for(auto ancestor = &frame; ; ancestor = &nodes[ancestor->parent])
+        {
+            if(counted.insert(ancestor->function).second)
+            {
+                totals_for(ancestor->function).total += frame.instructions;
+            }
+
+            if(ancestor->parent == Call_Tree::NO_PARENT)
+            {
+                break;
+            }
+        }
+    }
+
+    std::stable_sort(functions.begin(), functions.end(), [](const Function_Totals& lhs, const Function_Totals& rhs)
+    {
+        return lhs.self > rhs.self;
+    });
+
+    stream << "\n  ],\n  \"functions\": [";
+    separator = "\n";
+    for(const auto& totals : functions)
+    {
+        stream << separator << "    {\"name\": " << quote(function_name(names, totals.function))
+               << ", \"self\": " << totals.self << ", \"total\": " << totals.total
+               << ", \"calls\": " << totals.calls << "}";
+        separator = ",\n";
+    }
+
+    stream << "\n  ]\n}\n";
+}
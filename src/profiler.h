@@ -0,0 +1,70 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "call-tree.h"
+#include "instructions.h"
+#include "program-image.h"
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+/**************************************************************************************************
+ * \brief Watches a program run, counting every instruction retired by opcode, by program counter
+ *        and by call stack. The call stack is tracked through CALL and LEV, so instructions are
+ *        attributed to the function running them and to each of its callers.
+ *
+ *        The virtual machine's execute loop is a template over its observer. Programs run without
+ *        a profiler use an observer which does nothing, so profiling costs nothing unless asked for.
+ *************************************************************************************************/
+class Profiler
+{
+public:
+    explicit Profiler(const Program_Image& image);
+
+    void begin(uint8_t) {}
+    void retire(uint32_t program_counter, uint8_t opcode, uint32_t next_program_counter);
+
+    uint64_t instructions() const;
+    uint64_t opcode_count(uint8_t opcode) const;
+
+    void write_folded_stacks(std::ostream& stream) const;
+    void write_summary(std::ostream& stream) const;
+
+private:
+    std::array<uint64_t, 256> opcode_counts{};
+    std::vector<uint64_t> program_counter_counts;
+    std::vector<uint8_t> text;
+
+    Call_Tree calls;
+    Function_Names names;
+};
+
+/**********************************************************************************************//**
+ * \brief Records a single retired instruction. Kept in the header so the execute loop can inline it.
+ * \param program_counter Offset of the instruction
+ * \param opcode The instruction
+ * \param next_program_counter Where execution continues. The target of a CALL.
+ *************************************************************************************************/
+inline void Profiler::retire(const uint32_t program_counter, const uint8_t opcode, const uint32_t next_program_counter)
+{
+    ++opcode_counts[opcode];
+    if(program_counter < program_counter_counts.size())
+    {
+        ++program_counter_counts[program_counter];
+    }
+
+    calls.retire();
+
+    if(opcode == Instructions::CALL)
+    {
+        calls.enter(next_program_counter);
+    }
+    else if(opcode == Instructions::LEV)
+    {
+        calls.leave();
+    }
+}
+
+#endif
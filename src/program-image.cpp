@@ -0,0 +1,49 @@
+#include "program-image.h"
+#include "memory-map.h"
+
+#include <cstdio>
+
+/**********************************************************************************************//**
+ * \brief Collects the names of a program's functions from its symbols
+ * \param image The linked program. Its global text symbols name the functions.
+ * \returns The name of each function, by offset. Where several symbols share an offset, the
+ *          lowest name is kept, so the same name is chosen every run.
+ *************************************************************************************************/
+Function_Names function_names(const Program_Image& image)
+{
+    Function_Names names;
+    for(const auto& [name, address] : image.symbols)
+    {
+        if(address >= Memory_Map::DATA_START_ADDRESS)
+        {
+            continue;
+        }
+
+        const auto [entry, inserted] = names.emplace(address, name);
+        if(!inserted && (name < entry->second))
+        {
+            entry->second = name;
+        }
+    }
+
+    return names;
+}
+
+/**********************************************************************************************//**
+ * \brief Names a function
+ * \param names The program's function names
+ * \param function Offset of the function
+ * \returns The function's symbol, or its offset in hexadecimal if it doesn't have one
+ *************************************************************************************************/
+std::string function_name(const Function_Names& names, const uint32_t function)
+{
+    const auto name = names.find(function);
+    if(name != names.end())
+    {
+        return name->second;
+    }
+
+    char address[16];
+    std::snprintf(address, sizeof(address), "0x%08x", function);
+    return address;
+}
@@ -0,0 +1,34 @@
+#ifndef PROGRAM_IMAGE_H
+#define PROGRAM_IMAGE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**************************************************************************************************
+ * \brief A fully linked program, ready to be loaded into the virtual machine. Every address inside
+ *        text and data has already been resolved.
+ *************************************************************************************************/
+struct Program_Image
+{
+    std::vector<uint8_t> text;
+    std::vector<uint8_t> data;
+
+    // Bytes of zero initialised data which follow the data segment once loaded
+    uint32_t bss_size{0U};
+
+    // Offset into text where execution begins
+    uint32_t entry_point{0U};
+
+    // Resolved global symbols, mapped to their final address. Kept for diagnostics.
+    std::unordered_map<std::string, uint32_t> symbols;
+};
+
+// Names of the functions in a program, by their offset in text
+using Function_Names = std::unordered_map<uint32_t, std::string>;
+
+Function_Names function_names(const Program_Image& image);
+std::string function_name(const Function_Names& names, uint32_t function);
+
+#endif
@@ -0,0 +1,244 @@
+#include "syscall-log.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+
+constexpr char LOG_MAGIC[8] = {'C', 'I', 'S', 'Y', 'S', 'L', 'G', '1'};
+
+};
+
+/**********************************************************************************************//**
+ * \brief Constructor for the log
+ * \param mode Whether the log is filled by a run, or loaded and fed back to one
+ *************************************************************************************************/
+Syscall_Log::Syscall_Log(const Mode mode) :
+    current_mode(mode)
+{
+
+}
+
+/**********************************************************************************************//**
+ * \brief Reports whether the log is being recorded or replayed
+ * \returns The mode
+ *************************************************************************************************/
+Syscall_Log::Mode Syscall_Log::mode() const
+{
+    return current_mode;
+}
+
+/**********************************************************************************************//**
+ * \brief Chooses whether a replayed MALC must return the same address it did when recorded.
+ *        Otherwise it only has to fail in the same places.
+ * \param should_compare True to compare the addresses
+ *************************************************************************************************/
+void Syscall_Log::set_compares_addresses(const bool should_compare)
+{
+    should_compare_addresses = should_compare;
+}
+
+/**********************************************************************************************//**
+ * \brief Reports whether a replayed MALC must return the same address it did when recorded
+ * \returns True if addresses are compared
+ *************************************************************************************************/
+bool Syscall_Log::compares_addresses() const
+{
+    return should_compare_addresses;
+}
+
+/**********************************************************************************************//**
+ * \brief Reads a log saved by an earlier run, ready to replay from its first entry
+ * \param path The log file
+ * \param error Receives the reason if the file can't be read
+ * \returns True if the file was read
+ *************************************************************************************************/
+bool Syscall_Log::load(const std::string& path, std::string& error)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+    {
+        error = "Unable to open " + path;
+        return false;
+    }
+
+    char magic[sizeof(LOG_MAGIC)] = {};
+    uint64_t count{0UL};
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if(!file || !std::equal(std::begin(LOG_MAGIC), std::end(LOG_MAGIC), magic))
+    {
+        error = path + " isn't a system call log";
+        return false;
+    }
+
+    bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    cursor = 0UL;
+    replayed = 0UL;
+
+    // Every entry is walked once, so a truncated or padded log is refused rather than diverging
+    // part way through the run
+    std::size_t found{0UL};
+    while(cursor < bytes.size())
+    {
+        uint32_t result{0U};
+        uint32_t length{0U};
+        cursor += 1UL;
+        if(!read_number(result) || !read_number(length) || (length > (bytes.size() - cursor)))
+        {
+            break;
+        }
+
+        cursor += length;
+        ++found;
+    }
+
+    const auto is_complete = (cursor == bytes.size()) && (found == count);
+    cursor = 0UL;
+    if(!is_complete)
+    {
+        bytes.clear();
+        entries = 0UL;
+        error = path + " doesn't hold the " + std::to_string(count) + " system calls its header lists";
+        return false;
+    }
+
+    entries = found;
+    return true;
+}
+
+/**********************************************************************************************//**
+ * \brief Writes the log to a file
+ * \param path Where to write it. Any existing file is replaced.
+ * \param error Receives the reason if the file can't be written
+ * \returns True if the whole log was written
+ *************************************************************************************************/
+bool Syscall_Log::save(const std::string& path, std::string& error) const
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    const auto count = static_cast<uint64_t>(entries);
+    file.write(LOG_MAGIC, sizeof(LOG_MAGIC));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+
+    if(!file)
+    {
+        error = "Unable to write the system call log to " + path;
+        return false;
+    }
+
+    return true;
+}
+
+/**********************************************************************************************//**
+ * \brief Appends a system call to the log
+ * \param opcode The system call
+ * \param result What it left in ax
+ * \param payload Bytes it placed in the program's memory, which replaying must put back
+ *************************************************************************************************/
+void Syscall_Log::record(const uint8_t opcode, const uint32_t result, const std::string_view payload)
+{
+    bytes.push_back(opcode);
+    append_number(result);
+    append_number(static_cast<uint32_t>(payload.size()));
+    bytes.insert(bytes.end(), payload.begin(), payload.end());
+
+    ++entries;
+}
+
+/**********************************************************************************************//**
+ * \brief Takes the next system call from the log
+ * \param opcode The system call the program is making
+ * \param result Receives what it left in ax when recorded
+ * \param payload Receives the bytes it placed in memory. Only valid while the log is.
+ * \returns False if the log is exhausted, or its next entry is a different system call. Nothing
+ *          is taken from the log in that case.
+ *************************************************************************************************/
+bool Syscall_Log::replay(const uint8_t opcode, uint32_t& result, std::string_view& payload)
+{
+    if((cursor >= bytes.size()) || (bytes[cursor] != opcode))
+    {
+        return false;
+    }
+
+    const auto start = cursor;
+    cursor += 1UL;
+
+    uint32_t length{0U};
+    if(!read_number(result) || !read_number(length) || (length > (bytes.size() - cursor)))
+    {
+        cursor = start;
+        return false;
+    }
+
+    payload = std::string_view(reinterpret_cast<const char*>(bytes.data() + cursor), length);
+    cursor += length;
+    ++replayed;
+
+    return true;
+}
+
+/**********************************************************************************************//**
+ * \brief Counts the system calls in the log
+ * \returns The number recorded or loaded
+ *************************************************************************************************/
+std::size_t Syscall_Log::entry_count() const
+{
+    return entries;
+}
+
+/**********************************************************************************************//**
+ * \brief Counts the system calls not replayed yet
+ * \returns The number left
+ *************************************************************************************************/
+std::size_t Syscall_Log::remaining() const
+{
+    return entries - std::min(entries, replayed);
+}
+
+/**********************************************************************************************//**
+ * \brief Appends a number seven bits at a time, lowest first, with the top bit of each byte set
+ *        if another follows. Most results are small, so most take a single byte.
+ * \param value The number
+ *************************************************************************************************/
+void Syscall_Log::append_number(uint32_t value)
+{
+    while(value >= 0x80U)
+    {
+        bytes.push_back(static_cast<uint8_t>((value & 0x7FU) | 0x80U));
+        value >>= 7U;
+    }
+
+    bytes.push_back(static_cast<uint8_t>(value));
+}
+
+/**********************************************************************************************//**
+ * \brief Reads a number written by append_number, advancing the cursor past it
+ * \param value Receives the number
+ * \returns False if the log ends part way through the number, or it doesn't fit in 32 bits
+ *************************************************************************************************/
+bool Syscall_Log::read_number(uint32_t& value)
+{
+    value = 0U;
+    for(uint32_t shift = 0U; (shift < 35U) && (cursor < bytes.size()); shift += 7U)
+    {
+        const auto byte = bytes[cursor++];
+
+        // The fifth byte only has room for the top four bits
+        if((shift == 28U) && ((byte & 0xF0U) != 0U))
+        {
+            return false;
+        }
+
+        value |= static_cast<uint32_t>(byte & 0x7FU) << shift;
+        if((byte & 0x80U) == 0U)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
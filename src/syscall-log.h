@@ -0,0 +1,61 @@
+#ifndef SYSCALL_LOG_H
+#define SYSCALL_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**************************************************************************************************
+ * \brief The results of every system call a program made, in order, so the run can be repeated
+ *        without touching the host.
+ *
+ *        While recording, the virtual machine appends each call's opcode and result, along with
+ *        the bytes READ placed in memory. While replaying, OPEN, READ and CLOS take their results
+ *        from the log instead of the host, and the results of the calls the virtual machine works
+ *        out itself are checked against it. Any difference means the run has diverged. Heap
+ *        addresses are only compared when asked for, since a change to the allocator moves them
+ *        without changing what the program does.
+ *
+ *        Entries are kept encoded in memory and saved as they are: the opcode as a byte, then
+ *        the result and the payload length as LEB128 numbers, then the payload.
+ *************************************************************************************************/
+class Syscall_Log
+{
+public:
+    enum class Mode : uint8_t
+    {
+        Record,
+        Replay
+    };
+
+    explicit Syscall_Log(Mode mode);
+
+    Mode mode() const;
+
+    void set_compares_addresses(bool should_compare);
+    bool compares_addresses() const;
+
+    bool load(const std::string& path, std::string& error);
+    bool save(const std::string& path, std::string& error) const;
+
+    void record(uint8_t opcode, uint32_t result, std::string_view payload = {});
+    bool replay(uint8_t opcode, uint32_t& result, std::string_view& payload);
+
+    std::size_t entry_count() const;
+    std::size_t remaining() const;
+
+private:
+    void append_number(uint32_t value);
+    bool read_number(uint32_t& value);
+
+    Mode current_mode;
+    bool should_compare_addresses{false};
+    std::vector<uint8_t> bytes;
+    std::size_t cursor{0UL};
+    std::size_t entries{0UL};
+    std::size_t replayed{0UL};
+};
+
+#endif
@@ -0,0 +1,185 @@
+#include "call-tree.h"
+#include "instructions.h"
+#include "trace.h"
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+/**********************************************************************************************//**
+ * \brief Prints every instruction in the order it was executed, indented by call depth. The target
+ *        of a CALL is the program counter of the record after it.
+ * \param trace The trace to print
+ *************************************************************************************************/
+void print_instructions(const Trace_File& trace)
+{
+    std::size_t depth = 0UL;
+    for(std::size_t i = 0UL; i < trace.records.size(); ++i)
+    {
+        const auto& record = trace.records[i];
+        const auto opcode = record.opcode();
+
+        std::printf("%10zu  %6u  %*s%-4s  ax 0x%08x  sp 0x%08x  bp 0x%08x",
+                    i, record.program_counter(), static_cast<int>(depth * 2UL), "", mnemonic(opcode),
+                    record.ax, record.stack_pointer, record.base_pointer);
+
+        if((opcode == Instructions::CALL) && ((i + 1UL) < trace.records.size()))
+        {
+            std::printf("  -> %s", function_name(trace.function_names, trace.records[i + 1UL].program_counter()).c_str());
+            ++depth;
+        }
+        else if((opcode == Instructions::LEV) && (depth != 0UL))
+        {
+            --depth;
+        }
+
+        std::printf("\n");
+    }
+}
+
+/**********************************************************************************************//**
+ * \brief Rebuilds the call tree from the CALL and LEV instructions in the trace
+ * \param trace The trace. It mustn't be empty.
+ * \returns Every distinct call stack, following the calls the same way the profiler does
+ *************************************************************************************************/
+Call_Tree build_call_tree(const Trace_File& trace)
+{
+    Call_Tree calls(trace.records.front().program_counter());
+    for(std::size_t i = 0UL; i < trace.records.size(); ++i)
+    {
+        calls.retire();
+
+        const auto opcode = trace.records[i].opcode();
+        if((opcode == Instructions::CALL) && ((i + 1UL) < trace.records.size()))
+        {
+            calls.enter(trace.records[i + 1UL].program_counter());
+        }
+        else if(opcode == Instructions::LEV)
+        {
+            calls.leave();
+        }
+    }
+
+    return calls;
+}
+
+/**********************************************************************************************//**
+ * \brief Prints the call tree depth first, each call followed by everything it called in the order
+ *        they were first called
+ * \param trace The trace, for function names
+ * \param calls The call tree
+ *************************************************************************************************/
+void print_calls(const Trace_File& trace, const Call_Tree& calls)
+{
+    const auto& nodes = calls.nodes();
+    const auto totals = calls.totals();
+
+    // Children are always created after their parents, so walking the nodes in order lists each
+    // one's children in the order they were first called
+    std::vector<std::vector<uint32_t>> children(nodes.size());
+    for(auto node = 1U; node < nodes.size(); ++node)
+    {
+        children[nodes[node].parent].push_back(node);
+    }
+
+    // Deep recursion in the program shouldn't mean deep recursion here
+    std::vector<std::pair<uint32_t, std::size_t>> pending{{0U, 0UL}};
+    while(!pending.empty())
+    {
+        const auto [call, depth] = pending.back();
+        pending.pop_back();
+
+        const auto& node = nodes[call];
+        std::printf("%*s%s  calls %llu  self %llu  total %llu\n",
+                    static_cast<int>(depth * 2UL), "", function_name(trace.function_names, node.function).c_str(),
+                    static_cast<unsigned long long>(node.calls), static_cast<unsigned long long>(node.instructions),
+                    static_cast<unsigned long long>(totals[call]));
+
+        for(auto child = children[call].rbegin(); child != children[call].rend(); ++child)
+        {
+            pending.emplace_back(*child, depth + 1UL);
+        }
+    }
+}
+
+};
+
+/**********************************************************************************************//**
+ * \brief Reads a trace written by the interpreter's --trace option and prints the instruction
+ *        stream, the call tree, or both
+ * \param argc Argument count
+ * \param argv Argument vector
+ *************************************************************************************************/
+int main(int argc, char** argv)
+{
+    std::string path;
+    auto show_instructions = false;
+    auto show_calls = false;
+    for(auto i = 1; i < argc; ++i)
+    {
+        const std::string argument(argv[i]);
+        if(argument == "--instructions")
+        {
+            show_instructions = true;
+        }
+        else if(argument == "--calls")
+        {
+            show_calls = true;
+        }
+        else
+        {
+            path = argument;
+        }
+    }
+
+    if(path.empty())
+    {
+        std::cerr << "Usage: trace-decoder [--instructions] [--calls] <trace file>" << std::endl;
+        return 1;
+    }
+
+    if(!show_instructions && !show_calls)
+    {
+        show_instructions = true;
+        show_calls = true;
+    }
+
+    Trace_File trace;
+    std::string error;
+    if(!read_trace(path, trace, error))
+    {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    if(trace.stalls != 0UL)
+    {
+        std::cerr << "The program waited for the trace writer " << trace.stalls << " times" << std::endl;
+    }
+
+    if(show_instructions)
+    {
+        print_instructions(trace);
+    }
+
+    if(show_calls)
+    {
+        if(show_instructions)
+        {
+            std::printf("\n");
+        }
+
+        if(!trace.records.empty())
+        {
+            const auto calls = build_call_tree(trace);
+            print_calls(trace, calls);
+        }
+    }
+
+    return 0;
+}
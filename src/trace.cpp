@@ -0,0 +1,431 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace
+{
+
+constexpr char TRACE_MAGIC[8] = {'C', 'I', 'T', 'R', 'A', 'C', 'E', '1'};
+
+// The writer drains at most this many records at a time, and maps room for them before it does
+constexpr std::size_t DRAIN_BATCH = 4096UL;
+
+// The file starts with room for this many records and doubles whenever it fills
+constexpr uint64_t INITIAL_RECORDS = 1024UL * 1024UL;
+
+// How long the writer sleeps when the ring is empty
+constexpr auto IDLE_INTERVAL = std::chrono::microseconds(100);
+
+/**********************************************************************************************//**
+ * \brief Rounds a ring's capacity up to a power of two, so positions can be masked into slots
+ * \param capacity The requested capacity
+ * \returns The smallest power of two no smaller than the capacity, and at least two
+ *************************************************************************************************/
+std::size_t round_up_capacity(const std::size_t capacity)
+{
+    std::size_t result = 2UL;
+    while(result < capacity)
+    {
+        result <<= 1U;
+    }
+
+    return result;
+}
+
+/**********************************************************************************************//**
+ * \brief Writes all of a buffer at a given offset, retrying partial and interrupted writes
+ * \param descriptor The file to write to
+ * \param bytes The bytes to write
+ * \param length The number of bytes
+ * \param offset Where in the file to write them
+ * \returns True if every byte was written
+ *************************************************************************************************/
+bool write_at(const int descriptor, const void* bytes, std::size_t length, off_t offset)
+{
+    auto position = static_cast<const uint8_t*>(bytes);
+    while(length != 0UL)
+    {
+        const auto count = ::pwrite(descriptor, position, length, offset);
+        if(count < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+
+        position += count;
+        length -= static_cast<std::size_t>(count);
+        offset += count;
+    }
+
+    return true;
+}
+
+};
+
+/**********************************************************************************************//**
+ * \brief Constructor for the ring
+ * \param capacity The number of records the ring can hold. Rounded up to a power of two.
+ *************************************************************************************************/
+Trace_Ring::Trace_Ring(const std::size_t capacity) :
+    records(round_up_capacity(capacity)),
+    mask(records.size() - 1UL)
+{
+
+}
+
+/**********************************************************************************************//**
+ * \brief Removes records from the ring, oldest first. Only called from the consumer's thread.
+ * \param destination Where to copy the records
+ * \param maximum The most records to remove
+ * \returns The number of records removed, which is zero if the ring is empty
+ *************************************************************************************************/
+std::size_t Trace_Ring::pop(Trace_Record* const destination, const std::size_t maximum)
+{
+    const auto position = tail.load(std::memory_order_relaxed);
+    if((cached_head - position) < maximum)
+    {
+        cached_head = head.load(std::memory_order_acquire);
+    }
+
+    const auto count = static_cast<std::size_t>(std::min<uint64_t>(cached_head - position, maximum));
+
+    // The records may wrap around the end of the ring, so copy them in at most two runs
+    const auto first = static_cast<std::size_t>(position & mask);
+    const auto run = std::min(count, records.size() - first);
+    std::copy_n(records.begin() + first, run, destination);
+    std::copy_n(records.begin(), count - run, destination + run);
+
+    tail.store(position + count, std::memory_order_release);
+
+    return count;
+}
+
+/**********************************************************************************************//**
+ * \brief Reports how many records the ring can hold
+ * \returns The capacity
+ *************************************************************************************************/
+std::size_t Trace_Ring::capacity() const
+{
+    return records.size();
+}
+
+/**********************************************************************************************//**
+ * \brief Constructor for the trace writer
+ * \param ring_capacity The number of records the execute loop can get ahead of the writer
+ *************************************************************************************************/
+Trace_Writer::Trace_Writer(const std::size_t ring_capacity) :
+    ring(ring_capacity)
+{
+
+}
+
+/**********************************************************************************************//**
+ * \brief Destructor for the trace writer. Finishes the file if it's still open.
+ *************************************************************************************************/
+Trace_Writer::~Trace_Writer()
+{
+    close();
+}
+
+/**********************************************************************************************//**
+ * \brief Creates the trace file and starts the thread which writes to it
+ * \param path Where to write the trace. Any existing file is replaced.
+ * \param image The program about to be traced. Its global text symbols name the functions.
+ * \returns True if the file was created, otherwise error() says why it wasn't
+ *************************************************************************************************/
+bool Trace_Writer::open(const std::string& path, const Program_Image& image)
+{
+    if(writer.joinable())
+    {
+        status = "A trace is already being written";
+        return false;
+    }
+
+    const auto names = function_names(image);
+    symbols.assign(names.begin(), names.end());
+    std::sort(symbols.begin(), symbols.end());
+
+    descriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(descriptor < 0)
+    {
+        status = "Unable to create " + path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    written = 0UL;
+    stalls = 0UL;
+    has_failed = false;
+    if(!reserve(INITIAL_RECORDS))
+    {
+        ::close(descriptor);
+        descriptor = -1;
+        return false;
+    }
+
+    is_draining.store(true, std::memory_order_release);
+    writer = std::thread(&Trace_Writer::drain, this);
+
+    return true;
+}
+
+/**********************************************************************************************//**
+ * \brief Waits for every appended record to be written, then finishes the file with its header
+ *        and symbols. Nothing may be appended once this has been called.
+ * \returns True if the whole trace was written
+ *************************************************************************************************/
+bool Trace_Writer::close()
+{
+    if(!writer.joinable())
+    {
+        return false;
+    }
+
+    is_draining.store(false, std::memory_order_release);
+    writer.join();
+
+    if(!has_failed)
+    {
+        Trace_Header header{};
+        std::copy(std::begin(TRACE_MAGIC), std::end(TRACE_MAGIC), header.magic);
+        header.record_size = sizeof(Trace_Record);
+        header.symbol_count = static_cast<uint32_t>(symbols.size());
+        header.record_count = written;
+        header.stalls = stalls;
+        std::memcpy(mapping, &header, sizeof(header));
+    }
+
+    unmap();
+
+    // The mapping was grown ahead of the records, so cut the file back to them
+    auto end = static_cast<off_t>(sizeof(Trace_Header) + (written * sizeof(Trace_Record)));
+    if(!has_failed && (::ftruncate(descriptor, end) != 0))
+    {
+        has_failed = true;
+        status = std::string("Unable to finish the trace: ") + std::strerror(errno);
+    }
+
+    for(const auto& [address, name] : symbols)
+    {
+        if(has_failed)
+        {
+            break;
+        }
+
+        const uint32_t entry[2] = {address, static_cast<uint32_t>(name.size())};
+        if(!write_at(descriptor, entry, sizeof(entry), end) ||
+           !write_at(descriptor, name.data(), name.size(), end + static_cast<off_t>(sizeof(entry))))
+        {
+            has_failed = true;
+            status = std::string("Unable to write the trace's symbols: ") + std::strerror(errno);
+        }
+        end += static_cast<off_t>(sizeof(entry) + name.size());
+    }
+
+    ::close(descriptor);
+    descriptor = -1;
+
+    return !has_failed;
+}
+
+/**********************************************************************************************//**
+ * \brief Explains why the trace couldn't be opened or written
+ * \returns The reason, or an empty string if nothing has gone wrong
+ *************************************************************************************************/
+const std::string& Trace_Writer::error() const
+{
+    return status;
+}
+
+/**********************************************************************************************//**
+ * \brief Counts the records written to the file. Only meaningful once the trace has been closed.
+ * \returns The number of records
+ *************************************************************************************************/
+uint64_t Trace_Writer::record_count() const
+{
+    return written;
+}
+
+/**********************************************************************************************//**
+ * \brief Counts how often the execute loop found the ring full and had to wait for the writer
+ * \returns The number of waits
+ *************************************************************************************************/
+uint64_t Trace_Writer::stall_count() const
+{
+    return stalls;
+}
+
+/**********************************************************************************************//**
+ * \brief The writer thread. Moves records from the ring straight into the mapped file until the
+ *        trace is closed and the ring is empty. If the file can't be grown, records are still
+ *        taken from the ring and dropped, so the execute loop never waits forever.
+ *************************************************************************************************/
+void Trace_Writer::drain()
+{
+    std::vector<Trace_Record> discarded;
+
+    while(true)
+    {
+        // Read before popping, so anything appended before the trace was closed is still drained
+        const auto is_closing = !is_draining.load(std::memory_order_acquire);
+
+        std::size_t count = 0UL;
+        if(!has_failed && reserve(written + DRAIN_BATCH))
+        {
+            auto destination = reinterpret_cast<Trace_Record*>(mapping + sizeof(Trace_Header));
+            count = ring.pop(destination + written, DRAIN_BATCH);
+            written += count;
+        }
+        else
+        {
+            discarded.resize(DRAIN_BATCH);
+            count = ring.pop(discarded.data(), DRAIN_BATCH);
+        }
+
+        if(count == 0UL)
+        {
+            if(is_closing)
+            {
+                break;
+            }
+
+            std::this_thread::sleep_for(IDLE_INTERVAL);
+        }
+    }
+}
+
+/**********************************************************************************************//**
+ * \brief Makes sure the mapping has room for a number of records, doubling the file if it doesn't
+ * \param records The number of records which must fit after the header
+ * \returns True if they fit. Otherwise the trace has failed and error() says why.
+ *************************************************************************************************/
+bool Trace_Writer::reserve(const uint64_t records)
+{
+    const auto required = sizeof(Trace_Header) + (records * sizeof(Trace_Record));
+    if(required <= mapping_size)
+    {
+        return true;
+    }
+
+    const auto size = std::max<std::size_t>(required, mapping_size * 2UL);
+
+    unmap();
+    if(::ftruncate(descriptor, static_cast<off_t>(size)) != 0)
+    {
+        has_failed = true;
+        status = std::string("Unable to grow the trace: ") + std::strerror(errno);
+        return false;
+    }
+
+    const auto address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    if(address == MAP_FAILED)
+    {
+        has_failed = true;
+        status = std::string("Unable to map the trace: ") + std::strerror(errno);
+        return false;
+    }
+
+    mapping = static_cast<uint8_t*>(address);
+    mapping_size = size;
+
+    return true;
+}
+
+/**********************************************************************************************//**
+ * \brief Releases the mapping, if there is one
+ *************************************************************************************************/
+void Trace_Writer::unmap()
+{
+    if(mapping != nullptr)
+    {
+        ::munmap(mapping, mapping_size);
+        mapping = nullptr;
+        mapping_size = 0UL;
+    }
+}
+
+/**********************************************************************************************//**
+ * \brief Reads a trace file written by Trace_Writer
+ * \param path The trace file
+ * \param trace Receives the records and the function names
+ * \param error Receives the reason if the file can't be read
+ * \returns True if the whole file was read
+ *************************************************************************************************/
+bool read_trace(const std::string& path, Trace_File& trace, std::string& error)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+    {
+        error = "Unable to open " + path;
+        return false;
+    }
+
+    Trace_Header header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if(!file || !std::equal(std::begin(TRACE_MAGIC), std::end(TRACE_MAGIC), header.magic))
+    {
+        error = path + " isn't a trace file";
+        return false;
+    }
+
+    if(header.record_size != sizeof(Trace_Record))
+    {
+        error = path + " was written with a different record size";
+        return false;
+    }
+
+    // Check the records are all there before allocating room for them
+    const auto start = file.tellg();
+    file.seekg(0, std::ios::end);
+    const auto end = file.tellg();
+    const auto available = static_cast<uint64_t>(end - start);
+    file.seekg(start);
+    if(header.record_count > (available / sizeof(Trace_Record)))
+    {
+        error = path + " is truncated";
+        return false;
+    }
+
+    trace.records.resize(header.record_count);
+    file.read(reinterpret_cast<char*>(trace.records.data()),
+              static_cast<std::streamsize>(header.record_count * sizeof(Trace_Record)));
+
+    trace.function_names.clear();
+    for(uint32_t i = 0U; file && (i < header.symbol_count); ++i)
+    {
+        uint32_t entry[2] = {0U, 0U};
+        file.read(reinterpret_cast<char*>(entry), sizeof(entry));
+
+        // The name's length comes from the file, so check it fits in what's left of it
+        const auto left = file ? static_cast<uint64_t>(end - file.tellg()) : 0U;
+        if(file && (entry[1] > left))
+        {
+            error = path + " is a corrupt trace";
+            return false;
+        }
+
+        std::string name(entry[1], '\0');
+        file.read(name.data(), static_cast<std::streamsize>(name.size()));
+        trace.function_names.emplace(entry[0], std::move(name));
+    }
+
+    if(!file)
+    {
+        error = path + " is truncated";
+        return false;
+    }
+
+    trace.stalls = header.stalls;
+
+    return true;
+}
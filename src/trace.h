@@ -0,0 +1,172 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "program-image.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**************************************************************************************************
+ * \brief The state of the virtual machine as an instruction is dispatched. The text segment is
+ *        far smaller than 16MB, so the program counter and opcode share a word.
+ *************************************************************************************************/
+struct Trace_Record
+{
+    uint32_t location;      // (program counter << 8) | opcode
+    uint32_t ax;
+    uint32_t stack_pointer;
+    uint32_t base_pointer;
+
+    uint32_t program_counter() const { return location >> 8U; }
+    uint8_t opcode() const { return static_cast<uint8_t>(location & 0xFFU); }
+};
+
+static_assert(sizeof(Trace_Record) == 16UL, "Trace records are written to disk as they are");
+
+/**************************************************************************************************
+ * \brief Fixed size header at the start of every trace file. The records follow it, and the
+ *        function symbols follow the records, each as its address, the length of its name and the
+ *        name itself. Every field is in the host's byte order.
+ *************************************************************************************************/
+struct Trace_Header
+{
+    char magic[8];
+    uint32_t record_size;
+    uint32_t symbol_count;
+    uint64_t record_count;
+    uint64_t stalls;        // Times the execute loop waited for the writer to catch up
+};
+
+static_assert(sizeof(Trace_Header) == 32UL, "The trace header is written to disk as it is");
+
+/**************************************************************************************************
+ * \brief A bounded queue of trace records between exactly one producer, the execute loop, and
+ *        exactly one consumer, the thread writing them out. Neither side takes a lock. Each side
+ *        keeps its own copy of the other's index and only reloads it when that copy says there
+ *        isn't enough room or enough records, so the shared indices rarely move between cores.
+ *************************************************************************************************/
+class Trace_Ring
+{
+public:
+    explicit Trace_Ring(std::size_t capacity);
+
+    bool try_push(const Trace_Record& record);
+    std::size_t pop(Trace_Record* destination, std::size_t maximum);
+
+    std::size_t capacity() const;
+
+private:
+    static constexpr std::size_t CACHE_LINE = 64UL;
+
+    std::vector<Trace_Record> records;
+    uint64_t mask;
+
+    alignas(CACHE_LINE) std::atomic<uint64_t> head{0UL}; // Next slot to write. Stored by the producer.
+    uint64_t cached_tail{0UL};
+
+    alignas(CACHE_LINE) std::atomic<uint64_t> tail{0UL}; // Next slot to read. Stored by the consumer.
+    uint64_t cached_head{0UL};
+};
+
+/**************************************************************************************************
+ * \brief Collects the trace of a running program. The execute loop appends records to a ring,
+ *        and a background thread drains the ring into a memory mapped file, growing the mapping
+ *        as it fills. If the writer falls behind, the execute loop waits rather than losing records,
+ *        since a gap would break the call tree the decoder rebuilds.
+ *************************************************************************************************/
+class Trace_Writer
+{
+public:
+    static constexpr std::size_t DEFAULT_RING_CAPACITY = 64UL * 1024UL;
+
+    explicit Trace_Writer(std::size_t ring_capacity = DEFAULT_RING_CAPACITY);
+    ~Trace_Writer();
+
+    Trace_Writer(const Trace_Writer&) = delete;
+    Trace_Writer& operator=(const Trace_Writer&) = delete;
+
+    bool open(const std::string& path, const Program_Image& image);
+    bool close();
+    const std::string& error() const;
+
+    void append(const Trace_Record& record);
+
+    uint64_t record_count() const;
+    uint64_t stall_count() const;
+
+private:
+    void drain();
+    bool reserve(uint64_t records);
+    void unmap();
+
+    Trace_Ring ring;
+    uint64_t stalls{0UL};
+
+    std::thread writer;
+    std::atomic<bool> is_draining{false};
+
+    // Only touched by the writer thread while it runs
+    int descriptor{-1};
+    uint8_t* mapping{nullptr};
+    std::size_t mapping_size{0UL};
+    uint64_t written{0UL};
+    bool has_failed{false};
+
+    std::vector<std::pair<uint32_t, std::string>> symbols;
+    std::string status;
+};
+
+/**************************************************************************************************
+ * \brief A trace read back from disk
+ *************************************************************************************************/
+struct Trace_File
+{
+    std::vector<Trace_Record> records;
+    Function_Names function_names;
+    uint64_t stalls{0UL};
+};
+
+bool read_trace(const std::string& path, Trace_File& trace, std::string& error);
+
+/**********************************************************************************************//**
+ * \brief Adds a record to the ring, waiting for the writer if it's full. Kept in the header so the
+ *        execute loop can inline it.
+ * \param record The state of the instruction being dispatched
+ *************************************************************************************************/
+inline void Trace_Writer::append(const Trace_Record& record)
+{
+    while(!ring.try_push(record))
+    {
+        ++stalls;
+        std::this_thread::yield();
+    }
+}
+
+/**********************************************************************************************//**
+ * \brief Adds a record to the ring. Only called from the producer's thread.
+ * \param record The record to add
+ * \returns False if the ring is full
+ *************************************************************************************************/
+inline bool Trace_Ring::try_push(const Trace_Record& record)
+{
+    const auto position = head.load(std::memory_order_relaxed);
+    if((position - cached_tail) > mask)
+    {
+        cached_tail = tail.load(std::memory_order_acquire);
+        if((position - cached_tail) > mask)
+        {
+            return false;
+        }
+    }
+
+    records[position & mask] = record;
+    head.store(position + 1UL, std::memory_order_release);
+
+    return true;
+}
+
+#endif
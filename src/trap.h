@@ -0,0 +1,35 @@
+#ifndef TRAP_H
+#define TRAP_H
+
+#include <cstdint>
+
+enum class Fault_Code : uint8_t
+{
+    None = 0,
+    Bad_Address,     // Memory outside every segment, or a range straddling two of them
+    Divide_By_Zero,  // DIV or MOD with zero in ax
+    Stack_Overflow,  // The stack pointer would pass the bottom of the stack
+    Bad_Opcode,      // A byte which isn't an instruction
+    Replay_Mismatch, // A replayed program made a different system call, or got a different result
+    Exit             // Not a fault. The program called exit.
+};
+
+/**************************************************************************************************
+ * \brief Why the virtual machine stopped, and the state it was in at the time
+ *************************************************************************************************/
+struct Trap
+{
+    Fault_Code code{Fault_Code::None};
+
+    uint32_t program_counter{0U}; // Offset of the instruction which trapped
+    uint8_t opcode{0U};
+    uint32_t address{0U};         // The address which couldn't be used, for Bad_Address and Stack_Overflow
+    int32_t exit_status{0};       // Only set by Exit
+
+    // Registers as they were when the trap was raised
+    uint32_t ax{0U};
+    uint32_t base_pointer{0U};
+    uint32_t stack_pointer{0U};
+};
+
+#endif
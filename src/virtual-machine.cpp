@@ -1,104 +1,51 @@
 #include "virtual-machine.h"
-#include <iostream>
-#include <exception>
+#include "instructions.h"
+#include "memory-map.h"
+#include "perf-counters.h"
+#include "profiler.h"
+#include "syscall-log.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace
 {
-constexpr auto WORD_SIZE = 4UL;
-
-// Random numbers called out by the instructions
-constexpr auto STACK_SIZE = 256UL * 1024UL;
-constexpr auto STACK_START_ADDRESS = 0UL;
-constexpr auto STACK_END_ADDRESS = STACK_SIZE - 1UL;
-
-// Random numbers called out by the instructions
-constexpr auto DATA_SIZE = 256UL * 1024UL;
-constexpr auto DATA_START_ADDRESS = STACK_SIZE;
-constexpr auto DATA_END_ADDRESS = (STACK_SIZE + DATA_SIZE) - 1UL;
-
-// Random numbers called out by the instructions
-constexpr auto TEXT_SIZE = 256UL * 1024UL;
-constexpr auto TEXT_START_ADDRESS = (STACK_SIZE + DATA_SIZE);
-constexpr auto TEXT_END_ADDRESS = (STACK_SIZE + DATA_SIZE + TEXT_SIZE) - 1UL;
-
-enum Instructions
-{
-    LEA = 0x00,
-    IMM, // Replacement for the MOV instruction
-
-    // Function foundation instructions
-    PUSH,
-    JMP,
-    JZ,
-    JNZ,
-
-    // 
-    CALL,
-    ENT,
-    ADJ,
-    LEV,
-
-    // Replacements for the MOV instruction
-    LI,
-    LC,
-    SI,
-    SC,
-
-    // Arithmetic Operations
-    OR,
-    XOR,
-    AND,
-    EQ,
-    NE,
-    LT,
-    GT,
-    LE,
-    GE,
-    SHL,
-    SHR,
-    ADD,
-    SUB,
-    MUL,
-    DIV,
-    MOD,
-
-    // Shortcuts for system calls
-    OPEN,
-    READ,
-    CLOS,
-    PRTF,
-    MALC,
-    MSET,
-    MCMP,
-    EXIT 
-};
+using namespace Memory_Map;
 
 /**********************************************************************************************//**
- * \brief 
- * \param
- * \returns
+ * \brief Converts an address into an offset within the segment containing it
+ * \param address The address. Anything past the stack and data segments is treated as text, so
+ *        the caller is responsible for checking the offset is in range.
+ * \returns The offset from the start of the address's segment
  *************************************************************************************************/
 uint32_t truncate_address(const uint32_t address)
 {
-    if((address >= STACK_START_ADDRESS) && (address <= STACK_END_ADDRESS))
+    if(address <= STACK_END_ADDRESS)
     {
-        return address - STACK_START_ADDRESS;
+        return static_cast<uint32_t>(address - STACK_START_ADDRESS);
     }
-    else if((address >= DATA_START_ADDRESS) && (address <= DATA_END_ADDRESS))
+    else if(address <= DATA_END_ADDRESS)
     {
-        return address - DATA_START_ADDRESS;
-    }
-    else if((address >= TEXT_START_ADDRESS) && (address <= TEXT_END_ADDRESS))
-    {
-        return address - TEXT_START_ADDRESS;
-    }
-    else
-    {
-        // TODO: Make a custom exception for this
-        throw std::runtime_error("Attempt to use invalid address.");
+        return static_cast<uint32_t>(address - DATA_START_ADDRESS);
     }
+
+    return static_cast<uint32_t>(address - TEXT_START_ADDRESS);
 }
 
+/**********************************************************************************************//**
+ * \brief Observer for the execute loop when nothing is watching. Every call compiles away.
+ *************************************************************************************************/
+struct Null_Observer
+{
+    void begin(uint8_t) {}
+    void retire(uint32_t, uint8_t, uint32_t) {}
+};
+
 struct Word_Bytes
 {
     uint8_t a;
@@ -158,168 +105,293 @@ Virtual_Machine::Virtual_Machine() :
     program_counter(0),
     base_pointer(STACK_SIZE - 1),
     stack_pointer(STACK_SIZE - 1),
-    ax(0)
+    ax(0),
+    current_instruction(0),
+    output(STDOUT_FILENO)
 {
+    heap.reset(0U, DATA_SIZE);
+}
 
+/**********************************************************************************************//**
+ * \brief Destructor for the virtual machine. Closes any files the program left open.
+ *************************************************************************************************/
+Virtual_Machine::~Virtual_Machine()
+{
+    for(const auto descriptor : descriptors)
+    {
+        ::close(descriptor);
+    }
 }
 
 /**********************************************************************************************//**
- * \brief 
- * \param
- * \param
- * \returns
+ * \brief Reads a single byte
+ * \param address The address of the byte
+ * \returns The byte, or zero if the address is invalid
  *************************************************************************************************/
-uint8_t Virtual_Machine::read_byte_from_memory(const uint32_t address) const
+uint8_t Virtual_Machine::read_byte_from_memory(const uint32_t address)
 {
-    const auto truncated_address = truncate_address(address);
-    if((address >= STACK_START_ADDRESS) && (address <= STACK_END_ADDRESS))
+    const auto location = resolve_range(address, 1U);
+
+    return (location != nullptr) ? *location : 0U;
+}
+
+/**********************************************************************************************//**
+ * \brief Reads a big endian word
+ * \param address The address of the word's first byte
+ * \returns The word, or zero if any of its bytes are outside the segment
+ *************************************************************************************************/
+uint32_t Virtual_Machine::read_word_from_memory(const uint32_t address)
+{
+    const auto location = resolve_range(address, WORD_SIZE);
+    if(location == nullptr)
     {
-        return stack.at(truncated_address);
+        return 0U;
     }
-    else if((address >= DATA_START_ADDRESS) && (address <= DATA_END_ADDRESS))
+
+    return bytes_to_word(location[0], location[1], location[2], location[3]);
+}
+
+/**********************************************************************************************//**
+ * \brief Writes a single byte. Nothing is written if the address is invalid.
+ * \param address The address of the byte
+ * \param byte The value to write
+ * \returns The value written
+ *************************************************************************************************/
+uint8_t Virtual_Machine::write_byte_to_memory(const uint32_t address, const uint8_t byte)
+{
+    const auto location = resolve_range(address, 1U);
+    if(location != nullptr)
     {
-        return data.at(truncated_address);
+        *location = byte;
     }
-    else if((address >= TEXT_START_ADDRESS) && (address <= TEXT_END_ADDRESS))
+
+    return byte;
+}
+
+/**********************************************************************************************//**
+ * \brief Writes a big endian word. Nothing is written if any of its bytes are outside the segment.
+ * \param address The address of the word's first byte
+ * \param word The value to write
+ * \returns The value written
+ *************************************************************************************************/
+uint32_t Virtual_Machine::write_word_to_memory(const uint32_t address, const uint32_t word)
+{
+    const auto location = resolve_range(address, WORD_SIZE);
+    if(location != nullptr)
     {
-        return text.at(truncated_address);
+        const auto [a, b, c, d] = word_to_bytes(word);
+        location[0] = a;
+        location[1] = b;
+        location[2] = c;
+        location[3] = d;
     }
-    else
+
+    return word;
+}
+
+/**********************************************************************************************//**
+ * \brief Reads the argument of the current instruction out of the text region and advances the
+ *        program counter past it
+ * \returns The argument, or zero if it runs off the end of the text
+ *************************************************************************************************/
+uint32_t Virtual_Machine::fetch_word()
+{
+    if((static_cast<std::size_t>(program_counter) + WORD_SIZE) > text.size())
     {
-        // TODO: Make a custom exception for this
-        throw std::runtime_error("Attempt to use invalid address.");
+        raise(Fault_Code::Bad_Address, static_cast<uint32_t>(TEXT_START_ADDRESS + program_counter));
+        return 0U;
     }
+
+    const auto word = bytes_to_word(text[program_counter + 0UL],
+                                    text[program_counter + 1UL],
+                                    text[program_counter + 2UL],
+                                    text[program_counter + 3UL]);
+    program_counter += WORD_SIZE;
+
+    return word;
 }
 
 /**********************************************************************************************//**
- * \brief 
- * \param
- * \param
- * \returns
+ * \brief Checks that a range of addresses lies entirely within one segment, so bulk operations can
+ *        work on the segment's storage directly rather than a byte at a time
+ * \param address The first address in the range
+ * \param length The number of bytes in the range
+ * \returns The host location of the first byte, or null after raising a trap if the range is
+ *          invalid
  *************************************************************************************************/
-uint32_t Virtual_Machine::read_word_from_memory(const uint32_t address) const
+uint8_t* Virtual_Machine::resolve_range(const uint32_t address, const uint32_t length)
 {
     const auto truncated_address = truncate_address(address);
-    uint8_t a{0U};
-    uint8_t b{0U};
-    uint8_t c{0U};
-    uint8_t d{0U};
+    const auto end = static_cast<uint64_t>(truncated_address) + length;
 
-    // TODO: Candidate for refactor. a/b/c/d assignment happens three times.
-    //       Mild complication from the typing on text vs stack and data. That
-    //       will need to be resolved at some point anyway.
-    if((address >= STACK_START_ADDRESS) && (address <= STACK_END_ADDRESS))
-    {
-        a = stack.at(truncated_address + 0UL);
-        b = stack.at(truncated_address + 1UL);
-        c = stack.at(truncated_address + 2UL);
-        d = stack.at(truncated_address + 3UL);
-    }
-    else if((address >= DATA_START_ADDRESS) && (address <= DATA_END_ADDRESS))
+    if((address <= STACK_END_ADDRESS) && (end <= stack.size()))
     {
-        a = data.at(truncated_address + 0UL);
-        b = data.at(truncated_address + 1UL);
-        c = data.at(truncated_address + 2UL);
-        d = data.at(truncated_address + 3UL);
+        return stack.data() + truncated_address;
     }
-    else if((address >= TEXT_START_ADDRESS) && (address <= TEXT_END_ADDRESS))
+    else if((address >= DATA_START_ADDRESS) && (address <= DATA_END_ADDRESS) && (end <= data.size()))
     {
-        a = text.at(truncated_address + 0UL);
-        b = text.at(truncated_address + 1UL);
-        c = text.at(truncated_address + 2UL);
-        d = text.at(truncated_address + 3UL);
+        return reinterpret_cast<uint8_t*>(data.data()) + truncated_address;
     }
-    else
+    else if((address >= TEXT_START_ADDRESS) && (address <= TEXT_END_ADDRESS) && (end <= text.size()))
     {
-        // TODO: Make a custom exception for this
-        throw std::runtime_error("Attempt to use invalid address.");
+        return text.data() + truncated_address;
     }
 
-    return bytes_to_word(a, b, c, d);
+    raise(Fault_Code::Bad_Address, address);
+    return nullptr;
 }
 
 /**********************************************************************************************//**
- * \brief 
- * \param
- * \param
- * \returns
+ * \brief Finds a null terminated string in memory
+ * \param address The address of the first character
+ * \returns The characters before the terminator, or an empty view after raising a trap if the
+ *          terminator isn't in the same segment
  *************************************************************************************************/
-uint8_t Virtual_Machine::write_byte_to_memory(const uint32_t address, const uint8_t byte)
+std::string_view Virtual_Machine::resolve_string(const uint32_t address)
 {
-    const auto truncated_address = truncate_address(address);
-    if((address >= STACK_START_ADDRESS) && (address <= STACK_END_ADDRESS))
+    const auto start = resolve_range(address, 1U);
+    if(start == nullptr)
     {
-        stack.at(truncated_address) = byte;
-        return stack.at(truncated_address);
+        return {};
     }
-    else if((address >= DATA_START_ADDRESS) && (address <= DATA_END_ADDRESS))
+
+    std::size_t segment_size = text.size();
+    if(address <= STACK_END_ADDRESS)
     {
-        data.at(truncated_address) = byte;
-        return data.at(truncated_address);
+        segment_size = stack.size();
     }
-    else if((address >= TEXT_START_ADDRESS) && (address <= TEXT_END_ADDRESS))
+    else if(address <= DATA_END_ADDRESS)
     {
-        text.at(truncated_address) = byte;
-        return text.at(truncated_address);
+        segment_size = data.size();
     }
-    else
+
+    const auto end = static_cast<const uint8_t*>(std::memchr(start, 0, segment_size - truncate_address(address)));
+    if(end == nullptr)
     {
-        // TODO: Make a custom exception for this
-        throw std::runtime_error("Attempt to use invalid address.");
+        raise(Fault_Code::Bad_Address, address);
+        return {};
     }
+
+    return {reinterpret_cast<const char*>(start), static_cast<std::size_t>(end - start)};
 }
 
 /**********************************************************************************************//**
- * \brief 
- * \param
- * \param
- * \returns
+ * \brief Records a trap and stops execution once the current instruction finishes. Only the
+ *        first trap is kept, as anything after it is a consequence of the first.
+ * \param code Why execution is stopping
+ * \param address The address involved in the fault, if any
  *************************************************************************************************/
-uint32_t Virtual_Machine::write_word_to_memory(const uint32_t address, const uint32_t word)
+void Virtual_Machine::raise(const Fault_Code code, const uint32_t address)
 {
-    const auto truncated_address = truncate_address(address);
-    const auto [a, b, c, d] = word_to_bytes(word);
+    if(trap.code != Fault_Code::None)
+    {
+        return;
+    }
+
+    trap.code = code;
+    trap.program_counter = current_instruction;
+    trap.opcode = (current_instruction < text.size()) ? text[current_instruction] : 0U;
+    trap.address = address;
+    trap.ax = ax;
+    trap.base_pointer = base_pointer;
+    trap.stack_pointer = stack_pointer;
+}
 
-    if((address >= STACK_START_ADDRESS) && (address <= STACK_END_ADDRESS))
+/**********************************************************************************************//**
+ * \brief Moves the stack pointer down to make room, checking it doesn't pass the bottom of the
+ *        stack
+ * \param bytes The number of bytes needed
+ * \returns False if the stack overflowed, in which case the stack pointer is left alone
+ *************************************************************************************************/
+bool Virtual_Machine::reserve_stack(const uint64_t bytes)
+{
+    if(bytes > (stack_pointer - STACK_START_ADDRESS))
     {
-        stack.at(truncated_address + 0UL) = a;
-        stack.at(truncated_address + 1UL) = b;
-        stack.at(truncated_address + 2UL) = c;
-        stack.at(truncated_address + 3UL) = d;
+        raise(Fault_Code::Stack_Overflow, stack_pointer);
+        return false;
     }
-    else if((address >= DATA_START_ADDRESS) && (address <= DATA_END_ADDRESS))
+
+    stack_pointer -= static_cast<uint32_t>(bytes);
+    return true;
+}
+
+/**********************************************************************************************//**
+ * \brief Reports whether system call results come from a recorded log rather than the host
+ * \returns True while replaying
+ *************************************************************************************************/
+bool Virtual_Machine::is_replaying() const
+{
+    return (syscall_log != nullptr) && (syscall_log->mode() == Syscall_Log::Mode::Replay);
+}
+
+/**********************************************************************************************//**
+ * \brief Takes the result of a system call from the log being replayed, and places it in ax
+ * \param opcode The system call being made
+ * \param payload Receives the bytes the call placed in memory when it was recorded
+ * \returns False if the log doesn't hold this call next, in which case a trap has been raised
+ *************************************************************************************************/
+bool Virtual_Machine::replay_result(const uint8_t opcode, std::string_view& payload)
+{
+    uint32_t result{0U};
+    if(!syscall_log->replay(opcode, result, payload))
     {
-        data.at(truncated_address + 0UL) = a;
-        data.at(truncated_address + 1UL) = b;
-        data.at(truncated_address + 2UL) = c;
-        data.at(truncated_address + 3UL) = d;
+        raise(Fault_Code::Replay_Mismatch, 0U);
+        return false;
     }
-    else if((address >= TEXT_START_ADDRESS) && (address <= TEXT_END_ADDRESS))
+
+    ax = result;
+    return true;
+}
+
+/**********************************************************************************************//**
+ * \brief Logs the result of a system call. When recording, it's appended to the log. When
+ *        replaying, it's checked against the log, since a call the virtual machine works out
+ *        itself must give the same result as it did in the recorded run. MALC only has to fail
+ *        in the same places unless the log compares addresses too.
+ * \param opcode The system call
+ * \param result Its result
+ * \param payload Bytes the call placed in memory
+ *************************************************************************************************/
+void Virtual_Machine::log_result(const uint8_t opcode, const uint32_t result, const std::string_view payload)
+{
+    if(syscall_log == nullptr)
     {
-        text.at(truncated_address + 0UL) = a;
-        text.at(truncated_address + 1UL) = b;
-        text.at(truncated_address + 2UL) = c;
-        text.at(truncated_address + 3UL) = d;
+        return;
     }
-    else
+
+    if(syscall_log->mode() == Syscall_Log::Mode::Record)
     {
-        // TODO: Make a custom exception for this
-        throw std::runtime_error("Attempt to use invalid address.");
+        syscall_log->record(opcode, result, payload);
+        return;
     }
 
-    return word;
+    uint32_t recorded{0U};
+    std::string_view recorded_payload;
+    if(!syscall_log->replay(opcode, recorded, recorded_payload))
+    {
+        raise(Fault_Code::Replay_Mismatch, 0U);
+        return;
+    }
+
+    const auto is_same = ((opcode == Instructions::MALC) && !syscall_log->compares_addresses())
+        ? ((recorded == 0U) == (result == 0U))
+        : (recorded == result);
+    if(!is_same)
+    {
+        raise(Fault_Code::Replay_Mismatch, 0U);
+    }
 }
 
 /**********************************************************************************************//**
  * \brief Loads the program into the text region of the virtual machine's memory
- * \param
+ * \param program The program's text
+ * \returns False if the program is too large for the text region. Nothing is loaded in that case.
  *************************************************************************************************/
-void Virtual_Machine::load(const std::vector<uint8_t>& program)
+bool Virtual_Machine::load(const std::vector<uint8_t>& program)
 {
     if(program.size() > text.size())
     {
-        // Consider throwing a new exception here
-        return;
+        return false;
     }
 
     // I don't like this, but I haven't found a great way to keep the destination size constant
@@ -329,31 +401,151 @@ void Virtual_Machine::load(const std::vector<uint8_t>& program)
         text.at(i) = entry;
         ++i;
     }
+
+    return true;
 }
 
 /**********************************************************************************************//**
- * \brief Using the current state of the virtual machine, execute until unable to continue, or if
- *        instructed to stop.
+ * \brief Loads a linked program image. The text and data segments are copied into place, the BSS
+ *        following the data is cleared, and the program counter is pointed at the image's entry
+ *        point. The registers are reset, so a virtual machine can run one program after another.
+ * \param image The output of the linker
+ * \returns False if the image doesn't fit in the virtual machine's memory. Nothing is loaded in
+ *          that case.
  *************************************************************************************************/
-void Virtual_Machine::execute()
+bool Virtual_Machine::load(const Program_Image& image)
 {
-    uint8_t op{};
-    while(true)
+    if((image.text.size() > text.size()) || ((image.data.size() + image.bss_size) > data.size()))
     {
-        op = text.at(program_counter);
-        program_counter += 1;
+        return false;
+    }
+
+    load(image.text);
+    const auto bss_start = std::copy(image.data.begin(), image.data.end(), data.begin());
+    std::fill(bss_start, bss_start + image.bss_size, 0U);
+
+    heap.reset(static_cast<uint32_t>(image.data.size() + image.bss_size), DATA_SIZE);
+
+    program_counter = image.entry_point;
+    base_pointer = STACK_SIZE - 1;
+    stack_pointer = STACK_SIZE - 1;
+    ax = 0;
+
+    return true;
+}
 
-        try
+/**********************************************************************************************//**
+ * \brief Using the current state of the virtual machine, execute until a trap is raised. Faults,
+ *        and the program calling exit, both raise traps, and the loop checks for one after every
+ *        instruction.
+ * \returns The trap which stopped execution
+ *************************************************************************************************/
+Trap Virtual_Machine::execute()
+{
+    Null_Observer observer;
+    return run(observer);
+}
+
+/**********************************************************************************************//**
+ * \brief Executes exactly as execute() does, reporting every retired instruction to a profiler
+ * \param profiler Collects the profile
+ * \returns The trap which stopped execution
+ *************************************************************************************************/
+Trap Virtual_Machine::execute(Profiler& profiler)
+{
+    return run(profiler);
+}
+
+/**********************************************************************************************//**
+ * \brief Executes exactly as execute() does, telling the host's performance counters which opcode
+ *        is running. Sampling must already have been started.
+ * \param counters Attributes samples to opcodes
+ * \returns The trap which stopped execution
+ *************************************************************************************************/
+Trap Virtual_Machine::execute(Perf_Counters& counters)
+{
+    return run(counters);
+}
+
+/**********************************************************************************************//**
+ * \brief Starts or stops tracing. Safe to call while the program is running, in which case the
+ *        change takes effect from the next instruction.
+ * \param writer Receives a record of every instruction dispatched, or nullptr to stop tracing.
+ *        The caller must keep it open until tracing has stopped and execute() has returned.
+ *************************************************************************************************/
+void Virtual_Machine::set_trace(Trace_Writer* const writer)
+{
+    tracer.store(writer, std::memory_order_release);
+}
+
+/**********************************************************************************************//**
+ * \brief Starts recording system calls into a log, or replaying them from one. Output is
+ *        discarded while replaying, so a replayed run costs only the interpreter's own time.
+ * \param log The log, whose mode decides which, or nullptr to use the host again
+ *************************************************************************************************/
+void Virtual_Machine::set_syscall_log(Syscall_Log* const log)
+{
+    syscall_log = log;
+    output.redirect(is_replaying() ? -1 : STDOUT_FILENO);
+}
+
+/**********************************************************************************************//**
+ * \brief The execute loop, shared by every kind of observer
+ * \param observer Told about each instruction as it's dispatched and after it retires
+ * \returns The trap which stopped execution
+ *************************************************************************************************/
+template<typename Observer>
+Trap Virtual_Machine::run(Observer& observer)
+{
+    trap = Trap{};
+
+    while(trap.code == Fault_Code::None)
+    {
+        current_instruction = program_counter;
+        if(program_counter >= text.size())
         {
-            demux_instruction(op);
+            raise(Fault_Code::Bad_Address, static_cast<uint32_t>(TEXT_START_ADDRESS + program_counter));
+            break;
         }
-        catch(...)
+
+        const auto op = text[program_counter];
+
+        // The only cost of tracing when it's off
+        const auto writer = tracer.load(std::memory_order_acquire);
+        if(writer != nullptr)
         {
-            std::cout << "Fatal error. Shutting down" << std::endl;
-            break;
+            writer->append({(program_counter << 8U) | op, ax, stack_pointer, base_pointer});
         }
-        
+
+        program_counter += 1;
+
+        observer.begin(op);
+        demux_instruction(op);
+
+        observer.retire(current_instruction, op, program_counter);
     }
+
+    output.flush();
+
+    return trap;
+}
+
+/**********************************************************************************************//**
+ * \brief Reports how the running program has used the heap
+ * \returns The heap's statistics
+ *************************************************************************************************/
+Heap_Statistics Virtual_Machine::heap_statistics() const
+{
+    return heap.statistics();
+}
+
+/**********************************************************************************************//**
+ * \brief Exposes the data region, so the effect a finished run had on memory can be inspected
+ * \returns The data, BSS and heap, as the program left them
+ *************************************************************************************************/
+const std::vector<char>& Virtual_Machine::data_segment() const
+{
+    return data;
 }
 
 /**********************************************************************************************//**
@@ -395,19 +587,30 @@ void Virtual_Machine::demux_instruction(const uint8_t operation)
         case Instructions::MUL:  handle_MUL();  break;
         case Instructions::DIV:  handle_DIV();  break;
         case Instructions::MOD:  handle_MOD();  break;
-
-        default: break;
+        case Instructions::OPEN: handle_OPEN(); break;
+        case Instructions::READ: handle_READ(); break;
+        case Instructions::CLOS: handle_CLOS(); break;
+        case Instructions::PRTF: handle_PRTF(); break;
+        case Instructions::MALC: handle_MALC(); break;
+        case Instructions::FREE: handle_FREE(); break;
+        case Instructions::MSET: handle_MSET(); break;
+        case Instructions::MCMP: handle_MCMP(); break;
+        case Instructions::MCPY: handle_MCPY(); break;
+        case Instructions::EXIT: handle_EXIT(); break;
+
+        default:
+            raise(Fault_Code::Bad_Opcode, 0U);
+            break;
     }
 }
 
 /**********************************************************************************************//**
- * \brief Load the current value at the program counter into the ax register. Increment the
- *        program counter
+ * \brief Load the argument at the program counter into the ax register. Advance the program
+ *        counter past it
  *************************************************************************************************/
 void Virtual_Machine::handle_IMM()
 {
-    ax = text.at(program_counter);
-    ++program_counter;
+    ax = fetch_word();
 }
 
 /**********************************************************************************************//**
@@ -429,41 +632,48 @@ void Virtual_Machine::handle_LI()
 }
 
 /**********************************************************************************************//**
- * \brief Treating the stack pointer as a memory address, store the byte in ax at the address
- *        in the stack pointer, while maintaining the value in ax
+ * \brief Pop a memory address off the stack and store the byte in ax at that address, while
+ *        maintaining the value in ax
  *************************************************************************************************/
 void Virtual_Machine::handle_SC()
 {
-    ax = write_byte_to_memory(stack_pointer, ax);
+    const auto address = read_word_from_memory(stack_pointer);
+    stack_pointer += WORD_SIZE;
+
+    ax = write_byte_to_memory(address, ax);
 }
 
 /**********************************************************************************************//**
- * \brief Treating the stack pointer as a memory address, store the 32 bit integer in ax in that
- *        address
+ * \brief Pop a memory address off the stack and store the 32 bit integer in ax at that address
  *************************************************************************************************/
 void Virtual_Machine::handle_SI()
 {
-    ax = write_word_to_memory(stack_pointer, ax);
+    const auto address = read_word_from_memory(stack_pointer);
+    stack_pointer += WORD_SIZE;
+
+    ax = write_word_to_memory(address, ax);
 }
 
 /**********************************************************************************************//**
  * \brief Place the ax register onto the stack, and advance the stack pointer
- * \note One is added to the word size because the byte at the stack pointer address has not been
- *       written to yet.
+ * \note The stack pointer starts one byte past the last full word, so a push always lands on the
+ *       same word boundaries the binary operations pop from.
  *************************************************************************************************/
 void Virtual_Machine::handle_PUSH()
 {
-    stack_pointer -= (WORD_SIZE + 1UL);
-    write_word_to_memory(stack_pointer, ax);
-    
+    if(reserve_stack(WORD_SIZE))
+    {
+        write_word_to_memory(stack_pointer, ax);
+    }
 }
 
 /**********************************************************************************************//**
- * \brief Reads the next word from memory and replaces the program counter with that address
+ * \brief Reads the argument from the text region and replaces the program counter with that
+ *        address
  *************************************************************************************************/
 void Virtual_Machine::handle_JMP()
 {
-    program_counter = read_word_from_memory(program_counter);
+    program_counter = fetch_word();
 }
 
 /**********************************************************************************************//**
@@ -478,7 +688,7 @@ void Virtual_Machine::handle_JZ()
     }
     else
     {
-        ++program_counter;
+        program_counter += WORD_SIZE;
     }
 }
 
@@ -490,48 +700,66 @@ void Virtual_Machine::handle_JNZ()
 {
     if(ax != 0)
     {
-        ++program_counter;
+        handle_JMP();
     }
     else
     {
-        handle_JMP();
+        program_counter += WORD_SIZE;
     }
 }
 
 /**********************************************************************************************//**
- * \brief Performs the Call operation. Stores the current program counter on the stack and then 
- *        performs a JMP
+ * \brief Performs the Call operation. Stores the address of the following instruction on the
+ *        stack and then performs a JMP
  *************************************************************************************************/
 void Virtual_Machine::handle_CALL()
 {
-    stack_pointer -= (WORD_SIZE + 1UL);
+    const auto target = fetch_word();
+
+    if(!reserve_stack(WORD_SIZE))
+    {
+        return;
+    }
+
     write_word_to_memory(stack_pointer, program_counter);
 
-    handle_JMP();
+    program_counter = target;
 }
 
 /**********************************************************************************************//**
  * \brief Performs the Enter operation. Creates a new frame on the stack. The stack frame consists
- *        of the stack pointer and N words, where N is the number of arguments for the function.
+ *        of the base pointer and N words, where N is the number of locals for the function.
  *************************************************************************************************/
 void Virtual_Machine::handle_ENT()
 {
-    stack_pointer -= (WORD_SIZE + 1UL);
+    const auto local_count = fetch_word();
+
+    if(!reserve_stack(WORD_SIZE))
+    {
+        return;
+    }
+
     write_word_to_memory(stack_pointer, base_pointer);
 
     base_pointer = stack_pointer;
 
-    stack_pointer -= read_word_from_memory(program_counter);
-    ++program_counter;
+    reserve_stack(static_cast<uint64_t>(local_count) * WORD_SIZE);
 }
 
 /**********************************************************************************************//**
- * \brief Performs the Adjust operation. This operation removes arguments from the stack frame.
+ * \brief Performs the Adjust operation. This operation removes N argument words from the stack.
+ *        A negative N reserves words instead, which is checked for overflow.
  *************************************************************************************************/
 void Virtual_Machine::handle_ADJ()
 {
-    stack_pointer = stack_pointer + read_word_from_memory(program_counter);
-    ++program_counter;
+    const auto count = static_cast<int32_t>(fetch_word());
+    if(count < 0)
+    {
+        reserve_stack(static_cast<uint64_t>(-static_cast<int64_t>(count)) * WORD_SIZE);
+        return;
+    }
+
+    stack_pointer += static_cast<uint32_t>(count) * WORD_SIZE;
 }
 
 /**********************************************************************************************//**
@@ -550,14 +778,16 @@ void Virtual_Machine::handle_LEV()
 }
 
 /**********************************************************************************************//**
- * \brief Operation meant to retrieve a function's arguments from within the called function.
+ * \brief Load the address of a word in the current frame into ax. Positive offsets reach the
+ *        function's arguments, negative offsets reach its locals. LI and SI then access the value.
  *************************************************************************************************/
 void Virtual_Machine::handle_LEA()
 {
-    uint8_t offset = read_byte_from_memory(program_counter);
-    ++program_counter;
-    
-    ax = read_word_from_memory(base_pointer + (offset * WORD_SIZE));
+    // The offset is signed, but wrapping unsigned arithmetic reaches the same address without
+    // overflowing. Addresses outside the frame are caught when they're used.
+    const auto offset = fetch_word();
+
+    ax = base_pointer + (offset * static_cast<uint32_t>(WORD_SIZE));
 }
 
 
@@ -723,6 +953,12 @@ void Virtual_Machine::handle_MUL()
  *************************************************************************************************/
 void Virtual_Machine::handle_DIV()
 {
+    if(ax == 0U)
+    {
+        raise(Fault_Code::Divide_By_Zero, 0U);
+        return;
+    }
+
     uint32_t left_side = read_word_from_memory(stack_pointer);
     stack_pointer += WORD_SIZE;
 
@@ -735,9 +971,303 @@ void Virtual_Machine::handle_DIV()
  *************************************************************************************************/
 void Virtual_Machine::handle_MOD()
 {
+    if(ax == 0U)
+    {
+        raise(Fault_Code::Divide_By_Zero, 0U);
+        return;
+    }
+
     uint32_t left_side = read_word_from_memory(stack_pointer);
     stack_pointer += WORD_SIZE;
 
     ax =  (left_side % ax);
 }
 
+
+/**********************************************************************************************//**
+ * \brief Opens a file for reading. The arguments are the path and the flags, with the flags on top
+ *        of the stack. Only reading is supported, so the flags are ignored. ax receives the file
+ *        descriptor, or -1 on failure.
+ *************************************************************************************************/
+void Virtual_Machine::handle_OPEN()
+{
+    const auto path = resolve_string(read_word_from_memory(stack_pointer + (1UL * WORD_SIZE)));
+    if(trap.code != Fault_Code::None)
+    {
+        return;
+    }
+
+    std::string_view payload;
+    if(is_replaying())
+    {
+        // The recorded descriptor isn't kept, as the replayed READ and CLOS calls never use it
+        replay_result(Instructions::OPEN, payload);
+        return;
+    }
+
+    const auto descriptor = ::open(path.data(), O_RDONLY | O_CLOEXEC);
+    if(descriptor >= 0)
+    {
+        descriptors.insert(descriptor);
+    }
+
+    ax = static_cast<uint32_t>(descriptor);
+    log_result(Instructions::OPEN, ax);
+}
+
+/**********************************************************************************************//**
+ * \brief Reads from a file straight into memory. The arguments are the file descriptor, the
+ *        destination and the byte count, with the count on top of the stack. ax receives the
+ *        number of bytes read, or -1 on failure.
+ *************************************************************************************************/
+void Virtual_Machine::handle_READ()
+{
+    const auto count = read_word_from_memory(stack_pointer);
+    const auto destination = read_word_from_memory(stack_pointer + (1UL * WORD_SIZE));
+    const auto descriptor = static_cast<int>(read_word_from_memory(stack_pointer + (2UL * WORD_SIZE)));
+
+    // The whole destination is checked first, so a bad buffer faults the same way when replaying
+    const auto buffer = resolve_range(destination, count);
+    if(buffer == nullptr)
+    {
+        return;
+    }
+
+    std::string_view payload;
+    if(is_replaying())
+    {
+        if(!replay_result(Instructions::READ, payload))
+        {
+            return;
+        }
+
+        if(payload.size() > count)
+        {
+            raise(Fault_Code::Replay_Mismatch, 0U);
+            return;
+        }
+
+        std::copy(payload.begin(), payload.end(), buffer);
+        return;
+    }
+
+    if((descriptor != STDIN_FILENO) && (descriptors.count(descriptor) == 0UL))
+    {
+        ax = static_cast<uint32_t>(-1);
+        log_result(Instructions::READ, ax);
+        return;
+    }
+
+    // Anything prompting for this input needs to be visible first
+    if(descriptor == STDIN_FILENO)
+    {
+        output.flush();
+    }
+
+    ssize_t result{0};
+    do
+    {
+        result = ::read(descriptor, buffer, count);
+    } while((result < 0) && (errno == EINTR));
+
+    ax = static_cast<uint32_t>(result);
+
+    if(result > 0)
+    {
+        payload = std::string_view(reinterpret_cast<const char*>(buffer), static_cast<std::size_t>(result));
+    }
+    log_result(Instructions::READ, ax, payload);
+}
+
+/**********************************************************************************************//**
+ * \brief Closes a file opened by OPEN. The file descriptor is on top of the stack. ax receives 0,
+ *        or -1 on failure.
+ *************************************************************************************************/
+void Virtual_Machine::handle_CLOS()
+{
+    const auto descriptor = static_cast<int>(read_word_from_memory(stack_pointer));
+
+    std::string_view payload;
+    if(is_replaying())
+    {
+        replay_result(Instructions::CLOS, payload);
+        return;
+    }
+
+    if(descriptors.erase(descriptor) == 0UL)
+    {
+        ax = static_cast<uint32_t>(-1);
+    }
+    else
+    {
+        ax = static_cast<uint32_t>(::close(descriptor));
+    }
+
+    log_result(Instructions::CLOS, ax);
+}
+
+/**********************************************************************************************//**
+ * \brief Formatted print. The format string is the first argument, followed by the values. As the
+ *        number of arguments varies, it is taken from the ADJ which removes them after the call.
+ *        ax receives the number of characters printed.
+ *************************************************************************************************/
+void Virtual_Machine::handle_PRTF()
+{
+    uint32_t argument_count{0U};
+    if(((static_cast<std::size_t>(program_counter) + instruction_size(Instructions::ADJ)) <= text.size()) &&
+       (text[program_counter] == Instructions::ADJ))
+    {
+        argument_count = bytes_to_word(text[program_counter + 1UL],
+                                       text[program_counter + 2UL],
+                                       text[program_counter + 3UL],
+                                       text[program_counter + 4UL]);
+    }
+
+    if(argument_count == 0U)
+    {
+        ax = 0U;
+        log_result(Instructions::PRTF, ax);
+        return;
+    }
+
+    // The first argument pushed is the furthest from the top of the stack
+    const auto format = resolve_string(read_word_from_memory(stack_pointer + ((argument_count - 1U) * WORD_SIZE)));
+    if(trap.code != Fault_Code::None)
+    {
+        return;
+    }
+
+    const auto argument = [this, argument_count](const std::size_t index)
+    {
+        if((index + 1UL) >= argument_count)
+        {
+            return 0U;
+        }
+
+        return read_word_from_memory(stack_pointer + ((argument_count - 2UL - index) * WORD_SIZE));
+    };
+
+    const auto string = [this](const uint32_t address)
+    {
+        return resolve_string(address);
+    };
+
+    ax = output.print(format, argument, string);
+    log_result(Instructions::PRTF, ax);
+}
+
+/**********************************************************************************************//**
+ * \brief Allocates a block from the heap. The requested size is the argument on top of the stack,
+ *        which the caller removes with ADJ. ax receives the address of the block, or zero if the
+ *        heap is exhausted.
+ *************************************************************************************************/
+void Virtual_Machine::handle_MALC()
+{
+    const auto size = read_word_from_memory(stack_pointer);
+
+    uint32_t offset{0U};
+    ax = heap.allocate(size, offset) ? static_cast<uint32_t>(DATA_START_ADDRESS + offset) : 0U;
+    log_result(Instructions::MALC, ax);
+}
+
+/**********************************************************************************************//**
+ * \brief Returns the block whose address is on top of the stack to the heap. Freeing a null
+ *        pointer does nothing.
+ *************************************************************************************************/
+void Virtual_Machine::handle_FREE()
+{
+    const auto address = read_word_from_memory(stack_pointer);
+    if(address == 0U)
+    {
+        return;
+    }
+
+    if((address < DATA_START_ADDRESS) || (address > DATA_END_ADDRESS) ||
+       !heap.release(static_cast<uint32_t>(address - DATA_START_ADDRESS)))
+    {
+        raise(Fault_Code::Bad_Address, address);
+    }
+}
+
+/**********************************************************************************************//**
+ * \brief Fills a block of memory with a byte. The arguments are the destination, the value and the
+ *        length, with the length on top of the stack. ax receives the destination.
+ *************************************************************************************************/
+void Virtual_Machine::handle_MSET()
+{
+    const auto length = read_word_from_memory(stack_pointer);
+    const auto value = read_word_from_memory(stack_pointer + (1UL * WORD_SIZE));
+    const auto destination = read_word_from_memory(stack_pointer + (2UL * WORD_SIZE));
+
+    const auto bytes = resolve_range(destination, length);
+    if(bytes != nullptr)
+    {
+        std::memset(bytes, static_cast<uint8_t>(value), length);
+    }
+
+    ax = destination;
+}
+
+/**********************************************************************************************//**
+ * \brief Compares two blocks of memory. The arguments are the two blocks and the length, with the
+ *        length on top of the stack. ax receives -1, 0 or 1 as the first block sorts before, the
+ *        same as, or after the second.
+ *************************************************************************************************/
+void Virtual_Machine::handle_MCMP()
+{
+    const auto length = read_word_from_memory(stack_pointer);
+    const auto second = read_word_from_memory(stack_pointer + (1UL * WORD_SIZE));
+    const auto first = read_word_from_memory(stack_pointer + (2UL * WORD_SIZE));
+
+    const auto first_bytes = resolve_range(first, length);
+    const auto second_bytes = resolve_range(second, length);
+    if((first_bytes == nullptr) || (second_bytes == nullptr))
+    {
+        return;
+    }
+
+    const auto result = std::memcmp(first_bytes, second_bytes, length);
+
+    ax = static_cast<uint32_t>((result > 0) - (result < 0));
+}
+
+/**********************************************************************************************//**
+ * \brief Copies a block of memory. The arguments are the destination, the source and the length,
+ *        with the length on top of the stack. The blocks may overlap. ax receives the destination.
+ *************************************************************************************************/
+void Virtual_Machine::handle_MCPY()
+{
+    const auto length = read_word_from_memory(stack_pointer);
+    const auto source = read_word_from_memory(stack_pointer + (1UL * WORD_SIZE));
+    const auto destination = read_word_from_memory(stack_pointer + (2UL * WORD_SIZE));
+
+    const auto destination_bytes = resolve_range(destination, length);
+    const auto source_bytes = resolve_range(source, length);
+    if((destination_bytes != nullptr) && (source_bytes != nullptr))
+    {
+        std::memmove(destination_bytes, source_bytes, length);
+    }
+
+    ax = destination;
+}
+
+/**********************************************************************************************//**
+ * \brief Ends the program. The exit status is on top of the stack.
+ *************************************************************************************************/
+void Virtual_Machine::handle_EXIT()
+{
+    const auto status = static_cast<int32_t>(read_word_from_memory(stack_pointer));
+    if(trap.code != Fault_Code::None)
+    {
+        return;
+    }
+
+    log_result(Instructions::EXIT, static_cast<uint32_t>(status));
+    if(trap.code != Fault_Code::None)
+    {
+        return;
+    }
+
+    raise(Fault_Code::Exit, 0U);
+    trap.exit_status = status;
+}
@@ -1,26 +1,62 @@
 #ifndef VIRTUAL_MACHINE_H
 #define VIRTUAL_MACHINE_H
 
+#include "heap.h"
+#include "output-buffer.h"
+#include "program-image.h"
+#include "trap.h"
+
+#include <atomic>
 #include <cstdint>
+#include <string_view>
+#include <unordered_set>
 #include <vector>
 
+class Perf_Counters;
+class Profiler;
+class Syscall_Log;
+class Trace_Writer;
+
 class Virtual_Machine
 {
 public:
     Virtual_Machine();
 
-    virtual ~Virtual_Machine() = default;
+    virtual ~Virtual_Machine();
+
+    bool load(const std::vector<uint8_t>& program);
+    bool load(const Program_Image& image);
+    Trap execute();
+    Trap execute(Profiler& profiler);
+    Trap execute(Perf_Counters& counters);
+
+    void set_trace(Trace_Writer* writer);
+    void set_syscall_log(Syscall_Log* log);
 
-    void load(const std::vector<uint8_t>& program);
-    void execute();
+    Heap_Statistics heap_statistics() const;
+    const std::vector<char>& data_segment() const;
 
 private:
-    uint8_t  read_byte_from_memory(uint32_t address) const;
-    uint32_t read_word_from_memory(uint32_t address) const;
+    template<typename Observer>
+    Trap run(Observer& observer);
+
+    uint8_t  read_byte_from_memory(uint32_t address);
+    uint32_t read_word_from_memory(uint32_t address);
 
     uint8_t  write_byte_to_memory(uint32_t address, uint8_t byte);
     uint32_t write_word_to_memory(uint32_t address, uint32_t word);
 
+    uint32_t fetch_word();
+    uint8_t* resolve_range(uint32_t address, uint32_t length);
+    std::string_view resolve_string(uint32_t address);
+
+    void raise(Fault_Code code, uint32_t address);
+    bool reserve_stack(uint64_t bytes);
+
+    bool is_replaying() const;
+    bool replay_result(uint8_t opcode, std::string_view& payload);
+    void log_result(uint8_t opcode, uint32_t result, std::string_view payload = {});
+
     void demux_instruction(const uint8_t operation);
 
     void handle_IMM();
@@ -56,6 +92,18 @@ private:
     void handle_DIV();
     void handle_MOD();
 
+    // System calls
+    void handle_OPEN();
+    void handle_READ();
+    void handle_CLOS();
+    void handle_PRTF();
+    void handle_MALC();
+    void handle_FREE();
+    void handle_MSET();
+    void handle_MCMP();
+    void handle_MCPY();
+    void handle_EXIT();
+
 private:
     // All of these should be std::arrays, but that would require exposing the
     // memory sizes. 
@@ -67,6 +115,27 @@ private:
     uint32_t base_pointer;
     uint32_t stack_pointer;
     uint32_t ax;
+
+    // Offset of the instruction being executed, and the trap which stops execution
+    uint32_t current_instruction;
+    Trap trap;
+
+    // Occupies the data segment between the end of the program's BSS and the end of the segment
+    Heap heap;
+
+    // Output is gathered here rather than written a line at a time
+    Output_Buffer output;
+
+    // Files opened by the program. READ and CLOS refuse any other descriptor, apart from READ on
+    // standard input, so the program can't interfere with the interpreter's own files.
+    std::unordered_set<int> descriptors;
+
+    // Receives a record of every instruction dispatched while set. May be changed from any thread,
+    // including while the program runs.
+    std::atomic<Trace_Writer*> tracer{nullptr};
+
+    // Records the result of every system call, or supplies them when replaying a recorded run
+    Syscall_Log* syscall_log{nullptr};
 };
 
 #endif
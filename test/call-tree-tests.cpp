@@ -0,0 +1,47 @@
+#include "catch2/catch.hpp"
+#include "../src/call-tree.h"
+#include "../src/memory-map.h"
+
+TEST_CASE("Call trees keep one node per call stack and total each one bottom up")
+{
+    Call_Tree calls(0U);
+    calls.retire();
+    calls.enter(10U);
+    calls.retire();
+    calls.enter(20U);
+    calls.retire();
+    calls.retire();
+    calls.leave();
+    calls.enter(20U);
+    calls.retire();
+    calls.leave();
+    calls.leave();
+
+    // Leaving the outermost function keeps counting in it
+    calls.leave();
+    calls.retire();
+
+    const auto& nodes = calls.nodes();
+    REQUIRE(nodes.size() == 3UL);
+    REQUIRE(nodes[0].parent == Call_Tree::NO_PARENT);
+    REQUIRE(nodes[0].instructions == 2UL);
+    REQUIRE(nodes[1].parent == 0U);
+    REQUIRE(nodes[2].parent == 1U);
+    REQUIRE(nodes[2].calls == 2UL);
+    REQUIRE(nodes[2].instructions == 3UL);
+    REQUIRE(calls.totals() == std::vector<uint64_t>{6UL, 4UL, 3UL});
+
+    const Function_Names names = {{0U, "_start"}, {10U, "main"}};
+    REQUIRE(calls.stack_name(2U, names) == "_start;main;0x00000014");
+}
+
+TEST_CASE("Functions are named by their lowest text symbol")
+{
+    Program_Image image;
+    image.symbols = {{"main", 8U}, {"alias", 8U}, {"table", Memory_Map::DATA_START_ADDRESS}};
+
+    const auto names = function_names(image);
+    REQUIRE(names.size() == 1UL);
+    REQUIRE(function_name(names, 8U) == "alias");
+    REQUIRE(function_name(names, 16U) == "0x00000010");
+}
@@ -0,0 +1,125 @@
+#include "catch2/catch.hpp"
+#include "../src/data-layout.h"
+#include "../src/linker.h"
+#include "../src/memory-map.h"
+
+#include <algorithm>
+
+namespace
+{
+
+const Symbol& find_symbol(const Object_File& object, const std::string& name)
+{
+    return *std::find_if(object.symbols.begin(), object.symbols.end(),
+                         [&name](const Symbol& symbol) { return symbol.name == name; });
+}
+
+};
+
+TEST_CASE("Identical literals and tables are stored once")
+{
+    Data_Layout layout;
+    const auto first = layout.add_string("hello");
+    const auto second = layout.add_string("hello");
+    const auto table = layout.add_constant({1U, 2U, 3U, 4U}, 4U);
+    const auto same_table = layout.add_constant({1U, 2U, 3U, 4U}, 4U);
+
+    REQUIRE(first == second);
+    REQUIRE(table == same_table);
+    REQUIRE(first != table);
+
+    Object_File object;
+    layout.emit(object);
+
+    REQUIRE(object.data.size() == 10UL);
+    REQUIRE(object.symbols.size() == 2UL);
+    REQUIRE(find_symbol(object, table).offset == 0U);
+    REQUIRE(find_symbol(object, first).offset == 4U);
+    REQUIRE(find_symbol(object, first).binding == Binding::Local);
+}
+
+TEST_CASE("Strings share the storage of longer strings which end with them")
+{
+    Data_Layout layout;
+    const auto tail = layout.add_string("ing");
+    const auto word = layout.add_string("string");
+    const auto other = layout.add_string("thing");
+    const auto empty = layout.add_string("");
+
+    Object_File object;
+    layout.emit(object);
+
+    // "string" and "thing" are both kept, everything else lives inside one of them
+    REQUIRE(object.data.size() == 13UL);
+
+    const auto word_offset = find_symbol(object, word).offset;
+    const auto tail_offset = find_symbol(object, tail).offset;
+    const auto other_offset = find_symbol(object, other).offset;
+    const auto empty_offset = find_symbol(object, empty).offset;
+
+    REQUIRE(std::string(reinterpret_cast<const char*>(&object.data[word_offset])) == "string");
+    REQUIRE(std::string(reinterpret_cast<const char*>(&object.data[other_offset])) == "thing");
+    REQUIRE(std::string(reinterpret_cast<const char*>(&object.data[tail_offset])) == "ing");
+    REQUIRE(object.data[empty_offset] == 0U);
+}
+
+TEST_CASE("Globals are packed hot first, then by alignment, with zeroed globals in the BSS")
+{
+    Data_Layout layout;
+    layout.add_global("flag", Binding::Global, 1U, 1U, false, {1U});
+    layout.add_global("table", Binding::Global, 8U, 4U, false, {0U, 0U, 0U, 7U});
+    layout.add_global("counter", Binding::Local, 4U, 4U, true);
+    layout.add_global("buffer", Binding::Global, 1024U, 4U, false);
+    layout.add_global("byte", Binding::Global, 1U, 1U, false, {0U});
+    layout.add_global("mode", Binding::Global, 1U, 1U, true, {2U});
+
+    Object_File object;
+    layout.emit(object);
+
+    REQUIRE(find_symbol(object, "counter").offset == 0U);
+    REQUIRE(find_symbol(object, "mode").offset == 4U);
+    REQUIRE(find_symbol(object, "table").offset == 8U);
+    REQUIRE(find_symbol(object, "flag").offset == 16U);
+    REQUIRE(object.data.size() == 17UL);
+    REQUIRE(object.data[4] == 2U);
+    REQUIRE(object.data[11] == 7U);
+
+    REQUIRE(find_symbol(object, "buffer").segment == Segment::Bss);
+    REQUIRE(find_symbol(object, "buffer").offset == 0U);
+    REQUIRE(find_symbol(object, "byte").segment == Segment::Bss);
+    REQUIRE(find_symbol(object, "byte").offset == 1024U);
+    REQUIRE(object.bss_size == 1025U);
+
+    REQUIRE(object.data_alignment == 4U);
+    REQUIRE(object.bss_alignment == 4U);
+}
+
+TEST_CASE("The BSS of every object follows all of the initialised data")
+{
+    Object_File first;
+    first.text.resize(4UL, 0U);
+    first.data.resize(3UL, 1U);
+    first.bss_size = 6U;
+    first.symbols.push_back({"main", Segment::Text, 0U, Binding::Global});
+    first.symbols.push_back({"first_zero", Segment::Bss, 0U, Binding::Global});
+
+    Object_File second;
+    second.data.resize(4UL, 2U);
+    second.bss_size = 4U;
+    second.symbols.push_back({"second_zero", Segment::Bss, 0U, Binding::Global});
+
+    Program_Image image;
+    REQUIRE(Linker::link({first, second}, image).status == Linker::Link_Status::Success);
+
+    REQUIRE(image.data.size() == 8UL);
+    REQUIRE(image.bss_size == 12U);
+    REQUIRE(image.symbols.at("first_zero") == Memory_Map::DATA_START_ADDRESS + 8U);
+    REQUIRE(image.symbols.at("second_zero") == Memory_Map::DATA_START_ADDRESS + 16U);
+
+    first.relocations.push_back({Segment::Bss, 0U, Relocation_Type::Data_Address, ""});
+    REQUIRE(Linker::link({first, second}, image).status == Linker::Link_Status::Bad_Relocation);
+
+    first.relocations.clear();
+    first.bss_size = static_cast<uint32_t>(Memory_Map::DATA_SIZE);
+    REQUIRE(Linker::link({first, second}, image).status == Linker::Link_Status::Image_Too_Large);
+}
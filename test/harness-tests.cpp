@@ -0,0 +1,70 @@
+#include "catch2/catch.hpp"
+#include "../bench/harness.h"
+
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+
+const std::string BASELINE_PATH("harness-tests.json");
+
+Result make_result(const std::string& name, const double median_ns)
+{
+    return {name, "instructions", 1000UL, 10UL, Harness::SAMPLE_COUNT, median_ns, median_ns, true};
+}
+
+};
+
+TEST_CASE("Baselines read back what write_json wrote")
+{
+    const std::vector<Result> results = {make_result("execute/loop", 1234.5),
+                                         make_result("compile/\"quoted\\name\"", 0.25)};
+    {
+        std::ofstream file(BASELINE_PATH);
+        Harness::write_json(file, results);
+    }
+
+    std::unordered_map<std::string, double> baseline;
+    std::string error;
+    REQUIRE(Harness::read_baseline(BASELINE_PATH, baseline, error));
+    REQUIRE(baseline.size() == 2UL);
+    REQUIRE(baseline.at("execute/loop") == Approx(1234.5));
+    REQUIRE(baseline.at("compile/\"quoted\\name\"") == Approx(0.25));
+    std::remove(BASELINE_PATH.c_str());
+}
+
+TEST_CASE("Files without benchmarks aren't baselines")
+{
+    {
+        std::ofstream file(BASELINE_PATH);
+        Harness::write_json(file, {});
+    }
+
+    std::unordered_map<std::string, double> baseline;
+    std::string error;
+    REQUIRE_FALSE(Harness::read_baseline(BASELINE_PATH, baseline, error));
+    REQUIRE(error.find("doesn't hold any benchmarks") != std::string::npos);
+    std::remove(BASELINE_PATH.c_str());
+}
+
+TEST_CASE("Only changes beyond the threshold are regressions")
+{
+    const std::unordered_map<std::string, double> baseline = {{"above", 1000.0}, {"below", 1000.0},
+                                                              {"faster", 1000.0}};
+    const std::vector<Result> results = {make_result("above", 1050.5), make_result("below", 1049.5),
+                                         make_result("faster", 500.0), make_result("new", 1.0)};
+
+    const auto comparisons = Harness::compare(results, baseline, 5.0);
+
+    // Benchmarks missing from the baseline are left out
+    REQUIRE(comparisons.size() == 3UL);
+    REQUIRE(comparisons[0].name == "above");
+    REQUIRE(comparisons[0].change == Approx(5.05));
+    REQUIRE(comparisons[0].is_regression);
+    REQUIRE(comparisons[1].name == "below");
+    REQUIRE(comparisons[1].change == Approx(4.95));
+    REQUIRE_FALSE(comparisons[1].is_regression);
+    REQUIRE(comparisons[2].change == Approx(-50.0));
+    REQUIRE_FALSE(comparisons[2].is_regression);
+}
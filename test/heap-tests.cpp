@@ -0,0 +1,119 @@
+#include "catch2/catch.hpp"
+#include "../src/heap.h"
+
+#include <vector>
+
+TEST_CASE("Small blocks are bumped, then recycled through their size class")
+{
+    Heap heap;
+    heap.reset(5U, 4096U);
+
+    uint32_t first{0U};
+    uint32_t second{0U};
+    REQUIRE(heap.allocate(12U, first));
+    REQUIRE(heap.allocate(0U, second));
+
+    REQUIRE(first == 8U);
+    REQUIRE(second == 24U);
+
+    REQUIRE(heap.release(first));
+    REQUIRE_FALSE(heap.release(first));
+    REQUIRE_FALSE(heap.release(first + 4U));
+
+    // A block of a different size class doesn't reuse the freed block
+    uint32_t third{0U};
+    REQUIRE(heap.allocate(4U, third));
+    REQUIRE(third == 32U);
+
+    uint32_t fourth{0U};
+    REQUIRE(heap.allocate(16U, fourth));
+    REQUIRE(fourth == first);
+
+    const auto statistics = heap.statistics();
+    REQUIRE(statistics.allocations == 4UL);
+    REQUIRE(statistics.frees == 1UL);
+    REQUIRE(statistics.bytes_in_use == 32U);
+    REQUIRE(statistics.peak_bytes_in_use == 32U);
+    REQUIRE(statistics.heap_size == 32U);
+}
+
+TEST_CASE("Large blocks are split and merged with their free neighbours")
+{
+    Heap heap;
+    heap.reset(0U, 8192U);
+
+    uint32_t blocks[4]{};
+    for(auto& block : blocks)
+    {
+        REQUIRE(heap.allocate(1024U, block));
+    }
+
+    REQUIRE(heap.release(blocks[0]));
+    REQUIRE(heap.release(blocks[2]));
+
+    auto statistics = heap.statistics();
+    REQUIRE(statistics.free_bytes == 2048U);
+    REQUIRE(statistics.largest_free_block == 1024U);
+    REQUIRE(statistics.fragmentation() == Approx(0.5));
+
+    // Freeing the block between them leaves a single free block
+    REQUIRE(heap.release(blocks[1]));
+    statistics = heap.statistics();
+    REQUIRE(statistics.free_bytes == 3072U);
+    REQUIRE(statistics.largest_free_block == 3072U);
+    REQUIRE(statistics.fragmentation() == Approx(0.0));
+
+    // Which is split to serve the next large request
+    uint32_t split{0U};
+    REQUIRE(heap.allocate(2000U, split));
+    REQUIRE(split == blocks[0]);
+    REQUIRE(heap.statistics().free_bytes == 1072U);
+
+    // The last block is at the top, so freeing it merges everything back into the bump pointer
+    REQUIRE(heap.release(split));
+    REQUIRE(heap.release(blocks[3]));
+    statistics = heap.statistics();
+    REQUIRE(statistics.heap_size == 0U);
+    REQUIRE(statistics.free_bytes == 0U);
+    REQUIRE(statistics.peak_heap_size == 4096U);
+    REQUIRE(statistics.bytes_in_use == 0U);
+}
+
+TEST_CASE("Exhausting the heap fails the allocation without disturbing it")
+{
+    Heap heap;
+    heap.reset(0U, 1024U);
+
+    uint32_t block{0U};
+    REQUIRE(heap.allocate(1000U, block));
+    REQUIRE_FALSE(heap.allocate(100U, block));
+    REQUIRE_FALSE(heap.allocate(UINT32_MAX, block));
+
+    REQUIRE(heap.release(0U));
+    REQUIRE(heap.allocate(1024U, block));
+    REQUIRE(heap.statistics().failed_allocations == 2UL);
+}
+
+TEST_CASE("Small requests fall back to large free blocks once the bump pointer runs out")
+{
+    Heap heap;
+    heap.reset(0U, 2048U);
+
+    uint32_t large{0U};
+    uint32_t rest{0U};
+    REQUIRE(heap.allocate(1024U, large));
+    REQUIRE(heap.allocate(1024U, rest));
+    REQUIRE(heap.release(large));
+
+    std::vector<uint32_t> small(4UL);
+    for(auto& block : small)
+    {
+        REQUIRE(heap.allocate(256U, block));
+    }
+
+    REQUIRE(small[0] == 0U);
+    REQUIRE(small[3] == 768U);
+
+    uint32_t block{0U};
+    REQUIRE_FALSE(heap.allocate(8U, block));
+}
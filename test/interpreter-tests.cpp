@@ -17,4 +17,12 @@ TEST_CASE("Test forbidden file types")
 TEST_CASE("Test files that don't exist!")
 {
 	REQUIRE(Interpret(Fixtures::DOES_NOT_EXIST) == Response_Code::File_Read_Error);
-}
\ No newline at end of file
+}
+
+// There is no front end yet, so no code is produced and nothing is linked. Linking several
+// objects and running the result is covered by the linker tests.
+TEST_CASE("Test multiple translation units")
+{
+	REQUIRE(Interpret({Fixtures::BASIC_C, Fixtures::BASIC_CPP}) == Response_Code::Invalid_File_Type);
+	REQUIRE(Interpret({Fixtures::BASIC_C, Fixtures::DOES_NOT_EXIST}) == Response_Code::File_Read_Error);
+}
@@ -0,0 +1,219 @@
+#include "catch2/catch.hpp"
+#include "../src/instructions.h"
+#include "../src/linker.h"
+#include "../src/memory-map.h"
+#include "../src/virtual-machine.h"
+
+using namespace Linker;
+
+namespace
+{
+
+Object_File make_object(const std::size_t text_size, const std::size_t data_size)
+{
+    Object_File object;
+    object.text.resize(text_size, 0U);
+    object.data.resize(data_size, 0U);
+    return object;
+}
+
+};
+
+TEST_CASE("Objects are placed on word boundaries in link order")
+{
+    auto first = make_object(6UL, 3UL);
+    first.symbols.push_back({"helper", Segment::Text, 2U, Binding::Global});
+
+    auto second = make_object(4UL, 4UL);
+    second.symbols.push_back({"main", Segment::Text, 0U, Binding::Global});
+    second.symbols.push_back({"counter", Segment::Data, 0U, Binding::Global});
+
+    Program_Image image;
+    REQUIRE(link({first, second}, image).status == Link_Status::Success);
+
+    // The start stub takes the first two words
+    REQUIRE(image.text.size() == 20UL);
+    REQUIRE(image.data.size() == 8UL);
+    REQUIRE(image.symbols.at("helper") == 10U);
+    REQUIRE(image.symbols.at("main") == 16U);
+    REQUIRE(image.symbols.at("counter") == Memory_Map::DATA_START_ADDRESS + 4U);
+}
+
+TEST_CASE("Data and BSS start on the largest alignment their object needs")
+{
+    auto first = make_object(4UL, 3UL);
+    first.symbols.push_back({"main", Segment::Text, 0U, Binding::Global});
+
+    auto second = make_object(0UL, 4UL);
+    second.data_alignment = 16U;
+    second.bss_size = 4U;
+    second.bss_alignment = 32U;
+    second.symbols.push_back({"table", Segment::Data, 0U, Binding::Global});
+    second.symbols.push_back({"buffer", Segment::Bss, 0U, Binding::Global});
+
+    Program_Image image;
+    REQUIRE(link({first, second}, image).status == Link_Status::Success);
+
+    REQUIRE(image.symbols.at("table") == Memory_Map::DATA_START_ADDRESS + 16U);
+    REQUIRE(image.data.size() == 20UL);
+    REQUIRE(image.symbols.at("buffer") == Memory_Map::DATA_START_ADDRESS + 32U);
+    REQUIRE(image.bss_size == 16U);
+}
+
+TEST_CASE("Execution starts in a stub which calls main and exits with its result")
+{
+    auto object = make_object(4UL, 0UL);
+    object.symbols.push_back({"main", Segment::Text, 0U, Binding::Global});
+
+    Program_Image image;
+    REQUIRE(link({object}, image).status == Link_Status::Success);
+
+    REQUIRE(image.entry_point == 0U);
+    REQUIRE(image.symbols.at("_start") == 0U);
+    REQUIRE(image.text[0] == CALL);
+    REQUIRE(Memory_Map::load_word(image.text, 1UL) == image.symbols.at("main"));
+    REQUIRE(image.text[5] == PUSH);
+    REQUIRE(image.text[6] == EXIT);
+}
+
+TEST_CASE("Relocations are patched with final addresses")
+{
+    auto first = make_object(8UL, 0UL);
+    first.symbols.push_back({"main", Segment::Text, 0U, Binding::Global});
+    first.symbols.push_back({"callee", Segment::Text, 4U, Binding::Global});
+
+    auto second = make_object(12UL, 8UL);
+    Memory_Map::store_word(second.text, 0UL, 1U);
+    Memory_Map::store_word(second.text, 8UL, 4U);
+    second.relocations.push_back({Segment::Text, 0U, Relocation_Type::Symbol_Address, "callee"});
+    second.relocations.push_back({Segment::Text, 4U, Relocation_Type::Data_Address, ""});
+    second.relocations.push_back({Segment::Text, 8U, Relocation_Type::Text_Address, ""});
+
+    Program_Image image;
+    REQUIRE(link({first, second}, image).status == Link_Status::Success);
+
+    REQUIRE(Memory_Map::load_word(image.text, 16UL) == 13U);
+    REQUIRE(Memory_Map::load_word(image.text, 20UL) == Memory_Map::DATA_START_ADDRESS);
+    REQUIRE(Memory_Map::load_word(image.text, 24UL) == 20U);
+}
+
+TEST_CASE("Objects can reference each other's text and data")
+{
+    // main calls helper and loads limit. helper loads counter and calls main back.
+    auto first = make_object(12UL, 4UL);
+    first.symbols.push_back({"main", Segment::Text, 0U, Binding::Global});
+    first.symbols.push_back({"counter", Segment::Data, 0U, Binding::Global});
+    first.relocations.push_back({Segment::Text, 0U, Relocation_Type::Symbol_Address, "helper"});
+    first.relocations.push_back({Segment::Text, 4U, Relocation_Type::Symbol_Address, "limit"});
+    first.relocations.push_back({Segment::Data, 0U, Relocation_Type::Symbol_Address, "limit"});
+
+    auto second = make_object(8UL, 8UL);
+    second.symbols.push_back({"helper", Segment::Text, 0U, Binding::Global});
+    second.symbols.push_back({"limit", Segment::Data, 4U, Binding::Global});
+    second.relocations.push_back({Segment::Text, 0U, Relocation_Type::Symbol_Address, "counter"});
+    second.relocations.push_back({Segment::Text, 4U, Relocation_Type::Symbol_Address, "main"});
+    second.relocations.push_back({Segment::Data, 0U, Relocation_Type::Symbol_Address, "helper"});
+
+    Program_Image image;
+    REQUIRE(link({first, second}, image).status == Link_Status::Success);
+
+    const uint32_t main = 8U;
+    const uint32_t helper = 20U;
+    const uint32_t counter = Memory_Map::DATA_START_ADDRESS;
+    const uint32_t limit = Memory_Map::DATA_START_ADDRESS + 8U;
+
+    REQUIRE(image.symbols.at("main") == main);
+    REQUIRE(image.symbols.at("helper") == helper);
+    REQUIRE(image.symbols.at("counter") == counter);
+    REQUIRE(image.symbols.at("limit") == limit);
+
+    REQUIRE(Memory_Map::load_word(image.text, main) == helper);
+    REQUIRE(Memory_Map::load_word(image.text, main + 4UL) == limit);
+    REQUIRE(Memory_Map::load_word(image.data, 0UL) == limit);
+    REQUIRE(Memory_Map::load_word(image.text, helper) == counter);
+    REQUIRE(Memory_Map::load_word(image.text, helper + 4UL) == main);
+    REQUIRE(Memory_Map::load_word(image.data, 4UL) == helper);
+}
+
+TEST_CASE("Objects linked together run as one program")
+{
+    // main passes limit to twice, which returns double its argument plus counter
+    Object_File first;
+    first.text = encode({
+        {0, ENT, 0},  // 0
+        {0, IMM, 0},  // 5  limit
+        {0, LI, 0},   // 10
+        {0, PUSH, 0}, // 11
+        {0, CALL, 0}, // 12 twice
+        {0, ADJ, 1},  // 17
+        {0, LEV, 0}   // 22
+    });
+    first.data = {0U, 0U, 0U, 5U};
+    first.symbols.push_back({"main", Segment::Text, 0U, Binding::Global});
+    first.symbols.push_back({"counter", Segment::Data, 0U, Binding::Global});
+    first.relocations.push_back({Segment::Text, 6U, Relocation_Type::Symbol_Address, "limit"});
+    first.relocations.push_back({Segment::Text, 13U, Relocation_Type::Symbol_Address, "twice"});
+
+    Object_File second;
+    second.text = encode({
+        {0, ENT, 0},  // 0
+        {0, LEA, 2},  // 5  The argument
+        {0, LI, 0},   // 10
+        {0, PUSH, 0}, // 11
+        {0, LEA, 2},  // 12
+        {0, LI, 0},   // 17
+        {0, ADD, 0},  // 18
+        {0, PUSH, 0}, // 19
+        {0, IMM, 0},  // 20 counter
+        {0, LI, 0},   // 25
+        {0, ADD, 0},  // 26
+        {0, LEV, 0}   // 27
+    });
+    second.data = {0U, 0U, 0U, 7U};
+    second.symbols.push_back({"twice", Segment::Text, 0U, Binding::Global});
+    second.symbols.push_back({"limit", Segment::Data, 0U, Binding::Global});
+    second.relocations.push_back({Segment::Text, 21U, Relocation_Type::Symbol_Address, "counter"});
+
+    Program_Image image;
+    REQUIRE(link({first, second}, image).status == Link_Status::Success);
+
+    Virtual_Machine vm;
+    REQUIRE(vm.load(image));
+
+    const auto trap = vm.execute();
+    REQUIRE(trap.code == Fault_Code::Exit);
+    REQUIRE(trap.exit_status == 19);
+}
+
+TEST_CASE("Local symbols shadow globals and stay private")
+{
+    auto first = make_object(8UL, 0UL);
+    first.symbols.push_back({"main", Segment::Text, 0U, Binding::Global});
+    first.symbols.push_back({"helper", Segment::Text, 0U, Binding::Local});
+    first.relocations.push_back({Segment::Text, 4U, Relocation_Type::Symbol_Address, "helper"});
+
+    auto second = make_object(4UL, 0UL);
+    second.relocations.push_back({Segment::Text, 0U, Relocation_Type::Symbol_Address, "helper"});
+
+    Program_Image image;
+    REQUIRE(link({first}, image).status == Link_Status::Success);
+    REQUIRE(link({first, second}, image).status == Link_Status::Undefined_Symbol);
+}
+
+TEST_CASE("Link errors are reported")
+{
+    auto first = make_object(4UL, 0UL);
+    first.symbols.push_back({"main", Segment::Text, 0U, Binding::Global});
+
+    Program_Image image;
+    REQUIRE(link({first, first}, image).status == Link_Status::Duplicate_Symbol);
+
+    auto overrun = make_object(4UL, 0UL);
+    overrun.relocations.push_back({Segment::Text, 2U, Relocation_Type::Text_Address, ""});
+    REQUIRE(link({overrun}, image).status == Link_Status::Bad_Relocation);
+
+    auto huge = make_object(Memory_Map::TEXT_SIZE + 1UL, 0UL);
+    REQUIRE(link({huge}, image).status == Link_Status::Image_Too_Large);
+
+    REQUIRE(link({make_object(4UL, 0UL)}, image).status == Link_Status::Missing_Entry_Point);
+}
@@ -0,0 +1,537 @@
+#include "catch2/catch.hpp"
+#include "../programs/programs.h"
+#include "../src/data-layout.h"
+#include "../src/instructions.h"
+#include "../src/memory-map.h"
+#include "../src/optimizer.h"
+#include "../src/virtual-machine.h"
+
+#include <algorithm>
+
+using namespace Optimizer;
+
+namespace
+{
+
+Object_File assemble(const std::vector<Instruction>& instructions)
+{
+    Object_File object;
+    object.text = encode(instructions);
+    return object;
+}
+
+// Turns a hand assembled program back into an object, exporting only what a compiler would: the
+// entry point, named _start, and every function
+Object_File disassemble(const Program_Image& image)
+{
+    Object_File object;
+    object.text = image.text;
+    object.data = image.data;
+    object.bss_size = image.bss_size;
+
+    for(const auto& [name, offset] : image.symbols)
+    {
+        if((offset == image.entry_point) || ((offset < image.text.size()) && (image.text[offset] == ENT)))
+        {
+            const auto exported = (offset == image.entry_point) ? std::string("_start") : name;
+            object.symbols.push_back({exported, Segment::Text, offset, Binding::Global});
+        }
+    }
+
+    return object;
+}
+
+// x = 2 + 3 * 4; if(1) { *global = x; return x - 7; } return 99;
+Benchmark_Program folding_program()
+{
+    Assembler assembler;
+    assembler.label("_start").emit(CALL, "main").emit(PUSH).emit(EXIT);
+
+    assembler.label("main").emit(ENT, 1U)
+             .emit(LEA, 0xFFFFFFFFU).emit(PUSH).emit(IMM, 2U).emit(PUSH).emit(IMM, 3U).emit(PUSH).emit(IMM, 4U)
+             .emit(MUL).emit(ADD).emit(SI)
+             .emit(IMM, 1U).emit(JZ, "dead")
+             .emit(IMM, Memory_Map::DATA_START_ADDRESS).emit(PUSH).emit(LEA, 0xFFFFFFFFU).emit(LI).emit(SI)
+             .emit(LEA, 0xFFFFFFFFU).emit(LI).emit(PUSH).emit(IMM, 7U).emit(SUB).emit(LEV)
+             .label("dead")
+             .emit(IMM, 99U).emit(LEV);
+
+    auto image = assembler.finish();
+    image.data.assign(Memory_Map::WORD_SIZE, 0);
+    return {image, 7};
+}
+
+// y = square(5); return count(1000) + y; where count(n) tail calls itself down to zero
+Benchmark_Program calls_program()
+{
+    Assembler assembler;
+    assembler.label("_start").emit(CALL, "main").emit(PUSH).emit(EXIT);
+
+    assembler.label("main").emit(ENT, 1U)
+             .emit(LEA, 0xFFFFFFFFU).emit(PUSH).emit(IMM, 5U).emit(PUSH).emit(CALL, "square").emit(ADJ, 1U).emit(SI)
+             .emit(IMM, 1000U).emit(PUSH).emit(CALL, "count").emit(ADJ, 1U)
+             .emit(PUSH).emit(LEA, 0xFFFFFFFFU).emit(LI).emit(ADD).emit(LEV);
+
+    assembler.label("square").emit(ENT, 0U)
+             .emit(LEA, 2U).emit(LI).emit(PUSH).emit(LEA, 2U).emit(LI).emit(MUL).emit(LEV);
+
+    assembler.label("count").emit(ENT, 0U)
+             .emit(LEA, 2U).emit(LI).emit(PUSH).emit(IMM, 0U).emit(EQ).emit(JZ, "recurse")
+             .emit(IMM, 0U).emit(LEV)
+             .label("recurse")
+             .emit(LEA, 2U).emit(LI).emit(PUSH).emit(IMM, 1U).emit(SUB).emit(PUSH)
+             .emit(CALL, "count").emit(ADJ, 1U).emit(LEV);
+
+    return {assembler.finish(), 25};
+}
+
+// for(i = 0; i < n * 2; ++i) { s = s + i*4 + i*4 + i*4; } *global = s; return s; with n = 50
+Benchmark_Program loop_program()
+{
+    Assembler assembler;
+    assembler.label("_start").emit(IMM, 50U).emit(PUSH).emit(CALL, "sum").emit(ADJ, 1U).emit(PUSH).emit(EXIT);
+
+    assembler.label("sum").emit(ENT, 2U)
+             .emit(LEA, 0xFFFFFFFFU).emit(PUSH).emit(IMM, 0U).emit(SI)
+             .emit(LEA, 0xFFFFFFFEU).emit(PUSH).emit(IMM, 0U).emit(SI)
+             .label("condition")
+             .emit(LEA, 0xFFFFFFFFU).emit(LI).emit(PUSH)
+             .emit(LEA, 2U).emit(LI).emit(PUSH).emit(IMM, 2U).emit(MUL)
+             .emit(LT).emit(JZ, "done")
+             .emit(LEA, 0xFFFFFFFEU).emit(PUSH).emit(LEA, 0xFFFFFFFEU).emit(LI);
+    for(auto use = 0; use < 3; ++use)
+    {
+        assembler.emit(PUSH).emit(LEA, 0xFFFFFFFFU).emit(LI).emit(PUSH).emit(IMM, 4U).emit(MUL).emit(ADD);
+    }
+    assembler.emit(SI)
+             .emit(LEA, 0xFFFFFFFFU).emit(PUSH).emit(LI).emit(PUSH).emit(IMM, 1U).emit(ADD).emit(SI)
+             .emit(JMP, "condition")
+             .label("done")
+             .emit(IMM, Memory_Map::DATA_START_ADDRESS).emit(PUSH).emit(LEA, 0xFFFFFFFEU).emit(LI).emit(SI)
+             .emit(LEV);
+
+    auto image = assembler.finish();
+    image.data.assign(Memory_Map::WORD_SIZE, 0);
+    return {image, 12 * 4950};
+}
+
+struct Outcome
+{
+    Trap trap;
+    std::vector<char> data;
+};
+
+Outcome run(const Object_File& object)
+{
+    Program_Image image;
+    image.text = object.text;
+    image.data = object.data;
+    image.bss_size = object.bss_size;
+    image.entry_point = std::find_if(object.symbols.begin(), object.symbols.end(),
+                                     [](const Symbol& symbol) { return symbol.name == "_start"; })->offset;
+
+    Virtual_Machine vm;
+    REQUIRE(vm.load(image));
+    const auto trap = vm.execute();
+
+    return {trap, vm.data_segment()};
+}
+
+};
+
+TEST_CASE("Constant expressions are folded")
+{
+    auto object = assemble({
+        {0, IMM, 2}, {0, PUSH, 0}, {0, IMM, 3}, {0, PUSH, 0}, {0, IMM, 4}, {0, MUL, 0}, {0, ADD, 0},
+        {0, EXIT, 0}
+    });
+
+    const auto statistics = optimize(object, Level::O1);
+
+    REQUIRE(object.text == encode({{0, IMM, 14}, {0, EXIT, 0}}));
+    REQUIRE(statistics.instructions_before == 8UL);
+    REQUIRE(statistics.instructions_after == 2UL);
+}
+
+TEST_CASE("Folding matches the virtual machine's unsigned semantics")
+{
+    auto comparison = assemble({{0, IMM, 1}, {0, PUSH, 0}, {0, IMM, 0xFFFFFFFFU}, {0, LT, 0}});
+    optimize(comparison, Level::O1);
+    REQUIRE(comparison.text == encode({{0, IMM, 1}}));
+
+    auto subtraction = assemble({{0, IMM, 1}, {0, PUSH, 0}, {0, IMM, 2}, {0, SUB, 0}});
+    optimize(subtraction, Level::O1);
+    REQUIRE(subtraction.text == encode({{0, IMM, 0xFFFFFFFFU}}));
+
+    auto shift = assemble({{0, IMM, 1}, {0, PUSH, 0}, {0, IMM, 31}, {0, SHL, 0}});
+    optimize(shift, Level::O1);
+    REQUIRE(shift.text == encode({{0, IMM, 0x80000000U}}));
+}
+
+TEST_CASE("Faulting or undefined operations are left alone")
+{
+    const std::vector<Instruction> division = {{0, IMM, 1}, {0, PUSH, 0}, {0, IMM, 0}, {0, DIV, 0}};
+    auto object = assemble(division);
+    optimize(object, Level::O2);
+    REQUIRE(object.text == encode(division));
+
+    const std::vector<Instruction> shift = {{0, IMM, 1}, {0, PUSH, 0}, {0, IMM, 32}, {0, SHR, 0}};
+    object = assemble(shift);
+    optimize(object, Level::O2);
+    REQUIRE(object.text == encode(shift));
+}
+
+TEST_CASE("Jump targets block folding")
+{
+    // A jump lands on the second IMM, so its value isn't constant
+    const std::vector<Instruction> instructions = {
+        {0, IMM, 1}, {0, PUSH, 0}, {0, IMM, 2}, {0, ADD, 0}, {0, JMP, 6}
+    };
+
+    auto object = assemble(instructions);
+    optimize(object, Level::O1);
+    REQUIRE(object.text == encode(instructions));
+}
+
+TEST_CASE("Constant conditions are resolved and dead code removed")
+{
+    auto object = assemble({
+        {0, IMM, 0},    // 0
+        {0, JZ, 16},    // 5
+        {0, IMM, 1},    // 10
+        {0, EXIT, 0},   // 15
+        {0, IMM, 2},    // 16
+        {0, EXIT, 0}    // 21
+    });
+
+    auto level_one = object;
+    optimize(level_one, Level::O1);
+    REQUIRE(level_one.text == encode({
+        {0, IMM, 0}, {0, JMP, 16}, {0, IMM, 1}, {0, EXIT, 0}, {0, IMM, 2}, {0, EXIT, 0}
+    }));
+
+    const auto statistics = optimize(object, Level::O2);
+    REQUIRE(object.text == encode({{0, IMM, 0}, {0, IMM, 2}, {0, EXIT, 0}}));
+    REQUIRE(statistics.instructions_after == 3UL);
+}
+
+TEST_CASE("Symbols and relocations follow the code they point at")
+{
+    auto object = assemble({
+        {0, ENT, 0},    // 0  helper
+        {0, IMM, 1},    // 5
+        {0, LEV, 0},    // 10
+        {0, IMM, 9},    // 11 unreachable
+        {0, CALL, 0},   // 16 main
+        {0, CALL, 0},   // 21
+        {0, EXIT, 0}    // 26
+    });
+    object.symbols.push_back({"helper", Segment::Text, 0U, Binding::Local});
+    object.symbols.push_back({"main", Segment::Text, 16U, Binding::Global});
+    object.relocations.push_back({Segment::Text, 17U, Relocation_Type::Symbol_Address, "helper"});
+    object.relocations.push_back({Segment::Text, 22U, Relocation_Type::Symbol_Address, "external"});
+
+    optimize(object, Level::O2);
+
+    REQUIRE(object.text == encode({
+        {0, ENT, 0}, {0, IMM, 1}, {0, LEV, 0}, {0, CALL, 0}, {0, CALL, 0}, {0, EXIT, 0}
+    }));
+    REQUIRE(object.symbols[1].offset == 11U);
+    REQUIRE(object.relocations.size() == 2UL);
+    REQUIRE(object.relocations[0].offset == 12U);
+    REQUIRE(object.relocations[1].offset == 17U);
+}
+
+TEST_CASE("Small leaf functions are inlined into their callers")
+{
+    auto object = assemble({
+        {0, ENT, 1},            // 0  main
+        {0, LEA, 0xFFFFFFFFU},  // 5
+        {0, PUSH, 0},           // 10
+        {0, IMM, 4},            // 11
+        {0, PUSH, 0},           // 16
+        {0, CALL, 29},          // 17
+        {0, ADJ, 1},            // 22
+        {0, SI, 0},             // 27
+        {0, LEV, 0},            // 28
+        {0, ENT, 0},            // 29 square
+        {0, LEA, 2},            // 34
+        {0, LI, 0},             // 39
+        {0, PUSH, 0},           // 40
+        {0, LEA, 2},            // 41
+        {0, LI, 0},             // 46
+        {0, MUL, 0},            // 47
+        {0, LEV, 0}             // 48
+    });
+    object.symbols.push_back({"main", Segment::Text, 0U, Binding::Global});
+    object.symbols.push_back({"square", Segment::Text, 29U, Binding::Global});
+
+    optimize(object, Level::O2);
+
+    // The argument sits three words below the base pointer: one local plus two pushed words
+    REQUIRE(std::vector<uint8_t>(object.text.begin(), object.text.begin() + 38) == encode({
+        {0, ENT, 1}, {0, LEA, 0xFFFFFFFFU}, {0, PUSH, 0}, {0, IMM, 4}, {0, PUSH, 0},
+        {0, LEA, 0xFFFFFFFDU}, {0, LI, 0}, {0, PUSH, 0}, {0, LEA, 0xFFFFFFFDU}, {0, LI, 0}, {0, MUL, 0},
+        {0, ADJ, 1}, {0, SI, 0}, {0, LEV, 0}
+    }));
+    REQUIRE(object.symbols[1].offset == 38U);
+}
+
+TEST_CASE("Self tail calls reuse the current frame")
+{
+    auto object = assemble({
+        {0, ENT, 0},            // 0  count(n): if(n == 0) return 0; return count(n - 1);
+        {0, LEA, 2},            // 5
+        {0, LI, 0},             // 10
+        {0, PUSH, 0},           // 11
+        {0, IMM, 0},            // 12
+        {0, EQ, 0},             // 17
+        {0, JZ, 29},            // 18
+        {0, IMM, 0},            // 23
+        {0, LEV, 0},            // 28
+        {0, LEA, 2},            // 29
+        {0, LI, 0},             // 34
+        {0, PUSH, 0},           // 35
+        {0, IMM, 1},            // 36
+        {0, SUB, 0},            // 41
+        {0, PUSH, 0},           // 42
+        {0, CALL, 0},           // 43
+        {0, ADJ, 1},            // 48
+        {0, LEV, 0},            // 53
+        {0, LEV, 0}             // 54
+    });
+    object.symbols.push_back({"count", Segment::Text, 0U, Binding::Global});
+
+    optimize(object, Level::O2);
+
+    REQUIRE(object.text == encode({
+        {0, ENT, 0}, {0, LEA, 2}, {0, LI, 0}, {0, PUSH, 0}, {0, IMM, 0}, {0, EQ, 0}, {0, JZ, 29},
+        {0, IMM, 0}, {0, LEV, 0},
+        {0, LEA, 2}, {0, LI, 0}, {0, PUSH, 0}, {0, IMM, 1}, {0, SUB, 0}, {0, PUSH, 0},
+        {0, LEA, 2}, {0, PUSH, 0}, {0, LEA, 0xFFFFFFFFU}, {0, LI, 0}, {0, SI, 0}, {0, ADJ, 1},
+        {0, JMP, 5}
+    }));
+    REQUIRE(object.relocations.size() == 1UL);
+    REQUIRE(object.relocations[0].type == Relocation_Type::Text_Address);
+}
+
+TEST_CASE("Loop invariant expressions are computed once ahead of the loop")
+{
+    auto object = assemble({
+        {0, ENT, 1},                                                        // 0
+        {0, LEA, 0xFFFFFFFFU}, {0, PUSH, 0}, {0, IMM, 0}, {0, SI, 0},       // 5  i = 0
+        {0, LEA, 0xFFFFFFFFU}, {0, LI, 0}, {0, PUSH, 0},                    // 17 while(i < n * 2)
+        {0, LEA, 2}, {0, LI, 0}, {0, PUSH, 0}, {0, IMM, 2}, {0, MUL, 0},
+        {0, LT, 0}, {0, JZ, 68},
+        {0, LEA, 0xFFFFFFFFU}, {0, PUSH, 0}, {0, LEA, 0xFFFFFFFFU},         // 43 i = i + 1
+        {0, LI, 0}, {0, PUSH, 0}, {0, IMM, 1}, {0, ADD, 0}, {0, SI, 0},
+        {0, JMP, 17},                                                       // 63
+        {0, LEA, 0xFFFFFFFFU}, {0, LI, 0}, {0, LEV, 0}                      // 68 return i
+    });
+    object.symbols.push_back({"count", Segment::Text, 0U, Binding::Global});
+
+    optimize(object, Level::O3);
+
+    REQUIRE(object.text == encode({
+        {0, ENT, 2},
+        {0, LEA, 0xFFFFFFFFU}, {0, PUSH, 0}, {0, IMM, 0}, {0, SI, 0},
+        {0, LEA, 0xFFFFFFFEU}, {0, PUSH, 0}, {0, LEA, 2}, {0, LI, 0}, {0, PUSH, 0}, {0, IMM, 2},
+        {0, MUL, 0}, {0, SI, 0},
+        {0, LEA, 0xFFFFFFFFU}, {0, LI, 0}, {0, PUSH, 0}, {0, LEA, 0xFFFFFFFEU}, {0, LI, 0},
+        {0, LT, 0}, {0, JZ, 81},
+        {0, LEA, 0xFFFFFFFFU}, {0, PUSH, 0}, {0, LEA, 0xFFFFFFFFU},
+        {0, LI, 0}, {0, PUSH, 0}, {0, IMM, 1}, {0, ADD, 0}, {0, SI, 0},
+        {0, JMP, 37},
+        {0, LEA, 0xFFFFFFFFU}, {0, LI, 0}, {0, LEV, 0}
+    }));
+}
+
+TEST_CASE("Loads of globals laid out by Data_Layout are loop invariant")
+{
+    auto object = assemble({
+        {0, ENT, 1},                                                        // 0
+        {0, LEA, 0xFFFFFFFFU}, {0, PUSH, 0}, {0, IMM, 0}, {0, SI, 0},       // 5  i = 0
+        {0, LEA, 0xFFFFFFFFU}, {0, LI, 0}, {0, PUSH, 0},                    // 17 while(i < limit * 2)
+        {0, IMM, 0}, {0, LI, 0}, {0, PUSH, 0}, {0, IMM, 2}, {0, MUL, 0},
+        {0, LT, 0}, {0, JZ, 68},
+        {0, LEA, 0xFFFFFFFFU}, {0, PUSH, 0}, {0, LEA, 0xFFFFFFFFU},         // 43 i = i + 1
+        {0, LI, 0}, {0, PUSH, 0}, {0, IMM, 1}, {0, ADD, 0}, {0, SI, 0},
+        {0, JMP, 17},                                                       // 63
+        {0, LEA, 0xFFFFFFFFU}, {0, LI, 0}, {0, LEV, 0}                      // 68 return i
+    });
+    object.symbols.push_back({"count", Segment::Text, 0U, Binding::Global});
+    object.relocations.push_back({Segment::Text, 25U, Relocation_Type::Symbol_Address, "limit"});
+
+    Data_Layout data;
+    data.add_global("limit", Binding::Global, 4U, 4U, true, {0U, 0U, 0U, 50U});
+    data.emit(object);
+
+    optimize(object, Level::O3);
+
+    REQUIRE(object.text == encode({
+        {0, ENT, 2},
+        {0, LEA, 0xFFFFFFFFU}, {0, PUSH, 0}, {0, IMM, 0}, {0, SI, 0},
+        {0, LEA, 0xFFFFFFFEU}, {0, PUSH, 0}, {0, IMM, 0}, {0, LI, 0}, {0, PUSH, 0}, {0, IMM, 2},
+        {0, MUL, 0}, {0, SI, 0},
+        {0, LEA, 0xFFFFFFFFU}, {0, LI, 0}, {0, PUSH, 0}, {0, LEA, 0xFFFFFFFEU}, {0, LI, 0},
+        {0, LT, 0}, {0, JZ, 81},
+        {0, LEA, 0xFFFFFFFFU}, {0, PUSH, 0}, {0, LEA, 0xFFFFFFFFU},
+        {0, LI, 0}, {0, PUSH, 0}, {0, IMM, 1}, {0, ADD, 0}, {0, SI, 0},
+        {0, JMP, 37},
+        {0, LEA, 0xFFFFFFFFU}, {0, LI, 0}, {0, LEV, 0}
+    }));
+
+    // The hoisted load still refers to the global
+    REQUIRE(object.relocations.size() == 1UL);
+    REQUIRE(object.relocations[0].offset == 24U);
+    REQUIRE(object.relocations[0].symbol == "limit");
+}
+
+TEST_CASE("Repeated multiplications of an induction variable are strength reduced")
+{
+    std::vector<Instruction> instructions = {
+        {0, ENT, 2},
+        {0, LEA, 0xFFFFFFFFU}, {0, PUSH, 0}, {0, IMM, 0}, {0, SI, 0},       // i = 0
+        {0, LEA, 0xFFFFFFFFU}, {0, LI, 0}, {0, PUSH, 0}, {0, IMM, 100},     // while(i < 100)
+        {0, LT, 0}, {0, JZ, 0},
+        {0, LEA, 0xFFFFFFFEU}, {0, PUSH, 0}                                 // s = i*4 + i*4 + i*4
+    };
+    for(auto use = 0; use < 3; ++use)
+    {
+        instructions.insert(instructions.end(), {{0, LEA, 0xFFFFFFFFU}, {0, LI, 0}, {0, PUSH, 0}, {0, IMM, 4}, {0, MUL, 0}});
+        instructions.push_back((use == 0) ? Instruction{0, PUSH, 0} : Instruction{0, ADD, 0});
+    }
+    instructions.back() = {0, SI, 0};
+    instructions.insert(instructions.end(), {
+        {0, LEA, 0xFFFFFFFFU}, {0, PUSH, 0}, {0, LEA, 0xFFFFFFFFU},         // i = i + 1
+        {0, LI, 0}, {0, PUSH, 0}, {0, IMM, 1}, {0, ADD, 0}, {0, SI, 0},
+        {0, JMP, 17},
+        {0, LEA, 0xFFFFFFFEU}, {0, LI, 0}, {0, LEV, 0}
+    });
+
+    // Patch the loop exit now the layout is known
+    auto object = assemble(instructions);
+    const auto exit = static_cast<uint32_t>(object.text.size() - 7UL);
+    instructions[10].operand = exit;
+    object = assemble(instructions);
+    object.symbols.push_back({"sum", Segment::Text, 0U, Binding::Global});
+
+    optimize(object, Level::O3);
+
+    // Only the preheader still multiplies
+    const auto optimized = decode(object.text);
+    const auto multiplications = std::count_if(optimized.begin(), optimized.end(),
+                                               [](const Instruction& instruction) { return instruction.opcode == MUL; });
+
+    REQUIRE(multiplications == 1);
+    REQUIRE(optimized[0].operand == 3U);
+}
+
+TEST_CASE("Induction variables stepped with ++i are strength reduced")
+{
+    // for(i = 0; i < 100; ++i) { s = i*4 + i*4 + i*4; } return s;
+    std::vector<Instruction> instructions = {
+        {0, ENT, 2},
+        {0, LEA, 0xFFFFFFFFU}, {0, PUSH, 0}, {0, IMM, 0}, {0, SI, 0},
+        {0, LEA, 0xFFFFFFFFU}, {0, LI, 0}, {0, PUSH, 0}, {0, IMM, 100},
+        {0, LT, 0}, {0, JZ, 0},
+        {0, LEA, 0xFFFFFFFEU}, {0, PUSH, 0}
+    };
+    for(auto use = 0; use < 3; ++use)
+    {
+        instructions.insert(instructions.end(), {{0, LEA, 0xFFFFFFFFU}, {0, LI, 0}, {0, PUSH, 0}, {0, IMM, 4}, {0, MUL, 0}});
+        instructions.push_back((use == 0) ? Instruction{0, PUSH, 0} : Instruction{0, ADD, 0});
+    }
+    instructions.back() = {0, SI, 0};
+    instructions.insert(instructions.end(), {
+        {0, LEA, 0xFFFFFFFFU}, {0, PUSH, 0}, {0, LI, 0}, {0, PUSH, 0}, {0, IMM, 1}, {0, ADD, 0}, {0, SI, 0},
+        {0, JMP, 17},
+        {0, LEA, 0xFFFFFFFEU}, {0, LI, 0}, {0, LEV, 0}
+    });
+
+    auto object = assemble(instructions);
+    instructions[10].operand = static_cast<uint32_t>(object.text.size() - 7UL);
+    object = assemble(instructions);
+    object.symbols.push_back({"sum", Segment::Text, 0U, Binding::Global});
+
+    optimize(object, Level::O3);
+
+    const auto optimized = decode(object.text);
+    const auto multiplications = std::count_if(optimized.begin(), optimized.end(),
+                                               [](const Instruction& instruction) { return instruction.opcode == MUL; });
+    REQUIRE(multiplications == 1);
+    REQUIRE(optimized[0].operand == 3U);
+
+    // The product is stepped by i's step times the factor, straight after ++i
+    const auto increment = std::search(optimized.begin(), optimized.end(), instructions.end() - 11, instructions.end() - 4,
+                                       [](const Instruction& left, const Instruction& right)
+                                       {
+                                           return (left.opcode == right.opcode) && (left.operand == right.operand);
+                                       });
+    REQUIRE(increment != optimized.end());
+
+    const std::vector<Instruction> step = {
+        {0, LEA, 0xFFFFFFFDU}, {0, PUSH, 0}, {0, LEA, 0xFFFFFFFDU}, {0, LI, 0}, {0, PUSH, 0}, {0, IMM, 4},
+        {0, ADD, 0}, {0, SI, 0}
+    };
+    REQUIRE(std::equal(step.begin(), step.end(), increment + 7, [](const Instruction& left, const Instruction& right)
+    {
+        return (left.opcode == right.opcode) && (left.operand == right.operand);
+    }));
+}
+
+TEST_CASE("Values already in the accumulator aren't reloaded")
+{
+    auto object = assemble({
+        {0, ENT, 1}, {0, LEA, 0xFFFFFFFFU}, {0, PUSH, 0}, {0, IMM, 5}, {0, SI, 0},
+        {0, LEA, 0xFFFFFFFFU}, {0, LI, 0}, {0, PUSH, 0}, {0, LEA, 0xFFFFFFFFU}, {0, LI, 0}, {0, ADD, 0},
+        {0, LEV, 0}
+    });
+    object.symbols.push_back({"twice", Segment::Text, 0U, Binding::Global});
+
+    optimize(object, Level::O3);
+
+    REQUIRE(object.text == encode({
+        {0, ENT, 1}, {0, LEA, 0xFFFFFFFFU}, {0, PUSH, 0}, {0, IMM, 5}, {0, SI, 0},
+        {0, PUSH, 0}, {0, ADD, 0}, {0, LEV, 0}
+    }));
+}
+
+TEST_CASE("Optimized programs behave exactly as they did unoptimized")
+{
+    const std::vector<std::pair<std::string, Benchmark_Program>> corpus = {
+        {"folding", folding_program()},
+        {"calls", calls_program()},
+        {"loop", loop_program()},
+        {"store_word", Programs::store_word()},
+        {"store_byte", Programs::store_byte()},
+        {"load_stack_word", Programs::load_stack_word()},
+        {"arithmetic", Programs::arithmetic(MUL)},
+        {"fib", Programs::fib(12U)},
+        {"sieve", Programs::sieve(500U)},
+        {"strings", Programs::strings(2U)},
+        {"sort", Programs::sort(48U)}
+    };
+
+    for(const auto& [name, program] : corpus)
+    {
+        const auto object = disassemble(program.image);
+        const auto expected = run(object);
+
+        INFO(name);
+        REQUIRE(expected.trap.code == Fault_Code::Exit);
+        REQUIRE(expected.trap.exit_status == program.exit_status);
+
+        for(const auto level : {Level::O1, Level::O2, Level::O3})
+        {
+            auto optimized = object;
+            optimize(optimized, level);
+            const auto actual = run(optimized);
+
+            INFO("-O" << static_cast<int>(level));
+            REQUIRE(actual.trap.code == expected.trap.code);
+            REQUIRE(actual.trap.exit_status == expected.trap.exit_status);
+            REQUIRE(actual.data == expected.data);
+        }
+    }
+}
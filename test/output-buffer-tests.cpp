@@ -0,0 +1,93 @@
+#include "catch2/catch.hpp"
+#include "../src/output-buffer.h"
+
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+
+/**************************************************************************************************
+ * \brief A pipe whose read end doesn't block, so tests can check what has been flushed so far
+ *************************************************************************************************/
+struct Pipe
+{
+    int read_end{-1};
+    int write_end{-1};
+
+    Pipe()
+    {
+        int ends[2];
+        REQUIRE(::pipe(ends) == 0);
+        read_end = ends[0];
+        write_end = ends[1];
+        ::fcntl(read_end, F_SETFL, O_NONBLOCK);
+    }
+
+    ~Pipe()
+    {
+        ::close(read_end);
+        ::close(write_end);
+    }
+
+    std::string drain() const
+    {
+        std::string result;
+        char chunk[256];
+        for(auto count = ::read(read_end, chunk, sizeof(chunk)); count > 0; count = ::read(read_end, chunk, sizeof(chunk)))
+        {
+            result.append(chunk, static_cast<std::size_t>(count));
+        }
+        return result;
+    }
+};
+
+std::string format(const std::string& text, const std::vector<uint32_t>& arguments)
+{
+    Pipe pipe;
+    uint32_t written{0U};
+    {
+        Output_Buffer output(pipe.write_end);
+        written = output.print(text,
+                               [&arguments](const std::size_t index) { return arguments.at(index); },
+                               [](const uint32_t address) { return (address == 1U) ? std::string_view("str") : std::string_view(""); });
+    }
+
+    const auto result = pipe.drain();
+    REQUIRE(written == result.size());
+    return result;
+}
+
+};
+
+TEST_CASE("Output is held until the buffer fills or is flushed")
+{
+    Pipe pipe;
+    Output_Buffer output(pipe.write_end, 64UL);
+
+    output.write("hello ", 6UL);
+    output.write("world\n", 6UL);
+    REQUIRE(pipe.drain().empty());
+
+    // A write larger than the space left goes out with the buffered bytes
+    const std::string large(100UL, 'x');
+    output.write(large.data(), large.size());
+    REQUIRE(pipe.drain() == "hello world\n" + large);
+
+    output.write("tail", 4UL);
+    REQUIRE(output.flush());
+    REQUIRE(pipe.drain() == "tail");
+}
+
+TEST_CASE("Formatted printing supports integers, characters and strings")
+{
+    REQUIRE(format("plain", {}) == "plain");
+    REQUIRE(format("%d %d %u", {42U, static_cast<uint32_t>(-7), static_cast<uint32_t>(-1)}) == "42 -7 4294967295");
+    REQUIRE(format("%x %X %c%%", {255U, 0xBEEFU, 'z'}) == "ff BEEF z%");
+    REQUIRE(format("[%5d][%-5d][%05d][%03d]", {12U, 12U, static_cast<uint32_t>(-12), 1234U}) == "[   12][12   ][-0012][1234]");
+    REQUIRE(format("[%s][%6s][%-4s]", {1U, 1U, 1U}) == "[str][   str][str ]");
+    REQUIRE(format("%q %", {}) == "%q ");
+}
@@ -0,0 +1,49 @@
+#include "catch2/catch.hpp"
+#include "../src/instructions.h"
+#include "../src/perf-counters.h"
+#include "../src/virtual-machine.h"
+
+#include <sstream>
+
+TEST_CASE("Programs run the same whether or not counters are available")
+{
+    // Count down from a large number, so the run spans many sampling periods
+    Program_Image image;
+    image.text = encode({
+        {0, IMM, 2000000U}, // 0
+        {0, PUSH, 0},       // 5
+        {0, IMM, 1},        // 6
+        {0, SUB, 0},        // 11
+        {0, JNZ, 5},        // 12
+        {0, PUSH, 0},       // 17
+        {0, EXIT, 0}        // 18
+    });
+
+    Virtual_Machine vm;
+    vm.load(image);
+
+    Perf_Counters counters;
+    const auto is_open = counters.open();
+    REQUIRE(is_open == counters.is_open());
+    REQUIRE_FALSE(counters.description().empty());
+
+    counters.start();
+    const auto trap = vm.execute(counters);
+    counters.stop();
+
+    REQUIRE(trap.code == Fault_Code::Exit);
+    REQUIRE(trap.exit_status == 0);
+
+    std::ostringstream report;
+    counters.write_report(report);
+    REQUIRE(report.str().find(counters.description()) == 0UL);
+
+    if(is_open)
+    {
+        REQUIRE(counters.sample_count() > 0UL);
+        REQUIRE(report.str().find("SUB") != std::string::npos);
+    }
+
+    // Per-opcode ratios need rdpmc, which many hosts don't allow
+    REQUIRE((report.str().find("Dispatches") != std::string::npos) == counters.counts_per_opcode());
+}
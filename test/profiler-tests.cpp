@@ -0,0 +1,72 @@
+#include "catch2/catch.hpp"
+#include "../src/instructions.h"
+#include "../src/profiler.h"
+#include "../src/virtual-machine.h"
+
+#include <sstream>
+
+namespace
+{
+
+Program_Image make_image()
+{
+    Program_Image image;
+    image.text = encode({
+        {0, CALL, 7},  // 0  _start
+        {0, PUSH, 0},  // 5
+        {0, EXIT, 0},  // 6
+        {0, ENT, 0},   // 7  main
+        {0, CALL, 23}, // 12
+        {0, CALL, 23}, // 17
+        {0, LEV, 0},   // 22
+        {0, ENT, 0},   // 23 leaf
+        {0, IMM, 1},   // 28
+        {0, LEV, 0}    // 33
+    });
+    image.symbols = {{"_start", 0U}, {"main", 7U}, {"leaf", 23U}};
+    return image;
+}
+
+};
+
+TEST_CASE("Retired instructions are counted by opcode and attributed to call stacks")
+{
+    const auto image = make_image();
+
+    Virtual_Machine vm;
+    vm.load(image);
+
+    Profiler profiler(image);
+    REQUIRE(vm.execute(profiler).code == Fault_Code::Exit);
+
+    REQUIRE(profiler.instructions() == 13UL);
+    REQUIRE(profiler.opcode_count(CALL) == 3UL);
+    REQUIRE(profiler.opcode_count(LEV) == 3UL);
+    REQUIRE(profiler.opcode_count(IMM) == 2UL);
+
+    std::ostringstream folded;
+    profiler.write_folded_stacks(folded);
+    REQUIRE(folded.str() == "_start 3\n_start;main 4\n_start;main;leaf 6\n");
+}
+
+TEST_CASE("The summary lists opcodes, hot spots and per function totals")
+{
+    const auto image = make_image();
+
+    Virtual_Machine vm;
+    vm.load(image);
+
+    Profiler profiler(image);
+    vm.execute(profiler);
+
+    std::ostringstream summary;
+    profiler.write_summary(summary);
+
+    const auto json = summary.str();
+    REQUIRE(json.find("\"instructions\": 13") != std::string::npos);
+    REQUIRE(json.find("\"CALL\": 3") != std::string::npos);
+    REQUIRE(json.find("{\"pc\": 23, \"opcode\": \"ENT\", \"count\": 2}") != std::string::npos);
+    REQUIRE(json.find("{\"name\": \"leaf\", \"self\": 6, \"total\": 6, \"calls\": 2}") != std::string::npos);
+    REQUIRE(json.find("{\"name\": \"main\", \"self\": 4, \"total\": 10, \"calls\": 1}") != std::string::npos);
+    REQUIRE(json.find("{\"name\": \"_start\", \"self\": 3, \"total\": 13, \"calls\": 1}") != std::string::npos);
+}
@@ -0,0 +1,283 @@
+#include "catch2/catch.hpp"
+#include "../src/instructions.h"
+#include "../src/memory-map.h"
+#include "../src/syscall-log.h"
+#include "../src/virtual-machine.h"
+
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+
+const std::string LOG_PATH("syscall-log-tests.log");
+const std::string INPUT_PATH("syscall-log-tests.txt");
+
+// Opens the input, reads it into BSS, closes it, allocates, then exits with the first byte read
+Program_Image make_image()
+{
+    const auto path = static_cast<uint32_t>(Memory_Map::DATA_START_ADDRESS);
+    const auto buffer = static_cast<uint32_t>(path + INPUT_PATH.size() + 1UL);
+
+    Program_Image image;
+    image.text = encode({
+        {0, IMM, path},
+        {0, PUSH, 0},
+        {0, IMM, 0},
+        {0, PUSH, 0},
+        {0, OPEN, 0},
+        {0, ADJ, 2},
+        {0, PUSH, 0},       // The descriptor stays on the stack for READ and CLOS
+        {0, IMM, buffer},
+        {0, PUSH, 0},
+        {0, IMM, 16},
+        {0, PUSH, 0},
+        {0, READ, 0},
+        {0, ADJ, 2},
+        {0, CLOS, 0},
+        {0, ADJ, 1},
+        {0, IMM, 32},
+        {0, PUSH, 0},
+        {0, MALC, 0},
+        {0, ADJ, 1},
+        {0, IMM, buffer},
+        {0, LC, 0},
+        {0, PUSH, 0},
+        {0, EXIT, 0}
+    });
+    image.data.assign(INPUT_PATH.begin(), INPUT_PATH.end());
+    image.data.push_back('\0');
+    image.bss_size = 16U;
+
+    return image;
+}
+
+// Allocates, then exits with zero
+Program_Image make_allocating_image()
+{
+    Program_Image image;
+    image.text = encode({
+        {0, IMM, 32},
+        {0, PUSH, 0},
+        {0, MALC, 0},
+        {0, ADJ, 1},
+        {0, IMM, 0},
+        {0, PUSH, 0},
+        {0, EXIT, 0}
+    });
+
+    return image;
+}
+
+// Saves a log and loads it back ready to replay
+void reload(const Syscall_Log& recorded, Syscall_Log& log)
+{
+    std::string error;
+    REQUIRE(recorded.save(LOG_PATH, error));
+    REQUIRE(log.load(LOG_PATH, error));
+    std::remove(LOG_PATH.c_str());
+}
+
+// Writes a log by hand, with the given entry count in its header
+void write_log(const uint64_t count, const std::vector<uint8_t>& entries)
+{
+    std::ofstream file(LOG_PATH, std::ios::binary | std::ios::trunc);
+    file.write("CISYSLG1", 8);
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    file.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size()));
+}
+
+};
+
+TEST_CASE("System call logs survive a round trip through a file")
+{
+    Syscall_Log recorded(Syscall_Log::Mode::Record);
+    recorded.record(OPEN, 3U);
+    recorded.record(READ, 5U, "hello");
+    recorded.record(MALC, 0xFFFFFFFFU);
+
+    std::string error;
+    REQUIRE(recorded.save(LOG_PATH, error));
+
+    Syscall_Log replayed(Syscall_Log::Mode::Replay);
+    REQUIRE(replayed.load(LOG_PATH, error));
+    std::remove(LOG_PATH.c_str());
+    REQUIRE(replayed.entry_count() == 3UL);
+
+    uint32_t result{0U};
+    std::string_view payload;
+    REQUIRE(replayed.replay(OPEN, result, payload));
+    REQUIRE(result == 3U);
+    REQUIRE(payload.empty());
+
+    // A different call leaves the entry where it is
+    REQUIRE_FALSE(replayed.replay(CLOS, result, payload));
+
+    REQUIRE(replayed.replay(READ, result, payload));
+    REQUIRE(result == 5U);
+    REQUIRE(payload == "hello");
+
+    REQUIRE(replayed.replay(MALC, result, payload));
+    REQUIRE(result == 0xFFFFFFFFU);
+    REQUIRE(replayed.remaining() == 0UL);
+    REQUIRE_FALSE(replayed.replay(EXIT, result, payload));
+}
+
+TEST_CASE("A replayed run sees the same input without touching the host")
+{
+    {
+        std::ofstream input(INPUT_PATH);
+        input << "Zebra";
+    }
+
+    const auto image = make_image();
+
+    Syscall_Log recorded(Syscall_Log::Mode::Record);
+    {
+        Virtual_Machine vm;
+        vm.load(image);
+        vm.set_syscall_log(&recorded);
+
+        const auto trap = vm.execute();
+        REQUIRE(trap.code == Fault_Code::Exit);
+        REQUIRE(trap.exit_status == 'Z');
+    }
+    REQUIRE(recorded.entry_count() == 5UL);
+
+    std::string error;
+    REQUIRE(recorded.save(LOG_PATH, error));
+    std::remove(INPUT_PATH.c_str());
+
+    Syscall_Log replayed(Syscall_Log::Mode::Replay);
+    REQUIRE(replayed.load(LOG_PATH, error));
+    std::remove(LOG_PATH.c_str());
+
+    Virtual_Machine vm;
+    vm.load(image);
+    vm.set_syscall_log(&replayed);
+
+    const auto trap = vm.execute();
+    REQUIRE(trap.code == Fault_Code::Exit);
+    REQUIRE(trap.exit_status == 'Z');
+    REQUIRE(replayed.remaining() == 0UL);
+}
+
+TEST_CASE("Replaying into a program which makes different system calls traps")
+{
+    Syscall_Log log(Syscall_Log::Mode::Replay);
+    {
+        Syscall_Log recorded(Syscall_Log::Mode::Record);
+        recorded.record(MALC, Memory_Map::DATA_START_ADDRESS + 64U);
+
+        std::string error;
+        REQUIRE(recorded.save(LOG_PATH, error));
+        REQUIRE(log.load(LOG_PATH, error));
+        std::remove(LOG_PATH.c_str());
+    }
+
+    Virtual_Machine vm;
+    vm.load(make_image());
+    vm.set_syscall_log(&log);
+
+    const auto trap = vm.execute();
+    REQUIRE(trap.code == Fault_Code::Replay_Mismatch);
+    REQUIRE(trap.opcode == OPEN);
+}
+
+TEST_CASE("Replayed allocations only have to fail in the same places unless addresses are compared")
+{
+    Syscall_Log recorded(Syscall_Log::Mode::Record);
+    recorded.record(MALC, Memory_Map::DATA_START_ADDRESS + 64U);
+    recorded.record(EXIT, 0U);
+
+    {
+        Syscall_Log log(Syscall_Log::Mode::Replay);
+        reload(recorded, log);
+
+        Virtual_Machine vm;
+        vm.load(make_allocating_image());
+        vm.set_syscall_log(&log);
+        REQUIRE(vm.execute().code == Fault_Code::Exit);
+    }
+
+    {
+        Syscall_Log log(Syscall_Log::Mode::Replay);
+        reload(recorded, log);
+        log.set_compares_addresses(true);
+
+        Virtual_Machine vm;
+        vm.load(make_allocating_image());
+        vm.set_syscall_log(&log);
+
+        const auto trap = vm.execute();
+        REQUIRE(trap.code == Fault_Code::Replay_Mismatch);
+        REQUIRE(trap.opcode == MALC);
+    }
+
+    Syscall_Log failed(Syscall_Log::Mode::Record);
+    failed.record(MALC, 0U);
+
+    Syscall_Log log(Syscall_Log::Mode::Replay);
+    reload(failed, log);
+
+    Virtual_Machine vm;
+    vm.load(make_allocating_image());
+    vm.set_syscall_log(&log);
+    REQUIRE(vm.execute().code == Fault_Code::Replay_Mismatch);
+}
+
+TEST_CASE("A replayed READ into a bad buffer faults before taking its entry")
+{
+    Syscall_Log recorded(Syscall_Log::Mode::Record);
+    recorded.record(READ, 0U);
+
+    Syscall_Log log(Syscall_Log::Mode::Replay);
+    reload(recorded, log);
+
+    Program_Image image;
+    image.text = encode({
+        {0, IMM, 0},
+        {0, PUSH, 0},
+        {0, IMM, static_cast<uint32_t>(Memory_Map::DATA_END_ADDRESS - 3UL)}, // Runs off the end of the data
+        {0, PUSH, 0},
+        {0, IMM, 16},
+        {0, PUSH, 0},
+        {0, READ, 0}
+    });
+
+    Virtual_Machine vm;
+    vm.load(image);
+    vm.set_syscall_log(&log);
+
+    const auto trap = vm.execute();
+    REQUIRE(trap.code == Fault_Code::Bad_Address);
+    REQUIRE(log.remaining() == 1UL);
+}
+
+TEST_CASE("Logs which don't match their header, or hold numbers too large, are refused")
+{
+    Syscall_Log log(Syscall_Log::Mode::Replay);
+    std::string error;
+
+    write_log(1UL, {OPEN, 3, 0});
+    REQUIRE(log.load(LOG_PATH, error));
+    REQUIRE(log.entry_count() == 1UL);
+
+    write_log(2UL, {OPEN, 3, 0});
+    REQUIRE_FALSE(log.load(LOG_PATH, error));
+
+    // The payload runs past the end of the file
+    write_log(1UL, {READ, 5, 5, 'h', 'i'});
+    REQUIRE_FALSE(log.load(LOG_PATH, error));
+
+    // 0xFFFFFFFF fits in five bytes, but the same with another bit set doesn't
+    write_log(1UL, {MALC, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0});
+    REQUIRE(log.load(LOG_PATH, error));
+
+    write_log(1UL, {MALC, 0xFF, 0xFF, 0xFF, 0xFF, 0x1F, 0});
+    REQUIRE_FALSE(log.load(LOG_PATH, error));
+    REQUIRE(log.entry_count() == 0UL);
+
+    std::remove(LOG_PATH.c_str());
+}
@@ -0,0 +1,159 @@
+#include "catch2/catch.hpp"
+#include "../src/instructions.h"
+#include "../src/trace.h"
+#include "../src/virtual-machine.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+
+const std::string TRACE_PATH("trace-tests.bin");
+
+Program_Image make_image()
+{
+    Program_Image image;
+    image.text = encode({
+        {0, CALL, 7},  // 0  _start
+        {0, PUSH, 0},  // 5
+        {0, EXIT, 0},  // 6
+        {0, ENT, 0},   // 7  main
+        {0, CALL, 23}, // 12
+        {0, CALL, 23}, // 17
+        {0, LEV, 0},   // 22
+        {0, ENT, 0},   // 23 leaf
+        {0, IMM, 1},   // 28
+        {0, LEV, 0}    // 33
+    });
+    image.symbols = {{"_start", 0U}, {"main", 7U}, {"leaf", 23U}};
+    return image;
+}
+
+};
+
+TEST_CASE("The trace ring hands records over in order, across its end")
+{
+    Trace_Ring ring(3UL);
+    REQUIRE(ring.capacity() == 4UL);
+
+    Trace_Record records[4];
+    uint32_t next = 0U;
+    uint32_t expected = 0U;
+    for(auto round = 0; round < 3; ++round)
+    {
+        while(ring.try_push({next << 8U, next, 0U, 0U}))
+        {
+            ++next;
+        }
+        REQUIRE((next - expected) == 4U);
+
+        // Take some, not all, so the next round wraps around the end of the ring
+        const auto count = ring.pop(records, 3UL);
+        REQUIRE(count == 3UL);
+        for(std::size_t i = 0UL; i < count; ++i)
+        {
+            REQUIRE(records[i].program_counter() == expected);
+            REQUIRE(records[i].ax == expected);
+            ++expected;
+        }
+    }
+
+    REQUIRE(ring.pop(records, 4UL) == 1UL);
+    REQUIRE(records[0].ax == expected);
+    REQUIRE(ring.pop(records, 4UL) == 0UL);
+}
+
+TEST_CASE("A traced program can be read back instruction by instruction")
+{
+    const auto image = make_image();
+
+    Virtual_Machine vm;
+    vm.load(image);
+
+    // A tiny ring makes the execute loop wait for the writer, which must not lose records
+    Trace_Writer writer(2UL);
+    REQUIRE(writer.open(TRACE_PATH, image));
+    vm.set_trace(&writer);
+    REQUIRE(vm.execute().code == Fault_Code::Exit);
+    vm.set_trace(nullptr);
+    REQUIRE(writer.close());
+    REQUIRE(writer.record_count() == 13UL);
+
+    Trace_File trace;
+    std::string error;
+    REQUIRE(read_trace(TRACE_PATH, trace, error));
+    std::remove(TRACE_PATH.c_str());
+
+    const uint32_t program_counters[] = {0U, 7U, 12U, 23U, 28U, 33U, 17U, 23U, 28U, 33U, 22U, 5U, 6U};
+    REQUIRE(trace.records.size() == 13UL);
+    for(std::size_t i = 0UL; i < trace.records.size(); ++i)
+    {
+        REQUIRE(trace.records[i].program_counter() == program_counters[i]);
+        REQUIRE(trace.records[i].opcode() == image.text[program_counters[i]]);
+    }
+
+    // The registers are recorded before each instruction runs
+    REQUIRE(trace.records[4].ax == 0U);
+    REQUIRE(trace.records[5].ax == 1U);
+
+    REQUIRE(trace.function_names.size() == 3UL);
+    REQUIRE(trace.function_names.at(23U) == "leaf");
+}
+
+TEST_CASE("Nothing is traced until a writer is set")
+{
+    const auto image = make_image();
+
+    Virtual_Machine vm;
+    vm.load(image);
+
+    Trace_Writer writer;
+    REQUIRE(writer.open(TRACE_PATH, image));
+    REQUIRE(vm.execute().code == Fault_Code::Exit);
+    REQUIRE(writer.close());
+
+    Trace_File trace;
+    std::string error;
+    REQUIRE(read_trace(TRACE_PATH, trace, error));
+    std::remove(TRACE_PATH.c_str());
+
+    REQUIRE(trace.records.empty());
+}
+
+TEST_CASE("Files which aren't traces are rejected")
+{
+    {
+        std::ofstream file(TRACE_PATH, std::ios::binary);
+        file << "not a trace, but long enough to hold a header";
+    }
+
+    Trace_File trace;
+    std::string error;
+    REQUIRE_FALSE(read_trace(TRACE_PATH, trace, error));
+    REQUIRE(error.find("isn't a trace file") != std::string::npos);
+    std::remove(TRACE_PATH.c_str());
+}
+
+TEST_CASE("Symbol names longer than the rest of the file are rejected")
+{
+    {
+        Trace_Header header{};
+        std::memcpy(header.magic, "CITRACE1", sizeof(header.magic));
+        header.record_size = sizeof(Trace_Record);
+        header.symbol_count = 1U;
+
+        const uint32_t entry[2] = {0U, 0xFFFFFFFFU};
+        std::ofstream file(TRACE_PATH, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(entry), sizeof(entry));
+        file << "main";
+    }
+
+    Trace_File trace;
+    std::string error;
+    REQUIRE_FALSE(read_trace(TRACE_PATH, trace, error));
+    REQUIRE(error.find("is a corrupt trace") != std::string::npos);
+    std::remove(TRACE_PATH.c_str());
+}
@@ -0,0 +1,196 @@
+#include "catch2/catch.hpp"
+#include "../src/instructions.h"
+#include "../src/memory-map.h"
+#include "../src/virtual-machine.h"
+
+namespace
+{
+
+Trap run(const std::vector<Instruction>& instructions)
+{
+    Program_Image image;
+    image.text = encode(instructions);
+
+    Virtual_Machine vm;
+    vm.load(image);
+    return vm.execute();
+}
+
+// Where the stack pointer starts, and the address of each word pushed below it
+constexpr uint32_t STACK_TOP = Memory_Map::STACK_SIZE - 1UL;
+
+uint32_t pushed(const uint32_t words)
+{
+    return STACK_TOP - (words * static_cast<uint32_t>(Memory_Map::WORD_SIZE));
+}
+
+};
+
+TEST_CASE("EXIT stops the machine with the status on top of the stack")
+{
+    const auto trap = run({{0, IMM, 3}, {0, PUSH, 0}, {0, EXIT, 0}});
+
+    REQUIRE(trap.code == Fault_Code::Exit);
+    REQUIRE(trap.exit_status == 3);
+    REQUIRE(trap.program_counter == 6U);
+    REQUIRE(trap.opcode == EXIT);
+}
+
+TEST_CASE("Division by zero traps before popping the stack")
+{
+    const auto trap = run({{0, IMM, 7}, {0, PUSH, 0}, {0, IMM, 0}, {0, MOD, 0}, {0, EXIT, 0}});
+
+    REQUIRE(trap.code == Fault_Code::Divide_By_Zero);
+    REQUIRE(trap.program_counter == 11U);
+    REQUIRE(trap.opcode == MOD);
+    REQUIRE(trap.stack_pointer == Memory_Map::STACK_SIZE - 1UL - Memory_Map::WORD_SIZE);
+}
+
+TEST_CASE("Loads outside every segment report the address")
+{
+    const uint32_t address = Memory_Map::TEXT_END_ADDRESS + 16UL;
+    const auto trap = run({{0, IMM, address}, {0, LI, 0}, {0, EXIT, 0}});
+
+    REQUIRE(trap.code == Fault_Code::Bad_Address);
+    REQUIRE(trap.address == address);
+    REQUIRE(trap.program_counter == 5U);
+    REQUIRE(trap.ax == address);
+}
+
+TEST_CASE("Words straddling two segments are bad addresses")
+{
+    const uint32_t address = Memory_Map::DATA_START_ADDRESS - 2UL;
+    const auto trap = run({{0, IMM, address}, {0, LI, 0}, {0, EXIT, 0}});
+
+    REQUIRE(trap.code == Fault_Code::Bad_Address);
+    REQUIRE(trap.address == address);
+}
+
+TEST_CASE("Unbounded recursion overflows the stack")
+{
+    const auto trap = run({{0, ENT, 0}, {0, CALL, 0}});
+
+    REQUIRE(trap.code == Fault_Code::Stack_Overflow);
+    REQUIRE(trap.stack_pointer < Memory_Map::WORD_SIZE);
+}
+
+TEST_CASE("Bytes which aren't instructions are bad opcodes")
+{
+    Program_Image image;
+    image.text = {IMM, 0, 0, 0, 1, 0xFF};
+
+    Virtual_Machine vm;
+    vm.load(image);
+    const auto trap = vm.execute();
+
+    REQUIRE(trap.code == Fault_Code::Bad_Opcode);
+    REQUIRE(trap.program_counter == 5U);
+    REQUIRE(trap.opcode == 0xFF);
+    REQUIRE(trap.ax == 1U);
+}
+
+TEST_CASE("PUSH moves the stack by exactly one word")
+{
+    const auto trap = run({{0, IMM, 5}, {0, PUSH, 0}, {0, IMM, 6}, {0, ADD, 0}, {0, PUSH, 0}, {0, EXIT, 0}});
+
+    REQUIRE(trap.code == Fault_Code::Exit);
+    REQUIRE(trap.exit_status == 11);
+    REQUIRE(trap.stack_pointer == pushed(1U));
+}
+
+TEST_CASE("JZ and JNZ take their target from the following word")
+{
+    // 0: IMM condition, 5: branch to 17, 10: IMM 7, 15: PUSH, 16: EXIT, 17: IMM 9, 22: PUSH, 23: EXIT
+    const auto branch = [](const uint8_t opcode, const uint32_t condition)
+    {
+        return run({{0, IMM, condition}, {0, opcode, 17}, {0, IMM, 7}, {0, PUSH, 0}, {0, EXIT, 0},
+                    {0, IMM, 9}, {0, PUSH, 0}, {0, EXIT, 0}}).exit_status;
+    };
+
+    REQUIRE(branch(JNZ, 1U) == 9);
+    REQUIRE(branch(JNZ, 0U) == 7);
+    REQUIRE(branch(JZ, 0U) == 9);
+    REQUIRE(branch(JZ, 1U) == 7);
+    REQUIRE(run({{0, JMP, 10}, {0, IMM, 7}, {0, IMM, 9}, {0, PUSH, 0}, {0, EXIT, 0}}).exit_status == 9);
+}
+
+TEST_CASE("CALL pushes the address after its argument and LEV returns to it")
+{
+    // 0: IMM 6, 5: PUSH, 6: CALL 18, 11: ADJ 1, 16: PUSH, 17: EXIT
+    // 18: ENT 2, 23: IMM <return address slot>, 28: LI, 29: LEV
+    const auto trap = run({{0, IMM, 6}, {0, PUSH, 0}, {0, CALL, 18}, {0, ADJ, 1}, {0, PUSH, 0}, {0, EXIT, 0},
+                           {0, ENT, 2}, {0, IMM, pushed(2U)}, {0, LI, 0}, {0, LEV, 0}});
+
+    REQUIRE(trap.code == Fault_Code::Exit);
+    REQUIRE(trap.exit_status == 11);
+
+    // ADJ removed the argument, so only the status is left on the stack
+    REQUIRE(trap.stack_pointer == pushed(1U));
+}
+
+TEST_CASE("ENT saves the base pointer and reserves a word per local")
+{
+    // 0: CALL 5, 5: ENT 2, 10: IMM <saved base pointer slot>, 15: LI, 16: PUSH, 17: EXIT
+    const auto trap = run({{0, CALL, 5}, {0, ENT, 2}, {0, IMM, pushed(2U)}, {0, LI, 0}, {0, PUSH, 0}, {0, EXIT, 0}});
+
+    REQUIRE(trap.code == Fault_Code::Exit);
+    REQUIRE(trap.exit_status == static_cast<int32_t>(STACK_TOP));
+
+    // The return address, the saved base pointer, two locals and the status
+    REQUIRE(trap.stack_pointer == pushed(5U));
+}
+
+TEST_CASE("LEA gives the address of an argument or a local")
+{
+    // 0: IMM 6, 5: PUSH, 6: CALL 18, 11: ADJ 1, 16: PUSH, 17: EXIT
+    // 18: ENT 1, copies the argument into the local then returns the local plus one
+    const auto trap = run({{0, IMM, 6}, {0, PUSH, 0}, {0, CALL, 18}, {0, ADJ, 1}, {0, PUSH, 0}, {0, EXIT, 0},
+                           {0, ENT, 1}, {0, LEA, static_cast<uint32_t>(-1)}, {0, PUSH, 0}, {0, LEA, 2}, {0, LI, 0}, {0, SI, 0},
+                           {0, LEA, static_cast<uint32_t>(-1)}, {0, LI, 0}, {0, PUSH, 0}, {0, IMM, 1}, {0, ADD, 0},
+                           {0, LEV, 0}});
+
+    REQUIRE(trap.code == Fault_Code::Exit);
+    REQUIRE(trap.exit_status == 7);
+    REQUIRE(trap.stack_pointer == pushed(1U));
+
+    // Locals start one word below the saved base pointer, which sits below the return address
+    const auto address = run({{0, CALL, 5}, {0, ENT, 0}, {0, LEA, static_cast<uint32_t>(-1)}, {0, PUSH, 0}, {0, EXIT, 0}});
+    REQUIRE(address.exit_status == static_cast<int32_t>(pushed(3U)));
+
+    // Offsets too large for the frame wrap around the address space
+    const auto wrapped = run({{0, CALL, 5}, {0, ENT, 0}, {0, LEA, 0x40000000U}, {0, PUSH, 0}, {0, EXIT, 0}});
+    REQUIRE(wrapped.exit_status == static_cast<int32_t>(pushed(2U)));
+}
+
+TEST_CASE("SI and SC pop the address they store to")
+{
+    const uint32_t address = Memory_Map::DATA_START_ADDRESS;
+
+    const auto word = run({{0, IMM, address}, {0, PUSH, 0}, {0, IMM, 0x12345}, {0, SI, 0},
+                           {0, IMM, address}, {0, LI, 0}, {0, PUSH, 0}, {0, EXIT, 0}});
+    REQUIRE(word.exit_status == 0x12345);
+    REQUIRE(word.stack_pointer == pushed(1U));
+
+    const auto byte = run({{0, IMM, address}, {0, PUSH, 0}, {0, IMM, 0x141}, {0, SC, 0}, {0, PUSH, 0},
+                           {0, IMM, address}, {0, LC, 0}, {0, ADD, 0}, {0, PUSH, 0}, {0, EXIT, 0}});
+
+    // SC leaves the stored byte in ax
+    REQUIRE(byte.exit_status == 0x82);
+    REQUIRE(byte.stack_pointer == pushed(1U));
+}
+
+TEST_CASE("Images which don't fit in memory aren't loaded")
+{
+    Program_Image image;
+    image.text.resize(Memory_Map::TEXT_SIZE + 1UL, 0U);
+
+    Virtual_Machine vm;
+    REQUIRE_FALSE(vm.load(image));
+
+    image.text = encode({{0, EXIT, 0}});
+    image.bss_size = static_cast<uint32_t>(Memory_Map::DATA_SIZE + 1UL);
+    REQUIRE_FALSE(vm.load(image));
+
+    image.bss_size = 0U;
+    REQUIRE(vm.load(image));
+}